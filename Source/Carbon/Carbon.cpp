@@ -4,4 +4,5 @@
 #include "Modules/ModuleManager.h"
 
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, Carbon, "Carbon" );
- 
\ No newline at end of file
+
+DEFINE_LOG_CATEGORY(LogCarbon);
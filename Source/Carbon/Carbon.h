@@ -3,3 +3,8 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Stats/Stats.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogCarbon, Log, All);
+
+DECLARE_STATS_GROUP(TEXT("Carbon"), STATGROUP_Carbon, STATCAT_Advanced);
@@ -0,0 +1,218 @@
+// Sam Smith
+
+#include "CarbonBot.h"
+#include "Carbon.h"
+#include "CarbonCharacter.h"
+#include "CombatArchetype.h"
+#include "CombatantRegistry.h"
+#include "EnemyBase.h"
+#include "Engine/World.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "GameFramework/Controller.h"
+#include "Kismet/GameplayStatics.h"
+
+static FAutoConsoleCommandWithWorldAndArgs BotStartCommand(
+	TEXT("carbon.Bot.Start"),
+	TEXT("carbon.Bot.Start [Aggression] [DodgeChance] [Seed] - let a bot play the player character"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		ACarbonCharacter* Player = World ? Cast<ACarbonCharacter>(UGameplayStatics::GetPlayerPawn(World, 0)) : nullptr;
+		if (!Player)
+		{
+			UE_LOG(LogCarbon, Warning, TEXT("carbon.Bot.Start: no player character to play"));
+			return;
+		}
+
+		if (UCarbonBotComponent* Existing = Player->FindComponentByClass<UCarbonBotComponent>())
+			Existing->DestroyComponent();
+
+		UCarbonBotComponent* Bot = NewObject<UCarbonBotComponent>(Player);
+		if (Args.Num() > 0)
+			Bot->Aggression = FMath::Clamp(FCString::Atof(*Args[0]), 0.0f, 1.0f);
+		if (Args.Num() > 1)
+			Bot->DodgeChance = FMath::Clamp(FCString::Atof(*Args[1]), 0.0f, 1.0f);
+		if (Args.Num() > 2)
+			Bot->Seed = FCString::Atoi(*Args[2]);
+		Bot->RegisterComponent();
+
+		UE_LOG(LogCarbon, Log, TEXT("Bot playing %s: aggression %.2f, dodge chance %.2f, seed %d"), *Player->GetName(), Bot->Aggression, Bot->DodgeChance, Bot->Seed);
+	}));
+
+static FAutoConsoleCommandWithWorld BotStopCommand(
+	TEXT("carbon.Bot.Stop"),
+	TEXT("Hand the player character back to the player"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		APawn* Player = World ? UGameplayStatics::GetPlayerPawn(World, 0) : nullptr;
+		if (UCarbonBotComponent* Bot = Player ? Player->FindComponentByClass<UCarbonBotComponent>() : nullptr)
+			Bot->DestroyComponent();
+	}));
+
+UCarbonBotComponent::UCarbonBotComponent()
+{
+	PrimaryComponentTick.bCanEverTick = true;
+
+	Aggression = 0.7f;
+	DodgeChance = 0.5f;
+	DodgeDelay = 0.25f;
+	DodgeRange = 400.0f;
+	DecisionInterval = 0.2f;
+	TargetSwitchInterval = 6.0f;
+	Seed = 0;
+
+	NextDecisionTime = 0.0f;
+	NextSwitchTime = 0.0f;
+	RollTime = -1.0f;
+	MoveDirection = FVector::ZeroVector;
+	OrbitSide = 1.0f;
+	WantsAttack = false;
+}
+
+void UCarbonBotComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	Stream.Initialize(Seed);
+	NextSwitchTime = GetWorld()->GetTimeSeconds() + TargetSwitchInterval;
+
+	// Inputs have to be in before movement consumes them
+	if (ACharacter* Character = Cast<ACharacter>(GetOwner()))
+		Character->GetCharacterMovement()->AddTickPrerequisiteComponent(this);
+}
+
+void UCarbonBotComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	ACarbonCharacter* Character = Cast<ACarbonCharacter>(GetOwner());
+	AController* Controller = Character ? Character->GetController() : nullptr;
+	if (!Controller)
+		return;
+
+	const float Now = GetWorld()->GetTimeSeconds();
+	WatchAttacks(Character, Now);
+	if (Now >= NextDecisionTime)
+	{
+		Decide(Character, Now);
+		NextDecisionTime = Now + DecisionInterval;
+	}
+
+	// Held direction as stick input, relative to the view like a player's
+	const FRotator View(0.0f, Controller->GetControlRotation().Yaw, 0.0f);
+	const FRotationMatrix ViewAxes(View);
+	Character->MoveForward(FVector::DotProduct(MoveDirection, ViewAxes.GetUnitAxis(EAxis::X)));
+	Character->MoveRight(FVector::DotProduct(MoveDirection, ViewAxes.GetUnitAxis(EAxis::Y)));
+
+	if (RollTime >= 0.0f && Now >= RollTime)
+	{
+		RollTime = -1.0f;
+		Character->Roll();
+	}
+	else if (WantsAttack)
+	{
+		WantsAttack = false;
+		Character->Attack();
+	}
+}
+
+void UCarbonBotComponent::WatchAttacks(ACarbonCharacter* Character, float Now)
+{
+	UCombatantRegistry* Registry = GetWorld()->GetSubsystem<UCombatantRegistry>();
+	const FVector Location = Character->GetActorLocation();
+
+	TArray<FCombatantHandle, TInlineAllocator<8>> Attacking;
+	for (FCombatantHandle Handle : Character->NearbyEnemies)
+	{
+		AEnemyBase* Enemy = Cast<AEnemyBase>(Registry->Resolve(Handle));
+		if (!Enemy || Enemy->ActiveState != State::ATTACK)
+			continue;
+
+		Attacking.Add(Handle);
+		if (AttackingEnemies.Contains(Handle) || RollTime >= 0.0f)
+			continue;
+
+		// Just started - maybe roll back and to one side of it
+		const FVector Away = (Location - Enemy->GetActorLocation()).GetSafeNormal2D();
+		if (FVector::DistSquared2D(Location, Enemy->GetActorLocation()) <= FMath::Square(DodgeRange) && Stream.FRand() < DodgeChance)
+		{
+			const float Side = Stream.FRand() < 0.5f ? 1.0f : -1.0f;
+			MoveDirection = (Away + FVector::CrossProduct(Away, FVector::UpVector) * Side).GetSafeNormal();
+			WantsAttack = false;
+			RollTime = Now + DodgeDelay;
+			// Hold the dodge direction until the roll starts
+			NextDecisionTime = FMath::Max(NextDecisionTime, RollTime + DecisionInterval);
+		}
+	}
+
+	AttackingEnemies = MoveTemp(Attacking);
+}
+
+void UCarbonBotComponent::Decide(ACarbonCharacter* Character, float Now)
+{
+	// Lock on whenever something is close
+	if (!Character->IsTargetLocked() && Character->NearbyEnemies.Num() > 0)
+		Character->ToggleCombatMode();
+
+	ACombatant* Target = Character->GetTarget();
+	if (Target && Now >= NextSwitchTime)
+	{
+		NextSwitchTime = Now + TargetSwitchInterval * Stream.FRandRange(0.5f, 1.5f);
+
+		// Mostly switch, sometimes let go (the lock comes back next decision)
+		if (Stream.FRand() < 0.2f)
+			Character->ToggleCombatMode();
+		else
+			Character->CycleTarget(Stream.FRand() < 0.5f);
+		Target = Character->GetTarget();
+	}
+
+	if (!Target)
+	{
+		// Nothing close - walk towards the closest enemy anywhere (or wait for one)
+		ACombatant* Enemy = FindClosestEnemy(Character);
+		MoveDirection = Enemy ? (Enemy->GetActorLocation() - Character->GetActorLocation()).GetSafeNormal2D() : FVector::ZeroVector;
+		return;
+	}
+
+	const FVector ToTarget = Target->GetActorLocation() - Character->GetActorLocation();
+	const FVector Direction = ToTarget.GetSafeNormal2D();
+	if (ToTarget.Size2D() > Character->GetTuning().AttackRange)
+	{
+		MoveDirection = Direction;
+	}
+	else if (Stream.FRand() < Aggression)
+	{
+		// Pressing again mid-attack buffers the next combo hit
+		MoveDirection = FVector::ZeroVector;
+		WantsAttack = true;
+	}
+	else
+	{
+		if (Stream.FRand() < 0.1f)
+			OrbitSide = -OrbitSide;
+		MoveDirection = FVector::CrossProduct(Direction, FVector::UpVector) * OrbitSide;
+	}
+}
+
+ACombatant* UCarbonBotComponent::FindClosestEnemy(ACarbonCharacter* Character) const
+{
+	UCombatantRegistry* Registry = GetWorld()->GetSubsystem<UCombatantRegistry>();
+	const FVector Location = Character->GetActorLocation();
+
+	ACombatant* Closest = nullptr;
+	float ClosestSquared = MAX_flt;
+	for (int32 Slot = 0; Slot < Registry->GetNumSlots(); ++Slot)
+	{
+		AEnemyBase* Enemy = Cast<AEnemyBase>(Registry->GetCombatant(Slot));
+		if (!Enemy || Enemy->ActiveState == State::DEAD)
+			continue;
+
+		const float DistanceSquared = FVector::DistSquared(Enemy->GetActorLocation(), Location);
+		if (DistanceSquared < ClosestSquared)
+		{
+			Closest = Enemy;
+			ClosestSquared = DistanceSquared;
+		}
+	}
+	return Closest;
+}
@@ -0,0 +1,88 @@
+// Sam Smith
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "Combatant.h"
+#include "CarbonBot.generated.h"
+
+class ACarbonCharacter;
+
+/**
+ * Plays its ACarbonCharacter for unattended soak and perf runs.
+ * It calls the same entry points as the input bindings (MoveForward/MoveRight, Attack, Roll,
+ * CycleTarget and ToggleCombatMode), so combos, buffered presses, rolls, stumbles and target
+ * switches all go through the player's own code. The player controller stays in possession,
+ * so camera, hit feedback and everything looking for the player pawn behave as in a normal game.
+ * Decisions are seeded and made every DecisionInterval; dodges react to nearby enemies
+ * entering ATTACK.
+ * carbon.Bot.Start [Aggression] [DodgeChance] [Seed] puts one on the player, carbon.Bot.Stop
+ * removes it. For long runs, pair it with carbon.Telemetry.SoakInterval.
+ */
+UCLASS(ClassGroup = (Carbon), meta = (BlueprintSpawnableComponent))
+class CARBON_API UCarbonBotComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	UCarbonBotComponent();
+
+	/** Chance per decision to attack when in range (otherwise circles the target) */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Bot")
+	float Aggression;
+
+	/** Chance to roll away from an enemy that starts attacking within DodgeRange */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Bot")
+	float DodgeChance;
+
+	/** Seconds after an enemy's attack starts before rolling */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Bot")
+	float DodgeDelay;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Bot")
+	float DodgeRange;
+
+	/** Seconds between decisions (inputs are held in between, like a stick) */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Bot")
+	float DecisionInterval;
+
+	/** Average seconds between target switches (and, sometimes, dropping the lock) */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Bot")
+	float TargetSwitchInterval;
+
+	/** The same seed makes the same decisions (given the same fight) */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Bot")
+	int32 Seed;
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+protected:
+	virtual void BeginPlay() override;
+
+private:
+	/** Pick where to go and whether to attack, lock on or switch targets */
+	void Decide(ACarbonCharacter* Character, float Now);
+
+	/** Schedule a roll when a nearby enemy starts an attack */
+	void WatchAttacks(ACarbonCharacter* Character, float Now);
+
+	/** Closest living enemy anywhere, for when none are near */
+	ACombatant* FindClosestEnemy(ACarbonCharacter* Character) const;
+
+	FRandomStream Stream;
+
+	float NextDecisionTime;
+	float NextSwitchTime;
+
+	/** World time to roll at (negative when no roll is coming) */
+	float RollTime;
+
+	/** Held movement, in world space */
+	FVector MoveDirection;
+	float OrbitSide;
+	bool WantsAttack;
+
+	/** Nearby enemies that were attacking last frame */
+	TArray<FCombatantHandle, TInlineAllocator<8>> AttackingEnemies;
+};
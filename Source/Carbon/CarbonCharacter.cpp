@@ -17,6 +17,12 @@
 #include "EnemyBase.h"
 #include "Containers/Set.h"
 #include "DrawDebugHelpers.h"
+#include "CombatArchetype.h"
+#include "CombatTelemetry.h"
+#include "HitFeedbackSubsystem.h"
+#include "CombatEventLog.h"
+#include "CombatantRegistry.h"
+#include "LockOnCamera.h"
 
 //////////////////////////////////////////////////////////////////////////
 // ACarbonCharacter
@@ -25,8 +31,6 @@ ACarbonCharacter::ACarbonCharacter()
 {
 	PrimaryActorTick.bCanEverTick = true;
 
-	TargetLockDistance = 1500.0f;
-
 	// Set size for collision capsule
 	GetCapsuleComponent()->InitCapsuleSize(42.f, 96.0f);
 
@@ -56,6 +60,9 @@ ACarbonCharacter::ACarbonCharacter()
 	FollowCamera->SetupAttachment(CameraBoom, USpringArmComponent::SocketName); // Attach the camera to the end of the boom and let the boom adjust to match the controller orientation
 	FollowCamera->bUsePawnControlRotation = false; // Camera does not rotate relative to arm
 
+	// Create the lock-on camera (drives the controller rotation and boom length while a target is locked)
+	LockOnCamera = CreateDefaultSubobject<ULockOnCameraComponent>(TEXT("LockOnCamera"));
+
 	// Create weapon
 	Weapon = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("Weapon"));
 	Weapon->SetupAttachment(GetMesh(), "RightHandItem");
@@ -66,18 +73,18 @@ ACarbonCharacter::ACarbonCharacter()
 	SphereCollider->SetupAttachment(RootComponent);
 	SphereCollider->SetCollisionResponseToAllChannels(ECollisionResponse::ECR_Ignore);
 	SphereCollider->SetCollisionResponseToChannel(ECollisionChannel::ECC_Pawn, ECollisionResponse::ECR_Overlap);
-	SphereCollider->SetSphereRadius(TargetLockDistance);
+	SphereCollider->SetSphereRadius(FCombatTuning().TargetLockDistance);
 
 	// Note: The skeletal mesh and anim blueprint references on the Mesh component (inherited from Character) 
 	// are set in the derived blueprint asset named MyCharacter (to avoid direct content references in C++)
 
-	Attacking = false;
-	Rolling = false;
-	TargetLocked = false;
-	NextAttackReady = false;
-	AttackDamaging = false;
 	AttackIndex = 0;
 
+	AttackBufferWindow = 0.3f;
+	RollBufferWindow = 0.2f;
+	BufferedAttackTime = -1.0f;
+	BufferedRollTime = -1.0f;
+
 	PassiveMovementSpeed = 450.0f;
 	CombatMovementSpeed = 250.0f;
 	GetCharacterMovement()->MaxWalkSpeed = PassiveMovementSpeed;
@@ -121,6 +128,7 @@ void ACarbonCharacter::BeginPlay()
 	Super::BeginPlay();
 
 	// Sphere
+	SphereCollider->SetSphereRadius(GetTuning().TargetLockDistance);
 	SphereCollider->OnComponentBeginOverlap.AddDynamic(this, &ACarbonCharacter::OnSphereBeginOverlap);
 	SphereCollider->OnComponentEndOverlap.AddDynamic(this, &ACarbonCharacter::OnSphereEndOverlap);
 
@@ -130,8 +138,8 @@ void ACarbonCharacter::BeginPlay()
 	for (auto& Elem : NearActors)
 	{
 		// Cast to EnemyBase class to check if they are an enemy
-		if (Cast<AEnemyBase>(Elem))
-			NearbyEnemies.Add(Elem);
+		if (AEnemyBase* Enemy = Cast<AEnemyBase>(Elem))
+			NearbyEnemies.AddUnique(Enemy->GetHandle());
 	}
 }
 
@@ -143,24 +151,25 @@ void ACarbonCharacter::Tick(float DeltaTime)
 	FocusTarget();
 
 	// ROLLING
-	if (Rolling)
+	if (IsRolling())
 	{
 		// Move forward
-		AddMovementInput(GetActorForwardVector(), 600 * GetWorld()->GetDeltaSeconds());
+		AddMovementInput(GetActorForwardVector(), 600 * GetLocalDeltaTime());
 	}
 	// STUMBLING
-	else if (Stumbling && MovingBackwards)
+	else if (IsStumbling() && IsMovingBackwards())
 	{
 		// Move Backwards
-		AddMovementInput(-GetActorForwardVector(), 40.0f * GetWorld()->GetDeltaSeconds());
+		AddMovementInput(-GetActorForwardVector(), GetTuning().StumblePushScale * GetLocalDeltaTime());
 	}
 	// ATTACKING
-	else if (Attacking && AttackDamaging)
+	else if (IsAttacking() && IsAttackDamaging())
 	{
 		// Loop through weapon contacts and apply damage to them
 
 		TSet<AActor*> OverlappingActors;
 		Weapon->GetOverlappingActors(OverlappingActors);
+		COMBAT_TELEMETRY_ADD(Telemetry, OverlapQueries, 1);
 
 		for (AActor* OtherActor : OverlappingActors)
 		{
@@ -168,7 +177,7 @@ void ACarbonCharacter::Tick(float DeltaTime)
 				continue;
 
 			// Don't hit same enemy multiple times within one attack
-			if (!AttackHitActors.Contains(OtherActor))
+			if (!CheckAndMarkAttackHit(OtherActor))
 			{
 				// Apply damage
 				float AppliedDamage = UGameplayStatics::ApplyDamage(OtherActor, 1.0f, GetController(), this, UDamageType::StaticClass());
@@ -176,11 +185,11 @@ void ACarbonCharacter::Tick(float DeltaTime)
 				// Check damage was successfull (not invalid or blocked)
 				if (AppliedDamage > 0.0f)
 				{
-					AttackHitActors.Add(OtherActor);
+					COMBAT_TELEMETRY_ADD(Telemetry, HitsApplied, 1);
+					COMBAT_EVENT(HIT, this, OtherActor, AppliedDamage);
 
-					// Shake camera on successful hit
-					UMatineeCameraShake* CameraShake = UCameraShake::StaticClass()->GetDefaultObject<UMatineeCameraShake>();
-					GetWorld()->GetFirstPlayerController()->PlayerCameraManager->StartCameraShake(CameraShakeMinor);
+					// Spark, sound and camera shake (merged with any other hits this frame)
+					GetWorld()->GetSubsystem<UHitFeedbackSubsystem>()->AddHit(this, OtherActor);
 				}
 			}
 		}
@@ -198,19 +207,7 @@ void ACarbonCharacter::Tick(float DeltaTime)
 	//float YawAmount = FMath::Clamp(DeltaTime * InputVectorLength * ScaledDotProduct, 0.0f, 0.6f) * RotationDifference;
 	//AddControllerYawInput(YawAmount);
 
-	//* Camera focus */
-	if (Target != NULL && TargetLocked)
-	{
-		// Check if distance to target within x
-		FVector TargetDirection = Target->GetActorLocation() - GetActorLocation();
-		if (TargetDirection.Size2D() > 400)
-		{
-			// Rotate towards target within y degrees
-			FRotator Difference = UKismetMathLibrary::NormalizedDeltaRotator(Controller->GetControlRotation(), TargetDirection.ToOrientationRotator());
-			if (FMath::Abs(Difference.Yaw) > 30.0f)
-				AddControllerYawInput(DeltaTime * -Difference.Yaw * 0.5f);
-		}			
-	}
+	// Camera focus on the target is ULockOnCameraComponent's, after movement
 }
 
 void ACarbonCharacter::OnResetVR()
@@ -242,7 +239,7 @@ void ACarbonCharacter::LookUpAtRate(float Rate)
 
 void ACarbonCharacter::MoveForward(float Value)
 {
-	if ((Controller != NULL) && (Value != 0.0f) && !Attacking && !Rolling && !Stumbling)
+	if ((Controller != NULL) && (Value != 0.0f) && !HasAnyCombatFlags(ECombatFlags::Busy))
 	{
 		// find out which way is forward
 		const FRotator Rotation = Controller->GetControlRotation();
@@ -258,7 +255,7 @@ void ACarbonCharacter::MoveForward(float Value)
 
 void ACarbonCharacter::MoveRight(float Value)
 {
-	if ( (Controller != NULL) && (Value != 0.0f) && !Attacking && !Rolling && !Stumbling)
+	if ( (Controller != NULL) && (Value != 0.0f) && !HasAnyCombatFlags(ECombatFlags::Busy))
 	{
 		// find out which way is right
 		const FRotator Rotation = Controller->GetControlRotation();
@@ -273,19 +270,58 @@ void ACarbonCharacter::MoveRight(float Value)
 	InputDirection.Y = Value;
 }
 
+bool ACarbonCharacter::CanAttack() const
+{
+	return CombatCore::CanAttack(GetActionState());
+}
+
+bool ACarbonCharacter::CanRoll() const
+{
+	return CombatCore::CanRoll(GetActionState());
+}
+
+bool ACarbonCharacter::IsInputBuffered(float Timestamp, float Window) const
+{
+	return CombatCore::IsInputBuffered(Timestamp, Window, GetLocalTime());
+}
+
+void ACarbonCharacter::ConsumeBufferedInput()
+{
+	switch (CombatCore::ResolveBufferedInput(GetActionState(), GetLocalTime(),
+		BufferedAttackTime, AttackBufferWindow, BufferedRollTime, RollBufferWindow))
+	{
+		case CombatCore::EBufferedInput::Roll:
+			Roll();
+			break;
+		case CombatCore::EBufferedInput::Attack:
+			Attack();
+			break;
+		default:
+			break;
+	}
+}
+
 void ACarbonCharacter::Attack()
 {
-	if ((!Attacking || NextAttackReady) && !Rolling && !Stumbling && !GetCharacterMovement()->IsFalling())
+	if (!CanAttack())
 	{
-		Super::Attack();
+		// Too early - remember the press so the next anim callback can replay it
+		BufferedAttackTime = GetLocalTime();
+		BufferedRollTime = -1.0f;
+		return;
+	}
+
+	BufferedAttackTime = -1.0f;
 
-		// Fringe-case out-of-bounds check
-		//		Should not happen due to last attack in array SHOULD
-		//      be forced to EndAttack() before the next can be played.
-		if (AttackIndex >= Attacks.Num())
-			AttackIndex = 0;
+	Super::Attack();
 
-		PlayAnimMontage(Attacks[AttackIndex++]);
+	// Fringe-case out-of-bounds check
+	//		Should not happen due to last attack in array SHOULD
+	//      be forced to EndAttack() before the next can be played.
+	if (Archetype)
+	{
+		AttackIndex = CombatCore::ComboIndex(AttackIndex, Archetype->AttackAnimations.Num());
+		PlayAnimMontage(GetLoadedMontage(Archetype->AttackAnimations, AttackIndex++));
 	}
 }
 
@@ -296,10 +332,31 @@ void ACarbonCharacter::EndAttack()
 	AttackIndex = 0;
 }
 
+void ACarbonCharacter::AttackNextReady()
+{
+	Super::AttackNextReady();
+
+	ConsumeBufferedInput();
+}
+
+void ACarbonCharacter::EndStumble()
+{
+	Super::EndStumble();
+
+	ConsumeBufferedInput();
+}
+
 void ACarbonCharacter::Roll()
 {
-	if (Rolling || Stumbling)
+	if (!CanRoll())
+	{
+		// Too early - remember the press so the next anim callback can replay it
+		BufferedRollTime = GetLocalTime();
+		BufferedAttackTime = -1.0f;
 		return;
+	}
+
+	BufferedRollTime = -1.0f;
 
 	EndAttack();
 
@@ -324,13 +381,16 @@ void ACarbonCharacter::Roll()
 
 	SetActorRotation(RollRotation);
 
-	PlayAnimMontage(CombatRoll);
-	Rolling = true;
+	if (Archetype)
+		PlayAnimMontage(Archetype->CombatRoll.Get());
+	SetCombatFlag(ECombatFlags::Rolling, true);
+
+	COMBAT_EVENT(ROLL, this);
 }
 
 void ACarbonCharacter::StartRoll()
 {
-	Rolling = true;
+	SetCombatFlag(ECombatFlags::Rolling, true);
 
 	// Speed up movement speed
 	GetCharacterMovement()->MaxWalkSpeed = 600.0f;
@@ -341,29 +401,34 @@ void ACarbonCharacter::StartRoll()
 
 void ACarbonCharacter::EndRoll()
 {
-	Rolling = false;
-	GetCharacterMovement()->MaxWalkSpeed = TargetLocked ? CombatMovementSpeed : PassiveMovementSpeed;
+	SetCombatFlag(ECombatFlags::Rolling, false);
+	GetCharacterMovement()->MaxWalkSpeed = IsTargetLocked() ? CombatMovementSpeed : PassiveMovementSpeed;
+
+	ConsumeBufferedInput();
 }
 
 void ACarbonCharacter::RollRotateSmooth()
 {
-	FRotator SmoothedRotation = FMath::Lerp(GetActorRotation(), RollRotation, RotationSmoothing * GetWorld()->DeltaTimeSeconds);
+	FRotator SmoothedRotation = FMath::Lerp(GetActorRotation(), RollRotation, RotationSmoothing * GetLocalDeltaTime());
 	SetActorRotation(SmoothedRotation);
 }
 
 void ACarbonCharacter::FocusTarget()
 {
-	// Check if moved too far away from target
+	// Check if moved too far away from target (or it was destroyed)
+	ACombatant* Target = GetTarget();
 	if (Target != NULL)
 	{
-		if (FVector::Dist(GetActorLocation(), Target->GetActorLocation()) >= TargetLockDistance)
+		if (FVector::Dist(GetActorLocation(), Target->GetActorLocation()) >= GetTuning().TargetLockDistance)
 			ToggleCombatMode();
 	}
+	else if (IsTargetLocked())
+		SetInCombat(false);
 }
 
 void ACarbonCharacter::ToggleCombatMode()
 {
-	if (!TargetLocked)
+	if (!IsTargetLocked())
 	{
 		// Attempt to find and lock a target
 		CycleTarget();
@@ -376,79 +441,67 @@ void ACarbonCharacter::ToggleCombatMode()
 
 void ACarbonCharacter::SetInCombat(bool _InCombat)
 {
-	TargetLocked = _InCombat;
-	GetCharacterMovement()->bOrientRotationToMovement = !TargetLocked;
-	GetCharacterMovement()->MaxWalkSpeed = TargetLocked ? CombatMovementSpeed : PassiveMovementSpeed;
-	if (!TargetLocked)
-		Target = NULL;
+	SetCombatFlag(ECombatFlags::TargetLocked, _InCombat);
+	GetCharacterMovement()->bOrientRotationToMovement = !IsTargetLocked();
+	GetCharacterMovement()->MaxWalkSpeed = IsTargetLocked() ? CombatMovementSpeed : PassiveMovementSpeed;
+	if (!IsTargetLocked() && TargetHandle.IsSet())
+	{
+		COMBAT_EVENT(TARGET_SWITCH, this, nullptr);
+		TargetHandle = FCombatantHandle();
+	}
 }
 
 void ACarbonCharacter::OnSphereBeginOverlap(class UPrimitiveComponent* OverlappedComp, class AActor* OtherActor, class UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
 {
-	if (Cast<AEnemyBase>(OtherActor) && !NearbyEnemies.Contains(OtherActor))
-		NearbyEnemies.Add(OtherActor);
+	if (AEnemyBase* Enemy = Cast<AEnemyBase>(OtherActor))
+		NearbyEnemies.AddUnique(Enemy->GetHandle());
 }
 
 void ACarbonCharacter::OnSphereEndOverlap(class UPrimitiveComponent* OverlappedComp, class AActor* OtherActor, class UPrimitiveComponent* OtherComp, int32 OtherBodyIndex)
 {
-	if (Cast<AEnemyBase>(OtherActor) && NearbyEnemies.Contains(OtherActor))
-		NearbyEnemies.Remove(OtherActor);
+	if (AEnemyBase* Enemy = Cast<AEnemyBase>(OtherActor))
+		NearbyEnemies.RemoveSwap(Enemy->GetHandle());
 }
 
 void ACarbonCharacter::CycleTarget(bool Clockwise)
 {
-	//* Find next target to the left/right to the current one (if any) /
+	//* Find next target to the left/right to the current one (if any), or the closest enemy if there is none /
 
-	AActor* SuitableTarget = NULL;
-	if (Target)
-	{
-		// Loop through nearby enemies, comparing yaw difference to find the next closest enemy to the current target
-		FVector CameraLocation = Cast<APlayerController>(GetController())->PlayerCameraManager->GetCameraLocation();
+	auto ToCore = [](const FVector& Location) { return CombatCore::FVec3 { Location.X, Location.Y, Location.Z }; };
 
-		FRotator TargetDirection = (Target->GetActorLocation() - CameraLocation).ToOrientationRotator();
-		float BestYawDifference = INFINITY;
-		for (auto& Elem : NearbyEnemies)
-		{
-			if (Elem == Target)
-				continue;
+	// Drop enemies destroyed since they came close
+	NearbyEnemies.RemoveAllSwap([this](FCombatantHandle Handle) { return Registry->Resolve(Handle) == nullptr; });
 
-			FVector ElemDirection = Elem->GetActorLocation() - CameraLocation;
-			FRotator Difference = UKismetMathLibrary::NormalizedDeltaRotator(ElemDirection.ToOrientationRotator(), TargetDirection);
+	TArray<CombatCore::FVec3, TInlineAllocator<16>> Candidates;
+	int32 CurrentIndex = INDEX_NONE;
+	for (int32 Index = 0; Index < NearbyEnemies.Num(); ++Index)
+	{
+		Candidates.Add(ToCore(Registry->Resolve(NearbyEnemies[Index])->GetActorLocation()));
+		if (NearbyEnemies[Index] == TargetHandle)
+			CurrentIndex = Index;
+	}
 
-			if ((Clockwise && Difference.Yaw <= 0.0f) || (!Clockwise && Difference.Yaw >= 0.0f))
-				continue;
+	ACombatant* Target = GetTarget();
 
-			float YawDifference = FMath::Abs(Difference.Yaw);
-			if (YawDifference < BestYawDifference)
-			{
-				BestYawDifference = YawDifference;
-				SuitableTarget = Elem;
-			}
-		}
-	}
+	// Seen from the camera (or the pawn's eyes without a player controller)
+	FVector CameraLocation = GetActorLocation();
+	FRotator CameraRotation;
+	if (Controller)
+		Controller->GetPlayerViewPoint(CameraLocation, CameraRotation);
+	CombatCore::FVec3 CurrentTarget = Target ? ToCore(Target->GetActorLocation()) : CombatCore::FVec3 {};
+	int32 Selected = CombatCore::CycleTarget(ToCore(CameraLocation), ToCore(GetActorLocation()), Candidates.GetData(), Candidates.Num(),
+		Target ? &CurrentTarget : nullptr, CurrentIndex, Clockwise);
+
+	ACombatant* SuitableTarget = Selected != INDEX_NONE ? Registry->Resolve(NearbyEnemies[Selected]) : NULL;
 
-	//* Find closest enemy if no existing target to cycle from
-	else
-	{
-		float BestDistance = INFINITY;
-		for (auto& Elem : NearbyEnemies)
-		{
-			float Distance = FVector::Dist(GetActorLocation(), Elem->GetActorLocation());
-			if (Distance < BestDistance)
-			{
-				BestDistance = Distance;
-				SuitableTarget = Elem;
-			}
-		}
-	}
-	
 
 	if (SuitableTarget != NULL)
 	{
-		Target = SuitableTarget;
+		AssignTarget(SuitableTarget);
+		COMBAT_EVENT(TARGET_SWITCH, this, SuitableTarget);
 
 		// If not in combat but (successfully) attempted to switch target, put into combat mode
-		if (!TargetLocked)
+		if (!IsTargetLocked())
 		{
 			SetInCombat(true);
 		}
@@ -468,10 +521,25 @@ void ACarbonCharacter::CycleTargetCounterClockwise()
 void ACarbonCharacter::LookAtSmooth()
 {
 	// Add !Rolling condition to LookAtSmooth() function
-	if (!Rolling)
+	if (!IsRolling())
 		Super::LookAtSmooth();
 }
 
+void ACarbonCharacter::GetLegacyMontages(UCombatArchetype& Legacy) const
+{
+	Super::GetLegacyMontages(Legacy);
+
+	// The player's combo was its own property
+	if (Attacks.Num() > 0)
+		Legacy.AttackAnimations = Attacks;
+	Legacy.CombatRoll = CombatRoll;
+}
+
+TSubclassOf<UCameraShakeBase> ACarbonCharacter::GetHitCameraShake() const
+{
+	return CameraShakeMinor;
+}
+
 float ACarbonCharacter::TakeDamage(float DamageAmount, FDamageEvent const & DamageEvent, AController * EventInstigator, AActor * DamageCauser)
 {
 	// DEFAULT:
@@ -479,27 +547,37 @@ float ACarbonCharacter::TakeDamage(float DamageAmount, FDamageEvent const & Dama
 	//		Play random stumble animation
 	//		Rotate towards damage source
 
-	if (DamageCauser == this || Rolling)
+	if (DamageCauser == this || IsRolling() || !IsArchetypeLoaded())
 		return 0.0f;
 
 	EndAttack();
 	SetMovingBackwards(false);
 	SetMovingForward(false);
-	Stumbling = true;
+	SetCombatFlag(ECombatFlags::Stumbling, true);
 
-	// Play random stumble animation from array - Does not repeat last animation used
-	int AnimationIndex;
-	do { AnimationIndex = FMath::RandRange(0, TakeHit_StumbleBackwards.Num() - 1); } while (AnimationIndex == LastStumbleIndex);
+	// Play random stumble animation from array - Does not repeat last animation used (if there is another)
+	const int NumStumbles = Archetype ? Archetype->TakeHit_StumbleBackwards.Num() : 0;
+	int AnimationIndex = FMath::RandRange(0, FMath::Max(NumStumbles - 1, 0));
+	while (NumStumbles > 1 && AnimationIndex == LastStumbleIndex)
+		AnimationIndex = FMath::RandRange(0, NumStumbles - 1);
 
-	PlayAnimMontage(TakeHit_StumbleBackwards[AnimationIndex]);
+	if (Archetype)
+		PlayAnimMontage(GetLoadedMontage(Archetype->TakeHit_StumbleBackwards, AnimationIndex));
 	LastStumbleIndex = AnimationIndex;
 
+	COMBAT_EVENT(DAMAGE, this, DamageCauser, DamageAmount);
+	COMBAT_EVENT(STUMBLE, this, DamageCauser, 0.0f, (uint8)AnimationIndex);
+	OnAnyDamaged.Broadcast(this, DamageCauser, DamageAmount);
+
 
 	// Rotate towards source of damage
-	FVector Direction = DamageCauser->GetActorLocation() - GetActorLocation();
-	Direction = FVector(Direction.X, Direction.Y, 0);
-	FRotator Rotation = FRotationMatrix::MakeFromX(Direction).Rotator();
-	SetActorRotation(Rotation);
+	if (DamageCauser)
+	{
+		FVector Direction = DamageCauser->GetActorLocation() - GetActorLocation();
+		Direction = FVector(Direction.X, Direction.Y, 0);
+		FRotator Rotation = FRotationMatrix::MakeFromX(Direction).Rotator();
+		SetActorRotation(Rotation);
+	}
 
 	return DamageAmount;
 }
@@ -23,6 +23,10 @@ class ACarbonCharacter : public ACombatant
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Camera, meta = (AllowPrivateAccess = "true"))
 	class UCameraComponent* FollowCamera;
 
+	/** Frames the locked target after movement */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Camera, meta = (AllowPrivateAccess = "true"))
+	class ULockOnCameraComponent* LockOnCamera;
+
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Combat", meta = (AllowPrivateAccess = "true"))
 	UStaticMeshComponent* Weapon;
 
@@ -64,24 +68,40 @@ public:
 
 	float TakeDamage(float DamageAmount, FDamageEvent const & DamageEvent, AController * EventInstigator, AActor * DamageCauser);
 
-	UPROPERTY(EditAnywhere, Category="Animations")
-	TArray<UAnimMontage*> Attacks;
+	/** Deprecated: set on the archetype instead. Only used while no Archetype is assigned */
+	UPROPERTY(EditAnywhere, Category="Animations", meta = (DeprecatedProperty, DeprecationMessage = "Use the combat archetype's AttackAnimations"))
+	TArray<TSoftObjectPtr<UAnimMontage>> Attacks;
 
-	UPROPERTY(EditAnywhere, Category = "Animations")
-	UAnimMontage * CombatRoll;
+	/** Deprecated: set on the archetype instead. Only used while no Archetype is assigned */
+	UPROPERTY(EditAnywhere, Category = "Animations", meta = (DeprecatedProperty, DeprecationMessage = "Use the combat archetype's CombatRoll"))
+	TSoftObjectPtr<UAnimMontage> CombatRoll;
+
+	virtual void GetLegacyMontages(UCombatArchetype& Legacy) const override;
 
 	UPROPERTY(EditAnywhere, Category = Camera)
 	TSubclassOf<UMatineeCameraShake> CameraShakeMinor;
 
-	bool Rolling;
+	virtual TSubclassOf<UCameraShakeBase> GetHitCameraShake() const override;
+
+	/** Seconds an Attack press made too early is remembered before being dropped */
+	UPROPERTY(EditAnywhere, Category = "Combat")
+	float AttackBufferWindow;
+
+	/** Seconds a Roll press made too early is remembered before being dropped */
+	UPROPERTY(EditAnywhere, Category = "Combat")
+	float RollBufferWindow;
+
 	FRotator RollRotation;
 	int AttackIndex;
-	float TargetLockDistance;
-	TArray<AActor*> NearbyEnemies;
+	TArray<FCombatantHandle> NearbyEnemies;
 	int LastStumbleIndex;
 
 	FVector InputDirection;
 
+	// World time of the last buffered press (negative when nothing is buffered)
+	float BufferedAttackTime;
+	float BufferedRollTime;
+
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
@@ -95,14 +115,31 @@ protected:
 	/** Called for side to side input */
 	void MoveRight(float Value);
 
-	/** Called to attempt beginning an attack */
+	/** Called to attempt beginning an attack (buffered if not currently allowed) */
 	void Attack();
 
 	/** Called by Anim to signal the damaging section of an attack has ended */
 	void EndAttack();
 
+	/** Called by Anim to signal that the next attack is potentially allowed */
+	void AttackNextReady();
+
+	/** Anim called: Stumble finished */
+	void EndStumble();
+
+	/** Called to attempt beginning a roll (buffered if not currently allowed) */
 	void Roll();
 
+	bool CanAttack() const;
+
+	bool CanRoll() const;
+
+	/** Returns true if a press made at Timestamp is still within Window seconds */
+	bool IsInputBuffered(float Timestamp, float Window) const;
+
+	/** Replays the most recent buffered press, if still valid and allowed */
+	void ConsumeBufferedInput();
+
 	/** Called by Anim to signal the damaging section of an attack has started */
 	UFUNCTION(BlueprintCallable, Category = "Combat")
 		void StartRoll();
@@ -142,6 +179,9 @@ protected:
 	virtual void SetupPlayerInputComponent(class UInputComponent* PlayerInputComponent) override;
 	// End of APawn interface
 
+	/** Presses the same inputs a player would */
+	friend class UCarbonBotComponent;
+
 public:
 	/** Returns CameraBoom subobject **/
 	FORCEINLINE class USpringArmComponent* GetCameraBoom() const { return CameraBoom; }
@@ -3,6 +3,7 @@
 #include "CarbonGameMode.h"
 #include "CarbonCharacter.h"
 #include "UObject/ConstructorHelpers.h"
+#include "IAnimationBudgetAllocator.h"
 
 ACarbonGameMode::ACarbonGameMode()
 {
@@ -12,4 +13,20 @@ ACarbonGameMode::ACarbonGameMode()
 	{
 		DefaultPawnClass = PlayerPawnBPClass.Class;
 	}
+
+	AnimationBudgetMs = 1.0f;
+}
+
+void ACarbonGameMode::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// Enemy meshes register themselves with the budget allocator (see AEnemyBase::UpdateAnimationSignificance)
+	if (IAnimationBudgetAllocator* Allocator = IAnimationBudgetAllocator::Get(GetWorld()))
+	{
+		FAnimationBudgetAllocatorParameters Parameters;
+		Parameters.BudgetInMs = AnimationBudgetMs;
+		Allocator->SetParameters(Parameters);
+		Allocator->SetEnabled(true);
+	}
 }
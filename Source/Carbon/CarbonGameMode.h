@@ -13,6 +13,13 @@ class ACarbonGameMode : public AGameModeBase
 
 public:
 	ACarbonGameMode();
+
+	/** Milliseconds per frame enemy skeletal mesh animation is allowed to use */
+	UPROPERTY(EditAnywhere, Category = "Animation")
+	float AnimationBudgetMs;
+
+protected:
+	virtual void BeginPlay() override;
 };
 
 
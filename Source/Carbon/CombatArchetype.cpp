@@ -0,0 +1,177 @@
+// Sam Smith
+
+#include "CombatArchetype.h"
+#include "Carbon.h"
+#include "Combatant.h"
+#include "Animation/AnimMontage.h"
+#include "Engine/AssetManager.h"
+#include "Engine/StreamableManager.h"
+
+#if WITH_EDITOR
+FOnCombatTuningChanged UCombatArchetype::OnTuningChanged;
+
+void UCombatArchetype::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	OnTuningChanged.Broadcast(this);
+}
+#endif
+
+void UCombatArchetype::GetStreamedAssets(TArray<FSoftObjectPath>& OutPaths) const
+{
+	for (const TSoftObjectPtr<UAnimMontage>& Montage : AttackAnimations)
+		OutPaths.Add(Montage.ToSoftObjectPath());
+	for (const TSoftObjectPtr<UAnimMontage>& Montage : TakeHit_StumbleBackwards)
+		OutPaths.Add(Montage.ToSoftObjectPath());
+	for (const TSoftObjectPtr<UAnimMontage>& Montage : LongAttackAnimations)
+		OutPaths.Add(Montage.ToSoftObjectPath());
+	OutPaths.Add(OverheadSmash.ToSoftObjectPath());
+	OutPaths.Add(CombatRoll.ToSoftObjectPath());
+	OutPaths.Add(Taunt.ToSoftObjectPath());
+
+	OutPaths.RemoveAll([](const FSoftObjectPath& Path) { return Path.IsNull(); });
+}
+
+void UCombatArchetypeSubsystem::Acquire(UCombatArchetype* Archetype)
+{
+	if (!Archetype)
+		return;
+
+	FArchetypeStreaming& Entry = Streaming.FindOrAdd(Archetype);
+	if (Entry.RefCount++ > 0)
+		return;
+
+	TArray<FSoftObjectPath> Paths;
+	Archetype->GetStreamedAssets(Paths);
+	if (Paths.Num() > 0)
+		Entry.Handle = UAssetManager::GetStreamableManager().RequestAsyncLoad(Paths, FStreamableDelegate(), FStreamableManager::AsyncLoadHighPriority);
+
+	UE_LOG(LogCarbon, Verbose, TEXT("Streaming archetype %s (%d assets)"), *Archetype->GetName(), Paths.Num());
+}
+
+void UCombatArchetypeSubsystem::Release(UCombatArchetype* Archetype)
+{
+	FArchetypeStreaming* Entry = Archetype ? Streaming.Find(Archetype) : nullptr;
+	if (!Entry || --Entry->RefCount > 0)
+		return;
+
+	if (Entry->Handle.IsValid())
+		Entry->Handle->ReleaseHandle();
+	Streaming.Remove(Archetype);
+}
+
+bool UCombatArchetypeSubsystem::IsLoaded(const UCombatArchetype* Archetype) const
+{
+	const FArchetypeStreaming* Entry = Archetype ? Streaming.Find(Archetype) : nullptr;
+	if (!Entry)
+		return false;
+
+	// No handle means there was nothing to stream
+	return !Entry->Handle.IsValid() || Entry->Handle->HasLoadCompleted();
+}
+
+namespace
+{
+	/** Archetype holding Source's deprecated montages, or null if it sets none */
+	UCombatArchetype* BuildLegacyArchetype(const ACombatant* Source, UObject* Outer, FName Name)
+	{
+		UCombatArchetype* Legacy = NewObject<UCombatArchetype>(Outer, Name, RF_Transient);
+		Source->GetLegacyMontages(*Legacy);
+
+		TArray<FSoftObjectPath> Paths;
+		Legacy->GetStreamedAssets(Paths);
+		return Paths.Num() > 0 ? Legacy : nullptr;
+	}
+
+	bool HasSameMontages(const UCombatArchetype* A, const UCombatArchetype* B)
+	{
+		if (!A || !B)
+			return A == B;
+
+		return A->AttackAnimations == B->AttackAnimations
+			&& A->TakeHit_StumbleBackwards == B->TakeHit_StumbleBackwards
+			&& A->LongAttackAnimations == B->LongAttackAnimations
+			&& A->OverheadSmash == B->OverheadSmash
+			&& A->Taunt == B->Taunt
+			&& A->CombatRoll == B->CombatRoll;
+	}
+}
+
+UCombatArchetype* UCombatArchetypeSubsystem::GetLegacyArchetype(const ACombatant* Combatant)
+{
+	UClass* Class = Combatant->GetClass();
+	UCombatArchetype* ClassLegacy;
+	if (UCombatArchetype** Found = LegacyArchetypes.Find(Class))
+		ClassLegacy = *Found;
+	else
+	{
+		ClassLegacy = BuildLegacyArchetype(Class->GetDefaultObject<ACombatant>(), this, *FString::Printf(TEXT("LegacyArchetype_%s"), *Class->GetName()));
+		LegacyArchetypes.Add(Class, ClassLegacy);
+		if (ClassLegacy)
+			UE_LOG(LogCarbon, Warning, TEXT("%s has no combat archetype - using its deprecated montage properties until one is assigned"), *Class->GetName());
+	}
+
+	if (Combatant->HasAnyFlags(RF_ClassDefaultObject))
+		return ClassLegacy;
+
+	// Kept alive by the combatant it is outered to (and assigned to), only while it differs
+	UCombatArchetype* Legacy = BuildLegacyArchetype(Combatant, const_cast<ACombatant*>(Combatant), NAME_None);
+	if (HasSameMontages(Legacy, ClassLegacy))
+		return ClassLegacy;
+
+	if (Legacy)
+		UE_LOG(LogCarbon, Warning, TEXT("%s overrides its class's deprecated montage properties - using them until an archetype is assigned"), *Combatant->GetName());
+	return Legacy;
+}
+
+int32 UCombatArchetypeSubsystem::GetTuningIndex(UCombatArchetype* Archetype)
+{
+	if (!Archetype)
+		return 0;
+
+	if (const int32* Index = TuningIndices.Find(Archetype))
+		return *Index;
+
+	// Copied once - every instance of the archetype then shares this row
+	int32 Index = TuningTable.AddDefaulted();
+	TuningTable[Index].Tuning = Archetype->Tuning;
+	TuningIndices.Add(Archetype, Index);
+	return Index;
+}
+
+void UCombatArchetypeSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	// Row 0: defaults
+	TuningTable.AddDefaulted();
+
+#if WITH_EDITOR
+	TuningChangedHandle = UCombatArchetype::OnTuningChanged.AddUObject(this, &UCombatArchetypeSubsystem::OnTuningChanged);
+#endif
+}
+
+#if WITH_EDITOR
+void UCombatArchetypeSubsystem::OnTuningChanged(UCombatArchetype* Archetype)
+{
+	if (const int32* Index = TuningIndices.Find(Archetype))
+		TuningTable[*Index].Tuning = Archetype->Tuning;
+}
+#endif
+
+void UCombatArchetypeSubsystem::Deinitialize()
+{
+#if WITH_EDITOR
+	UCombatArchetype::OnTuningChanged.Remove(TuningChangedHandle);
+#endif
+
+	for (auto& Pair : Streaming)
+	{
+		if (Pair.Value.Handle.IsValid())
+			Pair.Value.Handle->ReleaseHandle();
+	}
+	Streaming.Empty();
+
+	Super::Deinitialize();
+}
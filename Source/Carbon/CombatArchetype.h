@@ -0,0 +1,195 @@
+// Sam Smith
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UtilityAI.h"
+#include "CombatCore.h"
+#include "CombatArchetype.generated.h"
+
+class UAnimMontage;
+class ACombatant;
+struct FStreamableHandle;
+
+/** Combat numbers shared by every combatant of one archetype */
+USTRUCT(BlueprintType)
+struct CARBON_API FCombatTuning
+{
+	GENERATED_BODY()
+
+	/** Idle enemies notice targets within this distance */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Tuning")
+	float AggroRange = 1200.0f;
+
+	/** Melee attacks start within this distance */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Tuning")
+	float AttackRange = 300.0f;
+
+	/** CHASE_FAR enemies re-engage once the target is closer than this */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Tuning")
+	float ChaseFarRange = 850.0f;
+
+	/** Minimum dot(forward, direction to target) before attacking */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Tuning")
+	float AttackFacingDot = 0.95f;
+
+	/** Knight: long-range jump attacks start within this distance */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Tuning")
+	float LongAttackRange = 900.0f;
+
+	/** Knight: extra jump speed on top of the distance to the target */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Tuning")
+	float LongAttackJumpBonus = 600.0f;
+
+	/** Speed of forward motion during attacks */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Tuning")
+	float ForwardMotionSpeed = 500.0f;
+
+	/** Enemies further than this from their target walk on the navmesh (no floor sweeps) */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Tuning")
+	float NavWalkingRange = 600.0f;
+
+	/** Distance covered by AttackLunge */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Tuning")
+	float LungeDistance = 70.0f;
+
+	/** Player: targets further than this are dropped (and not considered) */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Tuning")
+	float TargetLockDistance = 1500.0f;
+
+	/** Movement input scale when pushed back by a stumble */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Tuning")
+	float StumblePushScale = 40.0f;
+
+	/** The numbers the engine-free combat core works with */
+	CombatCore::FEnemyTuning GetCoreTuning() const
+	{
+		return { AggroRange, AttackRange, ChaseFarRange, AttackFacingDot, LongAttackRange, LongAttackJumpBonus };
+	}
+};
+
+/** Runtime copy of an archetype's tuning - one cache line each, read-only for combatants */
+struct alignas(PLATFORM_CACHE_LINE_SIZE) FCombatTuningRow
+{
+	FCombatTuning Tuning;
+};
+
+#if WITH_EDITOR
+DECLARE_MULTICAST_DELEGATE_OneParam(FOnCombatTuningChanged, class UCombatArchetype*);
+#endif
+
+/**
+ * Everything one kind of combatant (player, base enemy, knight, ...) shares.
+ * Animations are soft references: they are only streamed in while at least one
+ * combatant of this archetype is alive (see UCombatArchetypeSubsystem).
+ */
+UCLASS(BlueprintType)
+class CARBON_API UCombatArchetype : public UPrimaryDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	/** Enemies pick one at random, the player plays them in order as a combo */
+	UPROPERTY(EditAnywhere, Category = "Animations")
+	TArray<TSoftObjectPtr<UAnimMontage>> AttackAnimations;
+
+	UPROPERTY(EditAnywhere, Category = "Animations")
+	TArray<TSoftObjectPtr<UAnimMontage>> TakeHit_StumbleBackwards;
+
+	/** Knight: long-range jump attacks */
+	UPROPERTY(EditAnywhere, Category = "Animations")
+	TArray<TSoftObjectPtr<UAnimMontage>> LongAttackAnimations;
+
+	UPROPERTY(EditAnywhere, Category = "Animations")
+	TSoftObjectPtr<UAnimMontage> OverheadSmash;
+
+	/** Enemies: played by squad taunters (optional) */
+	UPROPERTY(EditAnywhere, Category = "Animations")
+	TSoftObjectPtr<UAnimMontage> Taunt;
+
+	/** Player: dodge roll */
+	UPROPERTY(EditAnywhere, Category = "Animations")
+	TSoftObjectPtr<UAnimMontage> CombatRoll;
+
+	UPROPERTY(EditAnywhere, Category = "Tuning", meta = (ShowOnlyInnerProperties))
+	FCombatTuning Tuning;
+
+	/** Enemies: how chasing actions are scored (empty = the defaults built from Tuning) */
+	UPROPERTY(EditAnywhere, Category = "AI")
+	TArray<FUtilityActionScoring> Actions;
+
+#if WITH_EDITOR
+	/** Broadcast when Tuning is edited, so running games pick the new values up */
+	static FOnCombatTuningChanged OnTuningChanged;
+
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+	/** Collect every asset that has to be streamed in before this archetype can fight */
+	void GetStreamedAssets(TArray<FSoftObjectPath>& OutPaths) const;
+};
+
+/**
+ * Streams archetype assets in asynchronously and keeps them resident while referenced.
+ * Combatants acquire their archetype in BeginPlay and release it in EndPlay; encounters
+ * can acquire an archetype ahead of time as a preload hint and release it once spawned.
+ */
+UCLASS()
+class CARBON_API UCombatArchetypeSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/** Add a reference to Archetype, starting its async load if it is the first one */
+	void Acquire(UCombatArchetype* Archetype);
+
+	/** Drop a reference - the assets may be unloaded once nothing references them */
+	void Release(UCombatArchetype* Archetype);
+
+	/** True once all of Archetype's assets are in memory */
+	bool IsLoaded(const UCombatArchetype* Archetype) const;
+
+	/** Row of Archetype's tuning in the tuning table (row 0 holds the defaults, used for null) */
+	int32 GetTuningIndex(UCombatArchetype* Archetype);
+
+	/**
+	 * Transient archetype built from Combatant's deprecated montage properties, for blueprints
+	 * that were set up before archetypes (null if they set no montages either). Instances with
+	 * their class's montages share one per class (and so its streaming and tuning row); a placed
+	 * instance that overrides them gets its own, outered to it.
+	 */
+	UCombatArchetype* GetLegacyArchetype(const ACombatant* Combatant);
+
+	const FCombatTuning& GetTuning(int32 TuningIndex) const { return TuningTable[TuningIndex].Tuning; }
+
+	/** Contiguous tuning table, for batched systems indexing by GetTuningIndex */
+	const FCombatTuningRow* GetTuningTable() const { return TuningTable.GetData(); }
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	virtual void Deinitialize() override;
+
+private:
+	struct FArchetypeStreaming
+	{
+		TSharedPtr<FStreamableHandle> Handle;
+		int32 RefCount = 0;
+	};
+
+	TMap<TObjectKey<UCombatArchetype>, FArchetypeStreaming> Streaming;
+
+	TArray<FCombatTuningRow, TAlignedHeapAllocator<PLATFORM_CACHE_LINE_SIZE>> TuningTable;
+	TMap<TObjectKey<UCombatArchetype>, int32> TuningIndices;
+
+	/** Legacy archetype of each class's defaults (null when they set no montages) */
+	UPROPERTY(Transient)
+	TMap<UClass*, UCombatArchetype*> LegacyArchetypes;
+
+#if WITH_EDITOR
+	void OnTuningChanged(UCombatArchetype* Archetype);
+
+	FDelegateHandle TuningChangedHandle;
+#endif
+};
@@ -0,0 +1,303 @@
+// Sam Smith
+
+#include "CombatArena.h"
+#include "Carbon.h"
+#include "CombatArchetype.h"
+#include "EnemyBase.h"
+#include "EnemyPool.h"
+#include "Engine/AssetManager.h"
+#include "Engine/LevelStreamingDynamic.h"
+#include "Engine/StreamableManager.h"
+#include "Engine/World.h"
+#include "Kismet/GameplayStatics.h"
+
+DECLARE_CYCLE_STAT(TEXT("Arena Streaming"), STAT_ArenaStreaming, STATGROUP_Carbon);
+
+static TAutoConsoleVariable<float> CVarArenaHitchBudgetMs(
+	TEXT("carbon.Arena.HitchBudgetMs"), 20.0f,
+	TEXT("Frames longer than this while an arena is loading are reported as hitches."));
+
+static FAutoConsoleCommandWithWorldAndArgs ArenaTraverseCommand(
+	TEXT("carbon.Arena.Traverse"),
+	TEXT("carbon.Arena.Traverse [TimeoutSeconds] [quit] - visit every arena and report load times and hitches"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UCombatArenaSubsystem* Arenas = World ? World->GetSubsystem<UCombatArenaSubsystem>() : nullptr)
+			Arenas->StartTraversal(Args.Num() > 0 ? FCString::Atof(*Args[0]) : 10.0f, Args.Num() > 1 && Args[1] == TEXT("quit"));
+	}));
+
+ACombatArena::ACombatArena()
+{
+	PrimaryActorTick.bCanEverTick = false;
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+
+	LoadRadius = 4000.0f;
+	UnloadRadius = 5000.0f;
+	ArenaState = EArenaState::UNLOADED;
+	StreamingLevel = nullptr;
+	ClassesLoaded = false;
+}
+
+void ACombatArena::BeginPlay()
+{
+	Super::BeginPlay();
+
+	GetWorld()->GetSubsystem<UCombatArenaSubsystem>()->Register(this);
+}
+
+void ACombatArena::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	// When the whole world goes away there is nothing to hand enemies back to
+	if (EndPlayReason == EEndPlayReason::Destroyed || EndPlayReason == EEndPlayReason::RemovedFromWorld)
+		Unload();
+
+	if (UCombatArenaSubsystem* Arenas = GetWorld()->GetSubsystem<UCombatArenaSubsystem>())
+		Arenas->Unregister(this);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ACombatArena::Load()
+{
+	if (ArenaState != EArenaState::UNLOADED)
+		return;
+
+	ArenaState = EArenaState::LOADING;
+
+	if (!Level.IsNull())
+	{
+		bool Success = false;
+		StreamingLevel = ULevelStreamingDynamic::LoadLevelInstanceBySoftObjectPtr(this, Level, GetActorLocation(), GetActorRotation(), Success);
+		if (!Success)
+			UE_LOG(LogCarbon, Warning, TEXT("%s could not stream in %s"), *GetName(), *Level.ToString());
+	}
+
+	TArray<FSoftObjectPath> Paths;
+	for (const FArenaSpawn& Spawn : Spawns)
+	{
+		if (!Spawn.EnemyClass.IsNull())
+			Paths.AddUnique(Spawn.EnemyClass.ToSoftObjectPath());
+	}
+
+	ClassesLoaded = false;
+	if (Paths.Num() > 0)
+		ClassesHandle = UAssetManager::GetStreamableManager().RequestAsyncLoad(Paths,
+			FStreamableDelegate::CreateUObject(this, &ACombatArena::OnClassesLoaded), FStreamableManager::AsyncLoadHighPriority);
+	else
+		OnClassesLoaded();
+}
+
+void ACombatArena::OnClassesLoaded()
+{
+	ClassesLoaded = true;
+
+	UCombatArchetypeSubsystem* ArchetypeSubsystem = GetWorld()->GetSubsystem<UCombatArchetypeSubsystem>();
+	UEnemyPoolSubsystem* Pool = GetWorld()->GetSubsystem<UEnemyPoolSubsystem>();
+
+	TMap<UClass*, int32> Counts;
+	for (const FArenaSpawn& Spawn : Spawns)
+	{
+		if (UClass* Class = Spawn.EnemyClass.Get())
+			++Counts.FindOrAdd(Class);
+	}
+
+	for (const auto& Pair : Counts)
+	{
+		// Stream the animations in alongside the pre-warm, instead of on the first BeginPlay
+		UCombatArchetype* Archetype = GetDefault<AEnemyBase>(Pair.Key)->GetArchetype();
+		if (Archetype && !Archetypes.Contains(Archetype))
+		{
+			ArchetypeSubsystem->Acquire(Archetype);
+			Archetypes.Add(Archetype);
+		}
+
+		Pool->Prewarm(Pair.Key, Pair.Value, GetActorLocation());
+	}
+}
+
+bool ACombatArena::TryActivate(AActor* Target)
+{
+	if (ArenaState == EArenaState::ACTIVE)
+		return true;
+	if (ArenaState != EArenaState::LOADING || !ClassesLoaded)
+		return false;
+
+	// Enemies need the floor to stand on
+	if (StreamingLevel && !StreamingLevel->IsLevelVisible())
+		return false;
+
+	UCombatArchetypeSubsystem* ArchetypeSubsystem = GetWorld()->GetSubsystem<UCombatArchetypeSubsystem>();
+	for (UCombatArchetype* Archetype : Archetypes)
+	{
+		if (!ArchetypeSubsystem->IsLoaded(Archetype))
+			return false;
+	}
+
+	UEnemyPoolSubsystem* Pool = GetWorld()->GetSubsystem<UEnemyPoolSubsystem>();
+	for (const FArenaSpawn& Spawn : Spawns)
+	{
+		if (Pool->IsPrewarming(Spawn.EnemyClass.Get()))
+			return false;
+	}
+
+	for (const FArenaSpawn& Spawn : Spawns)
+	{
+		if (AEnemyBase* Enemy = Pool->Acquire(Spawn.EnemyClass.Get(), Spawn.Transform * GetActorTransform(), Target))
+			Enemies.Add(Enemy);
+	}
+
+	ArenaState = EArenaState::ACTIVE;
+	UE_LOG(LogCarbon, Verbose, TEXT("%s active with %d enemies"), *GetName(), Enemies.Num());
+	return true;
+}
+
+void ACombatArena::Unload()
+{
+	if (ArenaState == EArenaState::UNLOADED)
+		return;
+
+	if (UEnemyPoolSubsystem* Pool = GetWorld()->GetSubsystem<UEnemyPoolSubsystem>())
+	{
+		for (AEnemyBase* Enemy : Enemies)
+			Pool->Release(Enemy);
+	}
+	Enemies.Reset();
+
+	if (UCombatArchetypeSubsystem* ArchetypeSubsystem = GetWorld()->GetSubsystem<UCombatArchetypeSubsystem>())
+	{
+		for (UCombatArchetype* Archetype : Archetypes)
+			ArchetypeSubsystem->Release(Archetype);
+	}
+	Archetypes.Reset();
+
+	if (ClassesHandle.IsValid())
+	{
+		ClassesHandle->CancelHandle();
+		ClassesHandle.Reset();
+	}
+	ClassesLoaded = false;
+
+	if (StreamingLevel)
+	{
+		StreamingLevel->SetIsRequestingUnloadAndRemoval(true);
+		StreamingLevel = nullptr;
+	}
+
+	ArenaState = EArenaState::UNLOADED;
+}
+
+void UCombatArenaSubsystem::Tick(float DeltaTime)
+{
+	APawn* Player = UGameplayStatics::GetPlayerPawn(GetWorld(), 0);
+	if (!Player)
+		return;
+
+	bool Loading = false;
+	{
+		SCOPE_CYCLE_COUNTER(STAT_ArenaStreaming);
+
+		const FVector PlayerLocation = Player->GetActorLocation();
+		for (ACombatArena* Arena : Arenas)
+		{
+			if (!Arena)
+				continue;
+
+			const float DistanceSquared = FVector::DistSquared(PlayerLocation, Arena->GetActorLocation());
+			if (Arena->GetArenaState() == EArenaState::UNLOADED)
+			{
+				if (DistanceSquared <= FMath::Square(Arena->LoadRadius))
+					Arena->Load();
+			}
+			else if (DistanceSquared > FMath::Square(Arena->UnloadRadius))
+				Arena->Unload();
+			else
+				Arena->TryActivate(Player);
+
+			Loading |= Arena->GetArenaState() == EArenaState::LOADING;
+		}
+	}
+
+	const float FrameMs = DeltaTime * 1000.0f;
+	const float BudgetMs = CVarArenaHitchBudgetMs.GetValueOnGameThread();
+	if ((Loading || WasLoading) && FrameMs > BudgetMs)
+		UE_LOG(LogCarbon, Warning, TEXT("%.1f ms frame while arenas were loading (budget %.1f ms)"), FrameMs, BudgetMs);
+	WasLoading = Loading;
+
+	if (Traversal.Running)
+		TickTraversal(Player, DeltaTime);
+}
+
+void UCombatArenaSubsystem::StartTraversal(float TimeoutSeconds, bool QuitWhenDone)
+{
+	Traversal = FTraversal();
+	Traversal.Running = true;
+	Traversal.QuitWhenDone = QuitWhenDone;
+	Traversal.TimeoutSeconds = TimeoutSeconds;
+
+	UE_LOG(LogCarbon, Display, TEXT("Arena traversal: visiting %d arenas"), Arenas.Num());
+}
+
+void UCombatArenaSubsystem::TickTraversal(APawn* Player, float DeltaTime)
+{
+	// Started from the console, so the first arena is visited on the next frame
+	if (Traversal.ArenaIndex == INDEX_NONE)
+	{
+		VisitNextArena(Player);
+		return;
+	}
+
+	Traversal.ArenaTime += DeltaTime;
+	Traversal.ArenaWorstFrameMs = FMath::Max(Traversal.ArenaWorstFrameMs, DeltaTime * 1000.0f);
+
+	ACombatArena* Arena = Arenas.IsValidIndex(Traversal.ArenaIndex) ? Arenas[Traversal.ArenaIndex] : nullptr;
+	const bool Active = Arena && Arena->GetArenaState() == EArenaState::ACTIVE;
+	if (!Active && Traversal.ArenaTime < Traversal.TimeoutSeconds)
+		return;
+
+	if (Active)
+		UE_LOG(LogCarbon, Display, TEXT("Arena traversal: %s active after %.2f s, worst frame %.1f ms"),
+			*Arena->GetName(), Traversal.ArenaTime, Traversal.ArenaWorstFrameMs);
+	else
+	{
+		UE_LOG(LogCarbon, Warning, TEXT("Arena traversal: %s not active after %.2f s"),
+			Arena ? *Arena->GetName() : TEXT("(removed)"), Traversal.ArenaTime);
+		++Traversal.TimedOut;
+	}
+
+	Traversal.WorstFrameMs = FMath::Max(Traversal.WorstFrameMs, Traversal.ArenaWorstFrameMs);
+	VisitNextArena(Player);
+}
+
+void UCombatArenaSubsystem::VisitNextArena(APawn* Player)
+{
+	++Traversal.ArenaIndex;
+	Traversal.ArenaTime = 0.0f;
+	Traversal.ArenaWorstFrameMs = 0.0f;
+
+	if (Traversal.ArenaIndex >= Arenas.Num())
+	{
+		const float BudgetMs = CVarArenaHitchBudgetMs.GetValueOnGameThread();
+		const bool Passed = Traversal.TimedOut == 0 && Traversal.WorstFrameMs <= BudgetMs;
+		UE_LOG(LogCarbon, Display, TEXT("Arena traversal: %d arenas, %d timed out, worst frame %.1f ms (budget %.1f ms) - %s"),
+			Arenas.Num(), Traversal.TimedOut, Traversal.WorstFrameMs, BudgetMs, Passed ? TEXT("PASSED") : TEXT("FAILED"));
+
+		Traversal.Running = false;
+		if (Traversal.QuitWhenDone)
+			FPlatformMisc::RequestExit(false);
+		return;
+	}
+
+	// Arrive from the arena's front, well inside the load radius
+	if (ACombatArena* Arena = Arenas[Traversal.ArenaIndex])
+		Player->TeleportTo(Arena->GetActorLocation() - Arena->GetActorForwardVector() * Arena->LoadRadius * 0.5f, Player->GetActorRotation());
+}
+
+ETickableTickType UCombatArenaSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Always;
+}
+
+TStatId UCombatArenaSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UCombatArenaSubsystem, STATGROUP_Tickables);
+}
@@ -0,0 +1,156 @@
+// Sam Smith
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "CombatArena.generated.h"
+
+class AEnemyBase;
+class UCombatArchetype;
+class ULevelStreamingDynamic;
+struct FStreamableHandle;
+
+/** One enemy an arena fields once it is loaded */
+USTRUCT(BlueprintType)
+struct FArenaSpawn
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, Category = "Arena")
+	TSoftClassPtr<AEnemyBase> EnemyClass;
+
+	/** Relative to the arena */
+	UPROPERTY(EditAnywhere, Category = "Arena", meta = (MakeEditWidget))
+	FTransform Transform;
+};
+
+UENUM(BlueprintType)
+enum class EArenaState : uint8
+{
+	UNLOADED,				// Nothing resident
+	LOADING,				// Geometry, enemy classes, archetypes and pooled enemies streaming in
+	ACTIVE					// Enemies fielded
+};
+
+/**
+ * A combat space streamed in as the player approaches.
+ * Within LoadRadius of the player its sublevel is streamed in as a level instance, its enemy
+ * classes and their archetypes are loaded asynchronously and enough enemies are pre-warmed in
+ * UEnemyPoolSubsystem. Once all of that is ready the enemies are taken from the pool. Beyond
+ * UnloadRadius the enemies go back to the pool and everything else is released.
+ * Driven by UCombatArenaSubsystem.
+ */
+UCLASS()
+class CARBON_API ACombatArena : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ACombatArena();
+
+	/** Geometry of the arena, streamed in at the arena's transform (optional) */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Arena")
+	TSoftObjectPtr<UWorld> Level;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Arena")
+	TArray<FArenaSpawn> Spawns;
+
+	/** Loading starts when the player comes this close */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Arena")
+	float LoadRadius;
+
+	/** Unloading starts when the player is further away than this (keep above LoadRadius) */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Arena")
+	float UnloadRadius;
+
+	EArenaState GetArenaState() const { return ArenaState; }
+
+	/** Start streaming everything in */
+	void Load();
+
+	/** Field the enemies if everything has finished loading - returns true once ACTIVE */
+	bool TryActivate(AActor* Target);
+
+	/** Return the enemies to the pool and release everything */
+	void Unload();
+
+protected:
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	/** Enemy classes are loaded - acquire their archetypes and start pre-warming */
+	void OnClassesLoaded();
+
+	EArenaState ArenaState;
+
+	UPROPERTY(Transient)
+	ULevelStreamingDynamic* StreamingLevel;
+
+	TSharedPtr<FStreamableHandle> ClassesHandle;
+
+	bool ClassesLoaded;
+
+	/** Archetypes acquired as a preload hint while loaded */
+	UPROPERTY(Transient)
+	TArray<UCombatArchetype*> Archetypes;
+
+	UPROPERTY(Transient)
+	TArray<AEnemyBase*> Enemies;
+};
+
+/**
+ * Loads and unloads arenas by the player's distance to them.
+ * The carbon.Arena.Traverse console command teleports the player through every arena
+ * in turn and reports load times and the worst frame seen while loading, e.g.
+ *   Carbon -game -nullrhi -ExecCmds="carbon.Arena.Traverse 10 quit"
+ */
+UCLASS()
+class CARBON_API UCombatArenaSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	void Register(ACombatArena* Arena) { Arenas.AddUnique(Arena); }
+
+	void Unregister(ACombatArena* Arena) { Arenas.RemoveSingle(Arena); }
+
+	/** Visit every arena, waiting up to TimeoutSeconds for each to activate */
+	void StartTraversal(float TimeoutSeconds, bool QuitWhenDone);
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+private:
+	void TickTraversal(APawn* Player, float DeltaTime);
+
+	/** Teleport the player to the next arena, or report and finish */
+	void VisitNextArena(APawn* Player);
+
+	UPROPERTY(Transient)
+	TArray<ACombatArena*> Arenas;
+
+	/** Any arena was loading last frame (its hitches show up in this frame's delta) */
+	bool WasLoading = false;
+
+	struct FTraversal
+	{
+		bool Running = false;
+		bool QuitWhenDone = false;
+		float TimeoutSeconds = 0.0f;
+		int32 ArenaIndex = INDEX_NONE;
+		float ArenaTime = 0.0f;
+		float ArenaWorstFrameMs = 0.0f;
+		float WorstFrameMs = 0.0f;
+		int32 TimedOut = 0;
+	};
+
+	FTraversal Traversal;
+};
@@ -0,0 +1,105 @@
+// Sam Smith
+
+#include "CombatClock.h"
+#include "Carbon.h"
+#include "CombatantRegistry.h"
+#include "Engine/World.h"
+#include "GameFramework/WorldSettings.h"
+
+DECLARE_CYCLE_STAT(TEXT("Combat Clock"), STAT_CombatClock, STATGROUP_Carbon);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Combatants In Hit-Stop"), STAT_CombatantsInHitStop, STATGROUP_Carbon);
+
+void UCombatClockSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Registry = Collection.InitializeDependency<UCombatantRegistry>();
+	Super::Initialize(Collection);
+
+	TickStartHandle = FWorldDelegates::OnWorldTickStart.AddUObject(this, &UCombatClockSubsystem::OnWorldTickStart);
+}
+
+void UCombatClockSubsystem::Deinitialize()
+{
+	FWorldDelegates::OnWorldTickStart.Remove(TickStartHandle);
+
+	Super::Deinitialize();
+}
+
+void UCombatClockSubsystem::HitStop(ACombatant* Combatant, float Duration, float Scale)
+{
+	FCombatantHandle Handle = ACombatant::GetHandleOf(Combatant);
+	if (!Handle.IsSet() || Duration <= 0.0f)
+		return;
+
+	SyncRows();
+
+	// Overlapping hit-stops keep the longest and the slowest
+	const int32 Slot = Handle.GetIndex();
+	const bool Stopped = HitStopRemaining[Slot] > 0.0f;
+	HitStopRemaining[Slot] = FMath::Max(HitStopRemaining[Slot], Duration);
+	HitStopScales[Slot] = Stopped ? FMath::Min(HitStopScales[Slot], Scale) : Scale;
+}
+
+void UCombatClockSubsystem::SyncRows()
+{
+	const int32 NumSlots = Registry->GetNumSlots();
+	const float Now = GetWorld()->GetTimeSeconds();
+
+	for (int32 Slot = 0; Slot < NumSlots; ++Slot)
+	{
+		FCombatantHandle Handle = Registry->GetCombatant(Slot) ? Registry->GetHandle(Slot) : FCombatantHandle();
+		if (Owners.IsValidIndex(Slot) && Owners[Slot] == Handle)
+			continue;
+
+		if (Slot == Owners.Num())
+		{
+			Owners.Add(Handle);
+			TimeScales.Add(1.0f);
+			DeltaTimes.Add(0.0f);
+			LocalTimes.Add(Now);
+			HitStopRemaining.Add(0.0f);
+			HitStopScales.Add(1.0f);
+			continue;
+		}
+
+		Owners[Slot] = Handle;
+		TimeScales[Slot] = 1.0f;
+		DeltaTimes[Slot] = 0.0f;
+		LocalTimes[Slot] = Now;
+		HitStopRemaining[Slot] = 0.0f;
+		HitStopScales[Slot] = 1.0f;
+	}
+}
+
+void UCombatClockSubsystem::OnWorldTickStart(UWorld* World, ELevelTick TickType, float DeltaTime)
+{
+	if (World != GetWorld() || World->IsPaused())
+		return;
+
+	SCOPE_CYCLE_COUNTER(STAT_CombatClock);
+
+	SyncRows();
+
+	// The world's delta this frame, before any combatant's own scale
+	const float WorldDelta = DeltaTime * World->GetWorldSettings()->GetEffectiveTimeDilation();
+	const int32 NumSlots = Owners.Num();
+
+	for (int32 Slot = 0; Slot < NumSlots; ++Slot)
+	{
+		const bool Stopped = HitStopRemaining[Slot] > 0.0f;
+		const float Scale = Stopped ? HitStopScales[Slot] : 1.0f;
+		HitStopRemaining[Slot] -= WorldDelta;
+		DeltaTimes[Slot] = WorldDelta * Scale;
+		LocalTimes[Slot] += DeltaTimes[Slot];
+
+		if (Stopped)
+			INC_DWORD_STAT(STAT_CombatantsInHitStop);
+
+		// Only touch the actor when its rate changes
+		if (Scale != TimeScales[Slot])
+		{
+			TimeScales[Slot] = Scale;
+			if (ACombatant* Combatant = Registry->GetCombatant(Slot))
+				Combatant->CustomTimeDilation = Scale;
+		}
+	}
+}
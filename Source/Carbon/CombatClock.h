@@ -0,0 +1,62 @@
+// Sam Smith
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Engine/EngineBaseTypes.h"
+#include "Combatant.h"
+#include "CombatClock.generated.h"
+
+/**
+ * Per-combatant time, so hit-stop slows down the combatants in a hit instead of the world.
+ * One row per UCombatantRegistry slot: time scale, this frame's scaled delta time and local
+ * time (world time when the combatant registered, advancing at its own rate since).
+ * Rows are advanced once at the start of every world tick, and each combatant's scale is
+ * applied as its CustomTimeDilation, so its tick, movement (root motion included) and
+ * montages run at the same rate as its FSM timers.
+ * Batched systems read GetDeltaTimes(), indexed by registry slot.
+ */
+UCLASS()
+class CARBON_API UCombatClockSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/** Run Combatant's time at Scale for the next Duration seconds (of world time) */
+	void HitStop(ACombatant* Combatant, float Duration, float Scale);
+
+	/** Local time of registry slot Slot (world time for slots without a row yet) */
+	float GetLocalTime(int32 Slot) const { return LocalTimes.IsValidIndex(Slot) ? LocalTimes[Slot] : GetWorld()->GetTimeSeconds(); }
+
+	/** Scaled delta time of registry slot Slot this frame */
+	float GetDeltaTime(int32 Slot) const { return DeltaTimes.IsValidIndex(Slot) ? DeltaTimes[Slot] : GetWorld()->GetDeltaSeconds(); }
+
+	/** Scaled delta times this frame, indexed by registry slot (GetNumSlots() of them) */
+	const float* GetDeltaTimes() const { return DeltaTimes.GetData(); }
+
+	int32 GetNumSlots() const { return DeltaTimes.Num(); }
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	virtual void Deinitialize() override;
+
+private:
+	void OnWorldTickStart(UWorld* World, ELevelTick TickType, float DeltaTime);
+
+	/** Add rows for new registry slots and reset rows whose slot changed hands */
+	void SyncRows();
+
+	UPROPERTY(Transient)
+	UCombatantRegistry* Registry;
+
+	// Columns - one row per registry slot
+	TArray<FCombatantHandle> Owners;
+	TArray<float> TimeScales;
+	TArray<float> DeltaTimes;
+	TArray<float> LocalTimes;
+	TArray<float> HitStopRemaining;
+	TArray<float> HitStopScales;
+
+	FDelegateHandle TickStartHandle;
+};
@@ -0,0 +1,501 @@
+// Sam Smith
+
+#include "CombatCore.h"
+#include <cmath>
+
+namespace CombatCore
+{
+	static const float DegreesToRadians = 3.14159265358979f / 180.0f;
+
+	bool CanAttack(const FActionState& State)
+	{
+		return (!State.Attacking || State.NextAttackReady) && !State.Rolling && !State.Stumbling && !State.Falling && State.Loaded;
+	}
+
+	bool CanRoll(const FActionState& State)
+	{
+		return !State.Rolling && !State.Stumbling && State.Loaded;
+	}
+
+	bool IsInputBuffered(float Timestamp, float Window, float Now)
+	{
+		return Timestamp >= 0.0f && Now - Timestamp <= Window;
+	}
+
+	EBufferedInput ResolveBufferedInput(const FActionState& State, float Now,
+		float AttackTime, float AttackWindow, float RollTime, float RollWindow)
+	{
+		// Only the latest press is ever buffered, so at most one of these can fire
+		if (IsInputBuffered(RollTime, RollWindow, Now) && CanRoll(State))
+			return EBufferedInput::Roll;
+		if (IsInputBuffered(AttackTime, AttackWindow, Now) && CanAttack(State))
+			return EBufferedInput::Attack;
+		return EBufferedInput::None;
+	}
+
+	int32_t ComboIndex(int32_t Index, int32_t NumAttacks)
+	{
+		return Index >= 0 && Index < NumAttacks ? Index : 0;
+	}
+
+	float NormalizeAxis(float Angle)
+	{
+		Angle = std::fmod(Angle, 360.0f);
+		if (Angle < 0.0f)
+			Angle += 360.0f;
+		if (Angle > 180.0f)
+			Angle -= 360.0f;
+		return Angle;
+	}
+
+	float YawTowards(float DX, float DY)
+	{
+		return std::atan2(DY, DX) * (180.0f / 3.14159265358979f);
+	}
+
+	float SmoothYaw(float Current, float Wanted, float Smoothing, float DeltaTime)
+	{
+		return Current + NormalizeAxis(Wanted - Current) * (Smoothing * DeltaTime);
+	}
+
+	void SpringDamp(float& Value, float& Velocity, float Wanted, float Stiffness, float DeltaTime)
+	{
+		const float Offset = Value - Wanted;
+		const float Decay = std::exp(-Stiffness * DeltaTime);
+		const float Drift = (Velocity + Stiffness * Offset) * DeltaTime;
+		Velocity = (Velocity - Stiffness * Drift) * Decay;
+		Value = Wanted + (Offset + Drift) * Decay;
+	}
+
+	EState IdleTransition(float Distance, const FEnemyTuning& Tuning, bool Loaded)
+	{
+		return Loaded && Distance <= Tuning.AggroRange ? EState::ChaseClose : EState::Idle;
+	}
+
+	EState ChaseFarTransition(float Distance, const FEnemyTuning& Tuning)
+	{
+		return Distance < Tuning.ChaseFarRange ? EState::ChaseClose : EState::ChaseFar;
+	}
+
+	EState StumbleTransition(bool Stumbling)
+	{
+		return Stumbling ? EState::Stumble : EState::ChaseClose;
+	}
+
+	EChaseAction ChooseChaseAction(const FChaseInputs& Inputs, const FEnemyTuning& Tuning)
+	{
+		if (Inputs.FacingDot < Tuning.AttackFacingDot)
+			return EChaseAction::Move;
+
+		if (Inputs.Distance <= Tuning.AttackRange)
+			return EChaseAction::Attack;
+
+		if (Inputs.HasLongAttack && Inputs.Distance <= Tuning.LongAttackRange
+			&& Inputs.Now >= Inputs.LongAttackReadyTime && Inputs.LineOfSight)
+			return EChaseAction::LongAttack;
+
+		return EChaseAction::Move;
+	}
+
+	float LongAttackSpeed(float Distance, const FEnemyTuning& Tuning)
+	{
+		return Distance + Tuning.LongAttackJumpBonus;
+	}
+
+	static float Clamp01(float Value)
+	{
+		return Value < 0.0f ? 0.0f : (Value > 1.0f ? 1.0f : Value);
+	}
+
+	float Consider(const FConsideration& Consideration, float Input)
+	{
+		float Score = 1.0f;
+		ApplyConsideration(Consideration, &Input, &Score, 1);
+		return Score;
+	}
+
+	void ApplyConsideration(const FConsideration& Consideration, const float* Inputs, float* Scores, int32_t Count)
+	{
+		// Invert as Offset + Sign * Response, so it costs nothing per element
+		const float Offset = Consideration.Invert ? 1.0f : 0.0f;
+		const float Sign = Consideration.Invert ? -1.0f : 1.0f;
+		const float Start = Consideration.Start;
+		const float End = Consideration.End;
+
+		if (Consideration.Curve == EUtilityCurve::Step || Start == End)
+		{
+			// Both sides of a step include End, so an inverted step reads "at most End" like the range checks
+			if (Consideration.Invert)
+			{
+				for (int32_t Index = 0; Index < Count; ++Index)
+					Scores[Index] *= Inputs[Index] <= End ? 1.0f : 0.0f;
+			}
+			else
+			{
+				for (int32_t Index = 0; Index < Count; ++Index)
+					Scores[Index] *= Inputs[Index] >= End ? 1.0f : 0.0f;
+			}
+		}
+		else if (Consideration.Curve == EUtilityCurve::Linear)
+		{
+			const float Scale = 1.0f / (End - Start);
+			for (int32_t Index = 0; Index < Count; ++Index)
+				Scores[Index] *= Offset + Sign * Clamp01((Inputs[Index] - Start) * Scale);
+		}
+		else
+		{
+			const float Scale = 1.0f / (End - Start);
+			for (int32_t Index = 0; Index < Count; ++Index)
+			{
+				float T = Clamp01((Inputs[Index] - Start) * Scale);
+				Scores[Index] *= Offset + Sign * (T * T * (3.0f - 2.0f * T));
+			}
+		}
+	}
+
+	int32_t ScoreChaseActions(const FUtilityActions& Actions, const float* const* Columns, int32_t Count,
+		float* Scratch, EChaseAction* BestActions, float* BestScores)
+	{
+		for (int32_t Index = 0; Index < Count; ++Index)
+		{
+			BestScores[Index] = 0.0f;
+			BestActions[Index] = EChaseAction::Move;
+		}
+
+		// One pass over the batch per action and consideration
+		for (int32_t ActionIndex = 0; ActionIndex < Actions.NumActions; ++ActionIndex)
+		{
+			const FUtilityAction& Action = Actions.Actions[ActionIndex];
+			for (int32_t Index = 0; Index < Count; ++Index)
+				Scratch[Index] = Action.Weight;
+
+			for (int32_t Consideration = 0; Consideration < Action.NumConsiderations; ++Consideration)
+			{
+				const FConsideration& Current = Action.Considerations[Consideration];
+				if (Current.Input < EUtilityInput::Count)
+					ApplyConsideration(Current, Columns[(int32_t)Current.Input], Scratch, Count);
+			}
+
+			// Earlier actions win ties
+			for (int32_t Index = 0; Index < Count; ++Index)
+			{
+				const bool Better = Scratch[Index] > BestScores[Index];
+				BestScores[Index] = Better ? Scratch[Index] : BestScores[Index];
+				BestActions[Index] = Better ? Action.Action : BestActions[Index];
+			}
+		}
+
+		return Count * Actions.NumActions;
+	}
+
+	EChaseAction ScoreChaseAction(const FUtilityActions& Actions, const FUtilityInputs& Inputs, float* OutScore)
+	{
+		// A batch of one - each column is a single input
+		const float* Columns[(int32_t)EUtilityInput::Count];
+		for (int32_t Input = 0; Input < (int32_t)EUtilityInput::Count; ++Input)
+			Columns[Input] = &Inputs[Input];
+
+		float Scratch;
+		float Score;
+		EChaseAction Action;
+		ScoreChaseActions(Actions, Columns, 1, &Scratch, &Action, &Score);
+		if (OutScore)
+			*OutScore = Score;
+		return Action;
+	}
+
+	void DefaultChaseActions(const FEnemyTuning& Tuning, FUtilityActions& OutActions)
+	{
+		auto Step = [](EUtilityInput Input, float Threshold, bool Invert)
+		{
+			return FConsideration { Input, EUtilityCurve::Step, 0.0f, Threshold, Invert };
+		};
+
+		OutActions.NumActions = 3;
+
+		// Fallback when nothing else scores
+		FUtilityAction& Move = OutActions.Actions[0];
+		Move.Action = EChaseAction::Move;
+		Move.Weight = 0.1f;
+		Move.NumConsiderations = 0;
+
+		// In range and facing the target, and not swinging at a roll it can't hit
+		FUtilityAction& Attack = OutActions.Actions[1];
+		Attack.Action = EChaseAction::Attack;
+		Attack.Weight = 1.0f;
+		Attack.NumConsiderations = 3;
+		Attack.Considerations[0] = Step(EUtilityInput::Distance, Tuning.AttackRange, true);
+		Attack.Considerations[1] = Step(EUtilityInput::Facing, Tuning.AttackFacingDot, false);
+		Attack.Considerations[2] = Step(EUtilityInput::TargetRolling, 0.5f, true);
+
+		// Further away, off cooldown and with a clear line - loses to a melee attack when both score.
+		// Never jumps into a roll or into the target's own swing
+		FUtilityAction& LongAttack = OutActions.Actions[2];
+		LongAttack.Action = EChaseAction::LongAttack;
+		LongAttack.Weight = 0.9f;
+		LongAttack.NumConsiderations = 6;
+		LongAttack.Considerations[0] = Step(EUtilityInput::Distance, Tuning.LongAttackRange, true);
+		LongAttack.Considerations[1] = Step(EUtilityInput::Facing, Tuning.AttackFacingDot, false);
+		LongAttack.Considerations[2] = Step(EUtilityInput::Cooldown, 0.0f, true);
+		LongAttack.Considerations[3] = Step(EUtilityInput::LineOfSight, 0.5f, false);
+		LongAttack.Considerations[4] = Step(EUtilityInput::TargetRolling, 0.5f, true);
+		LongAttack.Considerations[5] = Step(EUtilityInput::TargetAttacking, 0.5f, true);
+	}
+
+	void PlanSquad(const FSquadMember* Members, int32_t NumMembers, const FVec3& TargetLocation, float TargetYaw,
+		const FSquadSettings& Settings, ESquadRole* OutRoles, FVec3* OutOffsets)
+	{
+		const int32_t NumAttackers = Settings.Attackers > 0 ? Settings.Attackers : 0;
+		const int32_t NumFlankers = Settings.Flankers > 0 ? Settings.Flankers : 0;
+		int32_t NumTaunters = Settings.Taunters > 0 ? Settings.Taunters : 0;
+
+		// Taunting only makes sense with someone left over to wait
+		if (NumMembers <= NumAttackers + NumFlankers + NumTaunters)
+			NumTaunters = 0;
+
+		const int32_t NumSlots = NumAttackers + NumFlankers + NumTaunters < MaxSquadSlots ? NumAttackers + NumFlankers + NumTaunters : MaxSquadSlots;
+
+		// Keep the NumSlots best scored members (lowest first) - insertion into a fixed size
+		// list, so the whole pass stays linear in squad size
+		int32_t Best[MaxSquadSlots];
+		float BestScores[MaxSquadSlots];
+		int32_t NumBest = 0;
+
+		for (int32_t Index = 0; Index < NumMembers; ++Index)
+		{
+			const FSquadMember& Member = Members[Index];
+			const float DX = Member.Location.X - TargetLocation.X;
+			const float DY = Member.Location.Y - TargetLocation.Y;
+			const float DZ = Member.Location.Z - TargetLocation.Z;
+			float Score = std::sqrt(DX * DX + DY * DY + DZ * DZ);
+
+			// Never take the slot from someone mid-attack or mid-stumble
+			if (Member.Role == ESquadRole::Attacker)
+				Score -= Member.Committed ? 3.4e38f : Settings.AttackerBonus;
+
+			if (NumBest == NumSlots && (NumSlots == 0 || Score >= BestScores[NumBest - 1]))
+				continue;
+
+			int32_t Insert = NumBest < NumSlots ? NumBest++ : NumBest - 1;
+			while (Insert > 0 && BestScores[Insert - 1] > Score)
+			{
+				Best[Insert] = Best[Insert - 1];
+				BestScores[Insert] = BestScores[Insert - 1];
+				Insert--;
+			}
+			Best[Insert] = Index;
+			BestScores[Insert] = Score;
+		}
+
+		// Everyone waits unless picked
+		for (int32_t Index = 0; Index < NumMembers; ++Index)
+		{
+			OutRoles[Index] = ESquadRole::Waiter;
+			OutOffsets[Index] = FVec3 { 0.0f, 0.0f, 0.0f };
+		}
+
+		for (int32_t Slot = 0; Slot < NumBest; ++Slot)
+		{
+			const int32_t Index = Best[Slot];
+			if (Slot < NumAttackers)
+			{
+				OutRoles[Index] = ESquadRole::Attacker;
+			}
+			else if (Slot < NumAttackers + NumFlankers)
+			{
+				// Flank slots alternate sides of the target, working round towards its back
+				const int32_t Flank = Slot - NumAttackers;
+				const float Angle = (90.0f + 45.0f * (float)(Flank / 2)) * (Flank % 2 == 0 ? 1.0f : -1.0f);
+				const float Yaw = (TargetYaw + Angle) * DegreesToRadians;
+				OutRoles[Index] = ESquadRole::Flanker;
+				OutOffsets[Index] = FVec3 { std::cos(Yaw) * Settings.FlankRadius, std::sin(Yaw) * Settings.FlankRadius, 0.0f };
+			}
+			else
+			{
+				OutRoles[Index] = ESquadRole::Taunter;
+			}
+		}
+	}
+
+	/** Turn Chaser towards Goal at its class's rotation rate */
+	static void TurnTowards(FChaser& Chaser, const FChaserClass& Class, const FVec3& Goal, float DeltaTime)
+	{
+		const float DX = Goal.X - Chaser.Location.X;
+		const float DY = Goal.Y - Chaser.Location.Y;
+		if (DX != 0.0f || DY != 0.0f)
+			Chaser.Yaw = SmoothYaw(Chaser.Yaw, YawTowards(DX, DY), Class.RotationSmoothing, DeltaTime);
+	}
+
+	/** Move Location straight towards Goal (on the ground plane) by up to Step, stopping StopDistance short of it */
+	static void MoveTowards(FVec3& Location, const FVec3& Goal, float Step, float StopDistance)
+	{
+		const float DX = Goal.X - Location.X;
+		const float DY = Goal.Y - Location.Y;
+		const float Distance = std::sqrt(DX * DX + DY * DY);
+		const float Move = Distance - StopDistance < Step ? Distance - StopDistance : Step;
+		if (Move <= 0.0f)
+			return;
+
+		Location.X += DX / Distance * Move;
+		Location.Y += DY / Distance * Move;
+	}
+
+	EState StepChaseClose(FChaser& Chaser, const FChaserClass& Class, const FChaseTarget& Target,
+		float Now, float DeltaTime, bool LineOfSight)
+	{
+		const float DX = Target.Location.X - Chaser.Location.X;
+		const float DY = Target.Location.Y - Chaser.Location.Y;
+		const float DZ = Target.Location.Z - Chaser.Location.Z;
+		const float Distance2D = std::sqrt(DX * DX + DY * DY);
+
+		switch (Chaser.Role)
+		{
+			case ESquadRole::Waiter:
+				return EState::ChaseFar;
+
+			case ESquadRole::Taunter:
+				return EState::Taunt;
+
+			case ESquadRole::Flanker:
+			{
+				// Strike once the target has turned away, otherwise hold the flank slot
+				const float TargetYaw = Target.Yaw * DegreesToRadians;
+				if (-DX * std::cos(TargetYaw) - DY * std::sin(TargetYaw) < 0.0f)
+					break;
+
+				const FVec3 Slot = { Target.Location.X + Chaser.SquadOffset.X, Target.Location.Y + Chaser.SquadOffset.Y, Target.Location.Z };
+				const float SlotX = Slot.X - Chaser.Location.X;
+				const float SlotY = Slot.Y - Chaser.Location.Y;
+				if (SlotX * SlotX + SlotY * SlotY > 100.0f * 100.0f)
+				{
+					TurnTowards(Chaser, Class, Slot, DeltaTime);
+					MoveTowards(Chaser.Location, Slot, Class.MoveSpeed * DeltaTime, 50.0f);
+				}
+				return EState::ChaseClose;
+			}
+
+			default:
+				break;
+		}
+
+		// Same inputs as AEnemyBase/AEnemyKnight::GetUtilityInputs
+		FUtilityInputs Inputs;
+		Inputs[(int32_t)EUtilityInput::Distance] = std::sqrt(DX * DX + DY * DY + DZ * DZ);
+		Inputs[(int32_t)EUtilityInput::Facing] = Distance2D > 0.0f
+			? (std::cos(Chaser.Yaw * DegreesToRadians) * DX + std::sin(Chaser.Yaw * DegreesToRadians) * DY) / Distance2D : 1.0f;
+		Inputs[(int32_t)EUtilityInput::Cooldown] = Class.HasLongAttack
+			? std::fmax(0.0f, Chaser.LongAttackTime + Class.LongAttackCooldown - Now) : INFINITY;
+		Inputs[(int32_t)EUtilityInput::LineOfSight] = LineOfSight ? 1.0f : 0.0f;
+		Inputs[(int32_t)EUtilityInput::TargetRolling] = Target.Rolling ? 1.0f : 0.0f;
+		Inputs[(int32_t)EUtilityInput::TargetAttacking] = Target.Attacking ? 1.0f : 0.0f;
+
+		switch (ScoreChaseAction(*Class.Actions, Inputs))
+		{
+			case EChaseAction::LongAttack:
+				if (!Class.HasLongAttack)
+					break;
+
+				// The jump lands in melee range
+				Chaser.LongAttackTime = Now;
+				MoveTowards(Chaser.Location, Target.Location, Distance2D, Class.Tuning.AttackRange);
+				return EState::Attack;
+
+			case EChaseAction::Attack:
+				return EState::Attack;
+
+			default:
+				break;
+		}
+
+		// Turn and close in (the actors walk the navmesh instead of a straight line)
+		TurnTowards(Chaser, Class, Target.Location, DeltaTime);
+		MoveTowards(Chaser.Location, Target.Location, Class.MoveSpeed * DeltaTime, Class.Tuning.AttackRange);
+		return EState::ChaseClose;
+	}
+
+	EState StepChaseFar(FChaser& Chaser, const FChaserClass& Class, const FChaseTarget& Target, float DeltaTime)
+	{
+		if (Chaser.Role == ESquadRole::Waiter)
+		{
+			TurnTowards(Chaser, Class, Target.Location, DeltaTime);
+			MoveTowards(Chaser.Location, Target.Location, Class.MoveSpeed * DeltaTime, Class.Tuning.ChaseFarRange);
+			return EState::ChaseFar;
+		}
+
+		if (Chaser.Role != ESquadRole::None)
+			return EState::ChaseClose;
+
+		const float DX = Target.Location.X - Chaser.Location.X;
+		const float DY = Target.Location.Y - Chaser.Location.Y;
+		const float DZ = Target.Location.Z - Chaser.Location.Z;
+		return ChaseFarTransition(std::sqrt(DX * DX + DY * DY + DZ * DZ), Class.Tuning);
+	}
+
+	EState StepTaunt(FChaser& Chaser, const FChaserClass& Class, const FChaseTarget& Target, float DeltaTime)
+	{
+		if (Chaser.Role != ESquadRole::Taunter)
+			return EState::ChaseClose;
+
+		TurnTowards(Chaser, Class, Target.Location, DeltaTime);
+		return EState::Taunt;
+	}
+
+	bool TakeQuickHit(FQuickHits& Hits, float Now, bool Interruptable)
+	{
+		if (Hits.Taken == 0 || Now - Hits.Timestamp <= QuickHitWindow)
+		{
+			Hits.Taken++;
+			Hits.Timestamp = Now;
+			return Hits.Taken >= QuickHitThreshold ? false : Interruptable;
+		}
+
+		Hits.Taken = 0;
+		return true;
+	}
+
+	int32_t CycleTarget(const FVec3& ViewLocation, const FVec3& Origin, const FVec3* Candidates, int32_t NumCandidates,
+		const FVec3* CurrentTarget, int32_t CurrentIndex, bool Clockwise)
+	{
+		int32_t Best = -1;
+
+		// Next enemy to the left/right of the current target, by yaw as seen from the camera
+		if (CurrentTarget)
+		{
+			float TargetYaw = YawTowards(CurrentTarget->X - ViewLocation.X, CurrentTarget->Y - ViewLocation.Y);
+			float BestYawDifference = INFINITY;
+			for (int32_t Index = 0; Index < NumCandidates; ++Index)
+			{
+				if (Index == CurrentIndex)
+					continue;
+
+				float Difference = NormalizeAxis(YawTowards(Candidates[Index].X - ViewLocation.X, Candidates[Index].Y - ViewLocation.Y) - TargetYaw);
+				if ((Clockwise && Difference <= 0.0f) || (!Clockwise && Difference >= 0.0f))
+					continue;
+
+				float YawDifference = std::fabs(Difference);
+				if (YawDifference < BestYawDifference)
+				{
+					BestYawDifference = YawDifference;
+					Best = Index;
+				}
+			}
+			return Best;
+		}
+
+		// No target to cycle from - closest enemy
+		float BestDistanceSquared = INFINITY;
+		for (int32_t Index = 0; Index < NumCandidates; ++Index)
+		{
+			float DX = Candidates[Index].X - Origin.X;
+			float DY = Candidates[Index].Y - Origin.Y;
+			float DZ = Candidates[Index].Z - Origin.Z;
+			float DistanceSquared = DX * DX + DY * DY + DZ * DZ;
+			if (DistanceSquared < BestDistanceSquared)
+			{
+				BestDistanceSquared = DistanceSquared;
+				Best = Index;
+			}
+		}
+		return Best;
+	}
+}
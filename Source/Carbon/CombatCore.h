@@ -0,0 +1,314 @@
+// Sam Smith
+
+#pragma once
+
+// Pure combat rules shared by the actors, the crowd simulation and offline tools.
+// Deliberately engine-free: no UE headers, plain values in and out, so the decision code
+// can be compiled and stepped on its own.
+
+#include <cstdint>
+
+namespace CombatCore
+{
+	/** Mirrors ::State (EnemyBase.h) value for value */
+	enum class EState : uint8_t
+	{
+		Idle,
+		ChaseClose,
+		ChaseFar,
+		Attack,
+		Stumble,
+		Taunt,
+		Dead
+	};
+
+	struct FVec3
+	{
+		float X, Y, Z;
+	};
+
+	/** Enemy numbers the FSM needs (a subset of FCombatTuning) */
+	struct FEnemyTuning
+	{
+		float AggroRange;
+		float AttackRange;
+		float ChaseFarRange;
+		float AttackFacingDot;
+		float LongAttackRange;
+		float LongAttackJumpBonus;
+	};
+
+	//~ Attacks, combos and input buffering
+
+	/** What a combatant is doing, as far as starting an attack or roll is concerned */
+	struct FActionState
+	{
+		bool Attacking;
+		bool NextAttackReady;
+		bool Rolling;
+		bool Stumbling;
+		bool Falling;
+		bool Loaded;		// Archetype streamed in
+	};
+
+	/** A new attack may start outside an attack, or inside one once the combo window opened */
+	bool CanAttack(const FActionState& State);
+
+	bool CanRoll(const FActionState& State);
+
+	/** Timestamp < 0 means nothing is buffered */
+	bool IsInputBuffered(float Timestamp, float Window, float Now);
+
+	enum class EBufferedInput : uint8_t
+	{
+		None,
+		Attack,
+		Roll
+	};
+
+	/** Which buffered press (if any) to replay now - rolls take priority */
+	EBufferedInput ResolveBufferedInput(const FActionState& State, float Now,
+		float AttackTime, float AttackWindow, float RollTime, float RollWindow);
+
+	/** Index of the next combo attack - wraps back to the first when out of range */
+	int32_t ComboIndex(int32_t Index, int32_t NumAttacks);
+
+	//~ Rotation (degrees)
+
+	/** Wrap Angle to (-180, 180] */
+	float NormalizeAxis(float Angle);
+
+	/** Yaw of the direction (DX, DY) */
+	float YawTowards(float DX, float DY);
+
+	/** Current yaw moved towards Wanted by Smoothing * DeltaTime of the shortest way round */
+	float SmoothYaw(float Current, float Wanted, float Smoothing, float DeltaTime);
+
+	/**
+	 * Critically damped spring moving Value (at Velocity) towards Wanted, settling in about
+	 * 4 / Stiffness seconds without overshooting. Exact for any DeltaTime, so uneven frame
+	 * times don't change the path.
+	 */
+	void SpringDamp(float& Value, float& Velocity, float Wanted, float Stiffness, float DeltaTime);
+
+	//~ Enemy state machine
+
+	EState IdleTransition(float Distance, const FEnemyTuning& Tuning, bool Loaded);
+
+	EState ChaseFarTransition(float Distance, const FEnemyTuning& Tuning);
+
+	EState StumbleTransition(bool Stumbling);
+
+	enum class EChaseAction : uint8_t
+	{
+		Move,
+		Attack,
+		LongAttack
+	};
+
+	struct FChaseInputs
+	{
+		float Distance;
+		float FacingDot;
+		float Now;
+		float LongAttackReadyTime;	// Now >= this once the long attack is off cooldown
+		bool HasLongAttack;
+		bool LineOfSight;
+	};
+
+	/** Melee when close and facing, otherwise a long attack when possible, otherwise move closer */
+	EChaseAction ChooseChaseAction(const FChaseInputs& Inputs, const FEnemyTuning& Tuning);
+
+	/** Forward speed of a long attack jump started Distance from the target */
+	float LongAttackSpeed(float Distance, const FEnemyTuning& Tuning);
+
+	//~ Utility scoring of chase actions
+
+	/** Per-enemy values considerations read (EUtilityInput in UtilityAI.h mirrors this) */
+	enum class EUtilityInput : uint8_t
+	{
+		Distance,			// Distance to target
+		Facing,				// dot(forward, direction to target)
+		Cooldown,			// Seconds until the long attack is ready (0 = ready)
+		LineOfSight,		// 1 if the target is visible, otherwise 0
+		TargetRolling,		// 1 if the target is rolling, otherwise 0
+		TargetAttacking,	// 1 if the target is attacking, otherwise 0
+		Count
+	};
+
+	enum class EUtilityCurve : uint8_t
+	{
+		Step,				// 1 once the input reaches End, otherwise 0 (inverted: 1 while it is at most End)
+		Linear,				// 0 at Start rising to 1 at End
+		Smooth				// Smoothstep from Start to End
+	};
+
+	/** One input mapped to a 0-1 score through a response curve */
+	struct FConsideration
+	{
+		EUtilityInput Input;
+		EUtilityCurve Curve;
+		float Start;
+		float End;
+		bool Invert;		// Score 1 - curve instead (a step then includes End)
+	};
+
+	const int32_t MaxConsiderations = 8;
+	const int32_t MaxUtilityActions = 8;
+
+	/** An action's score is Weight times the product of its considerations */
+	struct FUtilityAction
+	{
+		EChaseAction Action;
+		float Weight;
+		int32_t NumConsiderations;
+		FConsideration Considerations[MaxConsiderations];
+	};
+
+	/** Everything one archetype chooses between - fixed size, so it is built once and shared by value */
+	struct FUtilityActions
+	{
+		int32_t NumActions;
+		FUtilityAction Actions[MaxUtilityActions];
+	};
+
+	/** One enemy's inputs, indexed by EUtilityInput */
+	typedef float FUtilityInputs[(int32_t)EUtilityInput::Count];
+
+	/** Response of Consideration to one input value */
+	float Consider(const FConsideration& Consideration, float Input);
+
+	/** Multiply Count scores by Consideration's response to Count inputs - no branches inside the loops */
+	void ApplyConsideration(const FConsideration& Consideration, const float* Inputs, float* Scores, int32_t Count);
+
+	/**
+	 * Score Count enemies sharing one action set, in one pass per action and consideration.
+	 * Columns holds one column of Count inputs per EUtilityInput, Scratch room for Count floats.
+	 * Writes each enemy's best action (earlier actions win ties, Move if nothing scores) and its
+	 * score. Returns the number of action evaluations.
+	 */
+	int32_t ScoreChaseActions(const FUtilityActions& Actions, const float* const* Columns, int32_t Count,
+		float* Scratch, EChaseAction* BestActions, float* BestScores);
+
+	/** ScoreChaseActions for a single enemy */
+	EChaseAction ScoreChaseAction(const FUtilityActions& Actions, const FUtilityInputs& Inputs, float* OutScore = nullptr);
+
+	/**
+	 * Move / attack / long attack with the thresholds of ChooseChaseAction, which they match
+	 * exactly while the target is neither rolling nor attacking. Neither attack is started into
+	 * a roll, and the long attack isn't started into the target's own swing.
+	 */
+	void DefaultChaseActions(const FEnemyTuning& Tuning, FUtilityActions& OutActions);
+
+	//~ Squads
+
+	/** Mirrors ::ESquadRole (SquadSubsystem.h) value for value */
+	enum class ESquadRole : uint8_t
+	{
+		None,
+		Attacker,
+		Flanker,
+		Waiter,
+		Taunter
+	};
+
+	/** Most roles handed out in one squad (attackers + flankers + taunters) */
+	const int32_t MaxSquadSlots = 16;
+
+	struct FSquadSettings
+	{
+		int32_t Attackers;
+		int32_t Flankers;
+		int32_t Taunters;		// Only handed out once there are waiters to spare
+		float FlankRadius;
+		float AttackerBonus;	// Current attackers count as this much closer, so roles don't swap back and forth
+	};
+
+	/** A squad member as the planner sees it */
+	struct FSquadMember
+	{
+		FVec3 Location;
+		ESquadRole Role;		// From the last plan
+		bool Committed;			// Mid-attack or mid-stumble - an attacker never loses its slot then
+	};
+
+	/**
+	 * Reassign every role in a squad fighting a target at TargetLocation, facing TargetYaw.
+	 * The closest members attack, the next ones flank (OutOffsets: the slot to hold, relative to
+	 * the target, alternating sides and working round towards its back), the next taunt and
+	 * everyone else waits. Linear in NumMembers.
+	 */
+	void PlanSquad(const FSquadMember* Members, int32_t NumMembers, const FVec3& TargetLocation, float TargetYaw,
+		const FSquadSettings& Settings, ESquadRole* OutRoles, FVec3* OutOffsets);
+
+	//~ Simulated enemies (crowd entities and the fight simulator)
+
+	/** What a simulated enemy's class brings, read once from its defaults and archetype */
+	struct FChaserClass
+	{
+		FEnemyTuning Tuning;
+		const FUtilityActions* Actions;	// The archetype's action set, scored like UUtilitySubsystem does for actors
+		float MoveSpeed;
+		float RotationSmoothing;
+		bool HasLongAttack;
+		float LongAttackCooldown;
+	};
+
+	/** A simulated enemy's own state */
+	struct FChaser
+	{
+		FVec3 Location;
+		float Yaw;
+		float LongAttackTime;			// Start of the last long attack
+		ESquadRole Role;
+		FVec3 SquadOffset;				// Flankers: target location + this is the slot to hold
+	};
+
+	/** What a simulated enemy sees of its target */
+	struct FChaseTarget
+	{
+		FVec3 Location;
+		float Yaw;
+		bool Rolling;
+		bool Attacking;
+	};
+
+	/**
+	 * One CHASE_CLOSE step, as AEnemyBase::StateChaseClose: follow the squad role, otherwise
+	 * score the class's actions - attack, long attack (the jump lands in melee range) or turn
+	 * and close in. Returns the state to continue in (Attack once either attack started).
+	 */
+	EState StepChaseClose(FChaser& Chaser, const FChaserClass& Class, const FChaseTarget& Target,
+		float Now, float DeltaTime, bool LineOfSight);
+
+	/** One CHASE_FAR step, as AEnemyBase::StateChaseFar: waiters hold at ChaseFarRange, anyone else given a role goes back in */
+	EState StepChaseFar(FChaser& Chaser, const FChaserClass& Class, const FChaseTarget& Target, float DeltaTime);
+
+	/** One TAUNT step, as AEnemyBase::StateTaunt: face the target until no longer a taunter */
+	EState StepTaunt(FChaser& Chaser, const FChaserClass& Class, const FChaseTarget& Target, float DeltaTime);
+
+	//~ Knight quick hits
+
+	/** After QuickHitThreshold hits, each within QuickHitWindow seconds of the last, the knight can't be interrupted */
+	const int32_t QuickHitThreshold = 4;
+	const float QuickHitWindow = 1.0f;
+
+	struct FQuickHits
+	{
+		int32_t Taken = 0;
+		float Timestamp = 0.0f;
+	};
+
+	/** Count a hit taken at Now - returns whether the knight is still interruptable */
+	bool TakeQuickHit(FQuickHits& Hits, float Now, bool Interruptable);
+
+	//~ Target selection
+
+	/**
+	 * Next target to lock on to among Candidates.
+	 * With a current target, picks the candidate closest in yaw (seen from ViewLocation) on the
+	 * requested side of it; otherwise the candidate closest to Origin. Returns -1 if none.
+	 */
+	int32_t CycleTarget(const FVec3& ViewLocation, const FVec3& Origin, const FVec3* Candidates, int32_t NumCandidates,
+		const FVec3* CurrentTarget, int32_t CurrentIndex, bool Clockwise);
+}
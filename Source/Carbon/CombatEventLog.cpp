@@ -0,0 +1,334 @@
+// Sam Smith
+
+#include "CombatEventLog.h"
+#include "Carbon.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "Async/MappedFileHandle.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Templates/Atomic.h"
+
+static TAutoConsoleVariable<int32> CVarEventLogEnabled(
+	TEXT("carbon.EventLog.Enabled"), 0,
+	TEXT("Write every combat event to Saved/Logs/CombatEvents_*.ccel (read with -run=CombatEventLog)."));
+
+namespace CombatEventLog
+{
+	/** Records per thread ring - must be a power of two */
+	const uint32 RingCapacity = 16384;
+
+	/** Single producer (owning thread), single consumer (writer thread) */
+	struct FEventRing
+	{
+		FCombatEventRecord Records[RingCapacity];
+		TAtomic<uint32> Head { 0 };
+		TAtomic<uint32> Tail { 0 };
+		TAtomic<uint32> Dropped { 0 };
+	};
+
+	/** Guards Rings - only taken when a thread records its first event and by the writer */
+	FCriticalSection RingsLock;
+	TArray<FEventRing*> Rings;
+	thread_local FEventRing* ThreadRing = nullptr;
+
+	TAtomic<bool> Running { false };
+
+	FEventRing* GetThreadRing()
+	{
+		if (!ThreadRing)
+		{
+			ThreadRing = new FEventRing();
+			FScopeLock Lock(&RingsLock);
+			Rings.Add(ThreadRing);
+		}
+		return ThreadRing;
+	}
+
+	/** Drains every ring into column blocks appended to the file */
+	class FWriter : public FRunnable
+	{
+	public:
+		FWriter(IFileHandle* InFile) : File(InFile) {}
+
+		virtual uint32 Run() override
+		{
+			while (!StopRequested.Load())
+			{
+				Drain();
+				FPlatformProcess::Sleep(0.05f);
+			}
+			Drain();
+			return 0;
+		}
+
+		virtual void Stop() override { StopRequested = true; }
+
+		void Drain()
+		{
+			Times.Reset();
+			Frames.Reset();
+			Sources.Reset();
+			Others.Reset();
+			Values.Reset();
+			Types.Reset();
+			Details.Reset();
+
+			{
+				FScopeLock Lock(&RingsLock);
+				for (FEventRing* Ring : Rings)
+				{
+					uint32 Head = Ring->Head.Load();
+					for (uint32 Tail = Ring->Tail.Load(); Tail != Head; ++Tail)
+					{
+						const FCombatEventRecord& Record = Ring->Records[Tail & (RingCapacity - 1)];
+						Times.Add(Record.Time);
+						Frames.Add(Record.Frame);
+						Sources.Add(Record.Source);
+						Others.Add(Record.Other);
+						Values.Add(Record.Value);
+						Types.Add((uint8)Record.Type);
+						Details.Add(Record.Detail);
+					}
+					Ring->Tail.Store(Head);
+
+					if (uint32 Dropped = Ring->Dropped.Exchange(0))
+						UE_LOG(LogCarbon, Warning, TEXT("Combat event log dropped %u events (ring full)"), Dropped);
+				}
+			}
+
+			uint32 Count = Times.Num();
+			if (Count == 0)
+				return;
+
+			File->Write((const uint8*)&Count, sizeof(Count));
+			File->Write((const uint8*)Times.GetData(), Count * sizeof(double));
+			File->Write((const uint8*)Frames.GetData(), Count * sizeof(uint32));
+			File->Write((const uint8*)Sources.GetData(), Count * sizeof(uint32));
+			File->Write((const uint8*)Others.GetData(), Count * sizeof(uint32));
+			File->Write((const uint8*)Values.GetData(), Count * sizeof(float));
+			File->Write(Types.GetData(), Count);
+			File->Write(Details.GetData(), Count);
+			File->Flush();
+		}
+
+	private:
+		IFileHandle* File;
+		TAtomic<bool> StopRequested { false };
+
+		// Column scratch, reused between drains
+		TArray<double> Times;
+		TArray<uint32> Frames;
+		TArray<uint32> Sources;
+		TArray<uint32> Others;
+		TArray<float> Values;
+		TArray<uint8> Types;
+		TArray<uint8> Details;
+	};
+
+	IFileHandle* File = nullptr;
+	FWriter* Writer = nullptr;
+	FRunnableThread* WriterThread = nullptr;
+
+	/** Element Index of a column in a mapped log - blocks are packed, so columns can sit at any alignment */
+	template <typename T>
+	T ReadColumn(const uint8* Column, uint32 Index)
+	{
+		T Value;
+		FMemory::Memcpy(&Value, Column + (SIZE_T)Index * sizeof(T), sizeof(T));
+		return Value;
+	}
+}
+
+void FCombatEventLog::Start(const FString& Filename)
+{
+	using namespace CombatEventLog;
+	check(IsInGameThread());
+	if (Running.Load())
+		return;
+
+	IFileManager::Get().MakeDirectory(*FPaths::GetPath(Filename), true);
+	File = FPlatformFileManager::Get().GetPlatformFile().OpenWrite(*Filename);
+	if (!File)
+	{
+		UE_LOG(LogCarbon, Error, TEXT("Could not open combat event log %s"), *Filename);
+		return;
+	}
+
+	FHeader Header = { FileMagic, FileVersion };
+	File->Write((const uint8*)&Header, sizeof(Header));
+
+	// Discard anything left over from a previous run, and make sure the game thread never allocates its ring mid-fight
+	{
+		FScopeLock Lock(&RingsLock);
+		for (FEventRing* Ring : Rings)
+			Ring->Tail.Store(Ring->Head.Load());
+	}
+	GetThreadRing();
+
+	Writer = new FWriter(File);
+	WriterThread = FRunnableThread::Create(Writer, TEXT("CombatEventLogWriter"), 0, TPri_BelowNormal);
+	Running = true;
+
+	UE_LOG(LogCarbon, Log, TEXT("Writing combat events to %s"), *Filename);
+}
+
+void FCombatEventLog::Stop()
+{
+	using namespace CombatEventLog;
+	if (!Running.Exchange(false))
+		return;
+
+	WriterThread->Kill(true);
+	delete WriterThread;
+	delete Writer;
+	delete File;
+	WriterThread = nullptr;
+	Writer = nullptr;
+	File = nullptr;
+}
+
+bool FCombatEventLog::IsRunning()
+{
+	return CombatEventLog::Running.Load(EMemoryOrder::Relaxed);
+}
+
+void FCombatEventLog::Record(ECombatEventType Type, const UObject* Source, const UObject* Other, float Value, uint8 Detail)
+{
+	using namespace CombatEventLog;
+	FEventRing* Ring = GetThreadRing();
+
+	uint32 Head = Ring->Head.Load(EMemoryOrder::Relaxed);
+	if (Head - Ring->Tail.Load() >= RingCapacity)
+	{
+		Ring->Dropped++;
+		return;
+	}
+
+	FCombatEventRecord& Record = Ring->Records[Head & (RingCapacity - 1)];
+	Record.Time = FPlatformTime::Seconds();
+	Record.Frame = (uint32)GFrameCounter;
+	Record.Source = Source ? Source->GetUniqueID() : 0;
+	Record.Other = Other ? Other->GetUniqueID() : 0;
+	Record.Value = Value;
+	Record.Type = Type;
+	Record.Detail = Detail;
+
+	// Publish the record to the writer
+	Ring->Head.Store(Head + 1);
+}
+
+static int32 GCombatEventLogWorlds = 0;
+
+bool UCombatEventLogSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	UWorld* World = Cast<UWorld>(Outer);
+	return World && World->IsGameWorld()
+		&& (CVarEventLogEnabled.GetValueOnGameThread() != 0 || FParse::Param(FCommandLine::Get(), TEXT("CombatEventLog")));
+}
+
+void UCombatEventLogSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	if (GCombatEventLogWorlds++ == 0)
+		FCombatEventLog::Start(FPaths::ProjectLogDir() / FString::Printf(TEXT("CombatEvents_%s.ccel"), *FDateTime::Now().ToString()));
+}
+
+void UCombatEventLogSubsystem::Deinitialize()
+{
+	if (--GCombatEventLogWorlds == 0)
+		FCombatEventLog::Stop();
+
+	Super::Deinitialize();
+}
+
+int32 UCombatEventLogCommandlet::Main(const FString& Params)
+{
+	FString Filename;
+	FString CsvFilename;
+	if (!FParse::Value(*Params, TEXT("File="), Filename))
+	{
+		UE_LOG(LogCarbon, Error, TEXT("Usage: -run=CombatEventLog -File=<log> [-Csv=<output.csv>]"));
+		return 1;
+	}
+	FParse::Value(*Params, TEXT("Csv="), CsvFilename);
+
+	TUniquePtr<IMappedFileHandle> Handle(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*Filename));
+	TUniquePtr<IMappedFileRegion> Region(Handle ? Handle->MapRegion() : nullptr);
+	if (!Region || Region->GetMappedSize() < (int64)sizeof(FCombatEventLog::FHeader))
+	{
+		UE_LOG(LogCarbon, Error, TEXT("Could not map %s"), *Filename);
+		return 1;
+	}
+
+	const uint8* Data = Region->GetMappedPtr();
+	const uint8* End = Data + Region->GetMappedSize();
+	const FCombatEventLog::FHeader* Header = (const FCombatEventLog::FHeader*)Data;
+	if (Header->Magic != FCombatEventLog::FileMagic || Header->Version != FCombatEventLog::FileVersion)
+	{
+		UE_LOG(LogCarbon, Error, TEXT("%s is not a version %u combat event log"), *Filename, FCombatEventLog::FileVersion);
+		return 1;
+	}
+	Data += sizeof(FCombatEventLog::FHeader);
+
+	const UEnum* TypeEnum = StaticEnum<ECombatEventType>();
+	TArray<uint64> CountPerType;
+	CountPerType.SetNumZeroed(TypeEnum->NumEnums());
+	FString Csv = TEXT("Time,Frame,Type,Source,Other,Value,Detail\n");
+	uint64 Total = 0;
+
+	// Each block is laid out column by column
+	const int32 RecordBytes = sizeof(double) + 4 * sizeof(uint32) + 2;
+	while (Data + sizeof(uint32) <= End)
+	{
+		const uint32 Count = CombatEventLog::ReadColumn<uint32>(Data, 0);
+		Data += sizeof(uint32);
+		if (Data + (uint64)Count * RecordBytes > End)
+		{
+			UE_LOG(LogCarbon, Warning, TEXT("Truncated block at end of log"));
+			break;
+		}
+
+		// Only the byte columns are read in place, the rest are copied out (see ReadColumn)
+		const uint8* Times = Data;
+		const uint8* Frames = Times + Count * sizeof(double);
+		const uint8* Sources = Frames + Count * sizeof(uint32);
+		const uint8* Others = Sources + Count * sizeof(uint32);
+		const uint8* Values = Others + Count * sizeof(uint32);
+		const uint8* Types = Values + Count * sizeof(float);
+		const uint8* Details = Types + Count;
+		Data = Details + Count;
+
+		for (uint32 Index = 0; Index < Count; ++Index)
+		{
+			if (CountPerType.IsValidIndex(Types[Index]))
+				CountPerType[Types[Index]]++;
+
+			if (!CsvFilename.IsEmpty())
+			{
+				using CombatEventLog::ReadColumn;
+				Csv += FString::Printf(TEXT("%.6f,%u,%s,%u,%u,%f,%u\n"), ReadColumn<double>(Times, Index), ReadColumn<uint32>(Frames, Index),
+					*TypeEnum->GetNameStringByValue(Types[Index]), ReadColumn<uint32>(Sources, Index), ReadColumn<uint32>(Others, Index),
+					ReadColumn<float>(Values, Index), Details[Index]);
+			}
+		}
+		Total += Count;
+	}
+
+	UE_LOG(LogCarbon, Display, TEXT("%s: %llu events"), *Filename, Total);
+	for (int32 Type = 0; Type < CountPerType.Num(); ++Type)
+	{
+		if (CountPerType[Type] > 0)
+			UE_LOG(LogCarbon, Display, TEXT("  %-20s %llu"), *TypeEnum->GetNameStringByValue(Type), CountPerType[Type]);
+	}
+
+	if (!CsvFilename.IsEmpty())
+		FFileHelper::SaveStringToFile(Csv, *CsvFilename);
+
+	return 0;
+}
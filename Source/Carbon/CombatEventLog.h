@@ -0,0 +1,98 @@
+// Sam Smith
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Commandlets/Commandlet.h"
+#include "CombatEventLog.generated.h"
+
+UENUM()
+enum class ECombatEventType : uint8
+{
+	ATTACK_START,			// Source started an attack
+	ATTACK_END,				// Source's attack finished or was cancelled
+	HIT,					// Source's weapon hit Other (Value = damage applied)
+	DAMAGE,					// Source took Value damage from Other
+	STUMBLE,				// Source started stumbling (Detail = animation index)
+	ROLL,					// Source started a roll
+	TARGET_SWITCH,			// Source's target became Other (0 = none)
+	STATE_TRANSITION		// Source changed State (Detail = new state, Value = old state)
+};
+
+/** One combat event - fixed size, written to the log as columns */
+struct FCombatEventRecord
+{
+	double Time;			// FPlatformTime::Seconds
+	uint32 Frame;
+	uint32 Source;			// UObject unique IDs (0 = none)
+	uint32 Other;
+	float Value;
+	ECombatEventType Type;
+	uint8 Detail;
+};
+
+/**
+ * Process-wide combat event stream.
+ * Record() appends to a lock-free ring owned by the calling thread; a background thread
+ * drains every ring and appends column blocks to the log file, so recording never
+ * allocates (after a thread's first event) or waits on I/O. Full rings drop events and
+ * count them rather than block.
+ *
+ * File layout: FHeader, then blocks of [uint32 Count][Time x Count][Frame x Count]
+ * [Source x Count][Other x Count][Value x Count][Type x Count][Detail x Count].
+ * Read it back with the CombatEventLog commandlet.
+ */
+class CARBON_API FCombatEventLog
+{
+public:
+	struct FHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+	};
+
+	static const uint32 FileMagic = 0x4C454343;	// 'CCEL'
+	static const uint32 FileVersion = 1;
+
+	/** Start writing to Filename (game thread). Does nothing if already running. */
+	static void Start(const FString& Filename);
+
+	/** Flush everything recorded so far and close the file */
+	static void Stop();
+
+	static bool IsRunning();
+
+	static void Record(ECombatEventType Type, const UObject* Source, const UObject* Other = nullptr, float Value = 0.0f, uint8 Detail = 0);
+};
+
+/** Starts the event log for game worlds when carbon.EventLog.Enabled is set (or -CombatEventLog is passed) */
+UCLASS()
+class CARBON_API UCombatEventLogSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	virtual void Deinitialize() override;
+};
+
+/**
+ * Offline reader for combat event logs.
+ *   -run=CombatEventLog -File=<log> [-Csv=<output.csv>]
+ * Prints per-type event counts and optionally converts the log to CSV.
+ */
+UCLASS()
+class UCombatEventLogCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	virtual int32 Main(const FString& Params) override;
+};
+
+#define COMBAT_EVENT(Type, ...) \
+	do { if (FCombatEventLog::IsRunning()) { FCombatEventLog::Record(ECombatEventType::Type, __VA_ARGS__); } } while (0)
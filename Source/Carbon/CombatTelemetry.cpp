@@ -0,0 +1,212 @@
+// Sam Smith
+
+#include "CombatTelemetry.h"
+#include "Carbon.h"
+#include "Async/Async.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "HAL/PlatformMemory.h"
+#include "UObject/UObjectArray.h"
+
+static TAutoConsoleVariable<int32> CVarTelemetryEnabled(
+	TEXT("carbon.Telemetry.Enabled"), 1,
+	TEXT("Record per-frame combat telemetry and dump it on hitches."));
+
+static TAutoConsoleVariable<float> CVarTelemetryHitchThreshold(
+	TEXT("carbon.Telemetry.HitchThresholdMs"), 50.0f,
+	TEXT("Frames longer than this trigger a telemetry dump."));
+
+static TAutoConsoleVariable<float> CVarTelemetryDumpSeconds(
+	TEXT("carbon.Telemetry.DumpSeconds"), 5.0f,
+	TEXT("Seconds of history written per dump."));
+
+static TAutoConsoleVariable<float> CVarTelemetryDumpCooldown(
+	TEXT("carbon.Telemetry.DumpCooldown"), 10.0f,
+	TEXT("Minimum real seconds between dumps."));
+
+static TAutoConsoleVariable<float> CVarTelemetrySoakInterval(
+	TEXT("carbon.Telemetry.SoakInterval"), 0.0f,
+	TEXT("Real seconds between soak rows of frame time and memory (0 = off)."));
+
+/** Frames kept in the ring (about 17 seconds at 120 fps) */
+static const int32 TelemetryHistoryFrames = 2048;
+
+UCombatTelemetrySubsystem* UCombatTelemetrySubsystem::Get(const UObject* WorldContextObject)
+{
+	UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr;
+	return World ? World->GetSubsystem<UCombatTelemetrySubsystem>() : nullptr;
+}
+
+bool UCombatTelemetrySubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+	return WITH_COMBAT_TELEMETRY;
+}
+
+void UCombatTelemetrySubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	History.SetNum(TelemetryHistoryFrames);
+}
+
+void UCombatTelemetrySubsystem::Deinitialize()
+{
+	FlushSoakRows(true);
+
+	Super::Deinitialize();
+}
+
+void UCombatTelemetrySubsystem::Tick(float DeltaTime)
+{
+	UpdateSoak(DeltaTime * 1000.0f);
+
+	// Tickables run after all actors, so this closes the frame
+	Recording = CVarTelemetryEnabled.GetValueOnGameThread() != 0;
+	if (!Recording)
+	{
+		CurrentFrame = FCombatTelemetryFrame();
+		return;
+	}
+
+	CurrentFrame.FrameNumber = GFrameCounter;
+	CurrentFrame.WorldTime = GetWorld()->GetTimeSeconds();
+	CurrentFrame.FrameTimeMs = DeltaTime * 1000.0f;
+
+	History[HistoryHead] = CurrentFrame;
+	HistoryHead = (HistoryHead + 1) % History.Num();
+	HistoryCount = FMath::Min(HistoryCount + 1, History.Num());
+
+	if (CurrentFrame.FrameTimeMs > CVarTelemetryHitchThreshold.GetValueOnGameThread()
+		&& FPlatformTime::Seconds() - LastDumpTime > CVarTelemetryDumpCooldown.GetValueOnGameThread())
+	{
+		LastDumpTime = FPlatformTime::Seconds();
+		DumpHistory();
+	}
+
+	CurrentFrame = FCombatTelemetryFrame();
+}
+
+void UCombatTelemetrySubsystem::DumpHistory()
+{
+	// Copy out the requested window (oldest first), then format and write on a worker thread
+	float Cutoff = CurrentFrame.WorldTime - CVarTelemetryDumpSeconds.GetValueOnGameThread();
+	TArray<FCombatTelemetryFrame> Frames;
+	Frames.Reserve(HistoryCount);
+	for (int32 Offset = HistoryCount; Offset > 0; --Offset)
+	{
+		const FCombatTelemetryFrame& Frame = History[(HistoryHead - Offset + History.Num()) % History.Num()];
+		if (Frame.WorldTime >= Cutoff)
+			Frames.Add(Frame);
+	}
+
+	FString Path = FPaths::ProfilingDir() / TEXT("CombatTelemetry") / FString::Printf(TEXT("Hitch_%s_%llu.csv"), *FDateTime::Now().ToString(), CurrentFrame.FrameNumber);
+	UE_LOG(LogCarbon, Warning, TEXT("%.1f ms frame, writing combat telemetry to %s"), CurrentFrame.FrameTimeMs, *Path);
+
+	Async(EAsyncExecution::ThreadPool, [Frames = MoveTemp(Frames), Path]()
+	{
+		FString Csv = TEXT("Frame,WorldTime,FrameMs,StateMachineMs,Idle,ChaseClose,ChaseFar,Attack,Stumble,Taunt,Dead,Hits,Montages,PathRequests,OverlapQueries\n");
+		for (const FCombatTelemetryFrame& Frame : Frames)
+		{
+			Csv += FString::Printf(TEXT("%llu,%.3f,%.3f,%.3f"), Frame.FrameNumber, Frame.WorldTime, Frame.FrameTimeMs, Frame.StateMachineMs);
+			for (uint16 Count : Frame.EnemiesInState)
+				Csv += FString::Printf(TEXT(",%u"), Count);
+			Csv += FString::Printf(TEXT(",%u,%u,%u,%u\n"), Frame.HitsApplied, Frame.MontagesStarted, Frame.PathRequests, Frame.OverlapQueries);
+		}
+		FFileHelper::SaveStringToFile(Csv, *Path);
+	});
+}
+
+void UCombatTelemetrySubsystem::UpdateSoak(float FrameTimeMs)
+{
+	// Rows held back while the last write was busy
+	FlushSoakRows(false);
+
+	const float Interval = CVarTelemetrySoakInterval.GetValueOnGameThread();
+	const double Now = FPlatformTime::Seconds();
+	if (Interval <= 0.0f)
+	{
+		SoakIntervalStart = -1.0;
+		return;
+	}
+
+	if (SoakIntervalStart < 0.0)
+	{
+		SoakIntervalStart = Now;
+		SoakFrames = 0;
+		SoakFrameMsSum = 0.0;
+		SoakMaxFrameMs = 0.0f;
+		return;
+	}
+
+	++SoakFrames;
+	SoakFrameMsSum += FrameTimeMs;
+	SoakMaxFrameMs = FMath::Max(SoakMaxFrameMs, FrameTimeMs);
+	if (Now - SoakIntervalStart < Interval)
+		return;
+
+	const FPlatformMemoryStats Memory = FPlatformMemory::GetStats();
+	const float AverageFrameMs = (float)(SoakFrameMsSum / SoakFrames);
+	const int32 NumObjects = GUObjectArray.GetObjectArrayNumMinusAvailable();
+
+	FString Row;
+	if (SoakPath.IsEmpty())
+	{
+		SoakPath = FPaths::ProfilingDir() / TEXT("CombatTelemetry") / FString::Printf(TEXT("Soak_%s.csv"), *FDateTime::Now().ToString());
+		SoakStartTime = SoakIntervalStart;
+		SoakBaselineFrameMs = AverageFrameMs;
+		SoakBaselineMemory = Memory.UsedPhysical;
+		Row = TEXT("Seconds,WorldTime,Frames,AverageFrameMs,MaxFrameMs,UsedPhysicalMB,PeakUsedPhysicalMB,UObjects\n");
+		UE_LOG(LogCarbon, Log, TEXT("Writing soak telemetry to %s"), *SoakPath);
+	}
+
+	Row += FString::Printf(TEXT("%.0f,%.1f,%d,%.3f,%.3f,%.1f,%.1f,%d\n"), Now - SoakStartTime, GetWorld()->GetTimeSeconds(), SoakFrames,
+		AverageFrameMs, SoakMaxFrameMs, Memory.UsedPhysical / (1024.0 * 1024.0), Memory.PeakUsedPhysical / (1024.0 * 1024.0), NumObjects);
+
+	UE_LOG(LogCarbon, Display, TEXT("Soak %.0f s: %.2f ms average frame (%+.1f%%), %.2f ms worst, %.0f MB used (%+.1f MB), %d objects"),
+		Now - SoakStartTime, AverageFrameMs, 100.0f * (AverageFrameMs / FMath::Max(SoakBaselineFrameMs, KINDA_SMALL_NUMBER) - 1.0f), SoakMaxFrameMs,
+		Memory.UsedPhysical / (1024.0 * 1024.0), ((double)Memory.UsedPhysical - (double)SoakBaselineMemory) / (1024.0 * 1024.0), NumObjects);
+
+	SoakPendingRows += Row;
+	FlushSoakRows(false);
+
+	SoakIntervalStart = Now;
+	SoakFrames = 0;
+	SoakFrameMsSum = 0.0;
+	SoakMaxFrameMs = 0.0f;
+}
+
+void UCombatTelemetrySubsystem::FlushSoakRows(bool Wait)
+{
+	if (SoakWrite.IsValid())
+	{
+		if (!Wait && !SoakWrite.IsReady())
+			return;
+		SoakWrite.Wait();
+	}
+
+	if (SoakPendingRows.IsEmpty())
+		return;
+
+	// Appends from separate tasks could land out of order (or interleave), so rows queue up behind
+	// the one write in flight and go out together once it is done
+	SoakWrite = Async(EAsyncExecution::ThreadPool, [Rows = MoveTemp(SoakPendingRows), Path = SoakPath]()
+	{
+		FFileHelper::SaveStringToFile(Rows, *Path, FFileHelper::EEncodingOptions::AutoDetect, &IFileManager::Get(), FILEWRITE_Append);
+	});
+	SoakPendingRows.Reset();
+
+	if (Wait)
+		SoakWrite.Wait();
+}
+
+ETickableTickType UCombatTelemetrySubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Always;
+}
+
+TStatId UCombatTelemetrySubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UCombatTelemetrySubsystem, STATGROUP_Tickables);
+}
@@ -0,0 +1,131 @@
+// Sam Smith
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Async/Future.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "EnemyBase.h"
+#include "CombatTelemetry.generated.h"
+
+/** Telemetry is compiled into every build except Shipping */
+#define WITH_COMBAT_TELEMETRY (!UE_BUILD_SHIPPING)
+
+/** Counters and timings recorded for one frame */
+struct FCombatTelemetryFrame
+{
+	uint64 FrameNumber = 0;
+	float WorldTime = 0.0f;
+	float FrameTimeMs = 0.0f;
+
+	/** Time spent in enemy state machines */
+	float StateMachineMs = 0.0f;
+
+	uint16 EnemiesInState[(int32)State::DEAD + 1] = {};
+	uint16 HitsApplied = 0;
+	uint16 MontagesStarted = 0;
+	uint16 PathRequests = 0;
+	uint16 OverlapQueries = 0;
+};
+
+/**
+ * Always-on ring buffer of per-frame combat counters. When a frame takes longer than
+ * carbon.Telemetry.HitchThresholdMs, the last carbon.Telemetry.DumpSeconds of frames are
+ * written (off the game thread) as CSV to Saved/Profiling/CombatTelemetry.
+ * Record from combat code with the COMBAT_TELEMETRY_* macros below, passing a subsystem pointer
+ * cached by the caller (ACombatant::GetTelemetry) so recording never looks the subsystem up.
+ * For soak runs, carbon.Telemetry.SoakInterval also appends a row of frame time and memory
+ * every interval to Saved/Profiling/CombatTelemetry/Soak_*.csv, logging the drift since the
+ * first row.
+ */
+UCLASS()
+class CARBON_API UCombatTelemetrySubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	static UCombatTelemetrySubsystem* Get(const UObject* WorldContextObject);
+
+	/** The frame currently being recorded */
+	FCombatTelemetryFrame& GetFrame() { return CurrentFrame; }
+
+	/** False while carbon.Telemetry.Enabled is 0 (timed scopes skip their clock reads then) */
+	bool IsRecording() const { return Recording; }
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+private:
+	void DumpHistory();
+
+	/** Close the current soak interval if it is over */
+	void UpdateSoak(float FrameTimeMs);
+
+	/** Hand pending soak rows to the writer unless it is still busy (or wait for it, when Wait) */
+	void FlushSoakRows(bool Wait);
+
+	FCombatTelemetryFrame CurrentFrame;
+
+	bool Recording = true;
+
+	/** Preallocated ring - recording never allocates */
+	TArray<FCombatTelemetryFrame> History;
+	int32 HistoryHead = 0;
+	int32 HistoryCount = 0;
+
+	double LastDumpTime = -BIG_NUMBER;
+
+	// Soak interval being measured
+	double SoakIntervalStart = -1.0;
+	int32 SoakFrames = 0;
+	double SoakFrameMsSum = 0.0;
+	float SoakMaxFrameMs = 0.0f;
+
+	// First soak row, which later rows are compared to
+	FString SoakPath;
+	double SoakStartTime = 0.0;
+	float SoakBaselineFrameMs = 0.0f;
+	uint64 SoakBaselineMemory = 0;
+
+	/** Rows not yet handed to the writer, which appends them in order - one write in flight at a time */
+	FString SoakPendingRows;
+	TFuture<void> SoakWrite;
+};
+
+/** Adds the elapsed time of a scope to a millisecond counter */
+struct FCombatTelemetryScopeTimer
+{
+	FCombatTelemetryScopeTimer(float* InCounter)
+		: Counter(InCounter), StartCycles(InCounter ? FPlatformTime::Cycles64() : 0)
+	{}
+
+	~FCombatTelemetryScopeTimer()
+	{
+		if (Counter)
+			*Counter += (float)FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles);
+	}
+
+	float* Counter;
+	uint64 StartCycles;
+};
+
+#if WITH_COMBAT_TELEMETRY
+#define COMBAT_TELEMETRY_ADD(Telemetry, Counter, Amount) \
+	do { if (UCombatTelemetrySubsystem* _Telemetry = (Telemetry)) { _Telemetry->GetFrame().Counter += (Amount); } } while (0)
+#define COMBAT_TELEMETRY_SCOPE(Telemetry, Counter) \
+	UCombatTelemetrySubsystem* PREPROCESSOR_JOIN(_Telemetry, __LINE__) = (Telemetry); \
+	FCombatTelemetryScopeTimer PREPROCESSOR_JOIN(_TelemetryTimer, __LINE__)(PREPROCESSOR_JOIN(_Telemetry, __LINE__) && PREPROCESSOR_JOIN(_Telemetry, __LINE__)->IsRecording() ? &PREPROCESSOR_JOIN(_Telemetry, __LINE__)->GetFrame().Counter : nullptr)
+#else
+#define COMBAT_TELEMETRY_ADD(Telemetry, Counter, Amount)
+#define COMBAT_TELEMETRY_SCOPE(Telemetry, Counter)
+#endif
@@ -2,31 +2,177 @@
 
 #include "Combatant.h"
 #include "GameFramework/CharacterMovementComponent.h"
+#include "GameFramework/RootMotionSource.h"
+#include "Animation/AnimMontage.h"
+#include "Engine/World.h"
+#include "Carbon.h"
+#include "CombatArchetype.h"
+#include "CombatantRegistry.h"
+#include "CombatClock.h"
+#include "CombatTelemetry.h"
+#include "Camera/CameraShakeBase.h"
+#include "CombatEventLog.h"
 
 
+FOnCombatantDamaged ACombatant::OnAnyDamaged;
+
 // Sets default values
-ACombatant::ACombatant()
+ACombatant::ACombatant(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer)
 {
  	// Set this character to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = true;
 
+	CombatFlags = ECombatFlags::RotateTowardsTarget;
 	TargetLocked = false;
-	NextAttackReady = false;
-	Attacking = false;
-	AttackDamaging = false;
-	MovingForward = false;
-	MovingBackwards = false;
-	RotateTowardsTarget = true;
-	Stumbling = false;
+	RegistrySlot = INDEX_NONE;
+	Registry = nullptr;
+	Clock = nullptr;
+	Telemetry = nullptr;
 	RotationSmoothing = 5.0f;
 	LastRotationSpeed = 0.0f;
+	LungeDuration = 0.1f;
+	ArchetypeSubsystem = nullptr;
+	TuningIndex = 0;
+	ArchetypeHeld = false;
+	ForwardMotionID = (uint16)ERootMotionSourceID::Invalid;
+	HitSpark = nullptr;
+	HitSound = nullptr;
 }
 
 // Called when the game starts or when spawned
 void ACombatant::BeginPlay()
 {
 	Super::BeginPlay();
-	
+
+	EnsureRegistered();
+
+	Telemetry = UCombatTelemetrySubsystem::Get(this);
+
+	ArchetypeSubsystem = GetWorld()->GetSubsystem<UCombatArchetypeSubsystem>();
+	if (!Archetype)
+		Archetype = ArchetypeSubsystem->GetLegacyArchetype(this);
+	TuningIndex = ArchetypeSubsystem->GetTuningIndex(Archetype);
+
+	if (Archetype)
+		SetArchetypeHeld(true);
+	else
+		UE_LOG(LogCarbon, Warning, TEXT("%s has no combat archetype and will not fight"), *GetName());
+}
+
+void ACombatant::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	SetArchetypeHeld(false);
+
+	LeaveRegistry();
+	TargetHandle = FCombatantHandle();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ACombatant::SetArchetypeHeld(bool Held)
+{
+	if (!Archetype || !ArchetypeSubsystem || ArchetypeHeld == Held)
+		return;
+	ArchetypeHeld = Held;
+
+	if (Held)
+		ArchetypeSubsystem->Acquire(Archetype);
+	else
+		ArchetypeSubsystem->Release(Archetype);
+}
+
+void ACombatant::LeaveRegistry()
+{
+	if (RegistrySlot != INDEX_NONE)
+		Registry->Unregister(RegistrySlot);
+	RegistrySlot = INDEX_NONE;
+
+	// A hit-stop in progress belongs to the old slot
+	CustomTimeDilation = 1.0f;
+}
+
+void ACombatant::EnsureRegistered()
+{
+	// Never re-register once torn down, handles to the old slot must stay stale
+	if (RegistrySlot != INDEX_NONE || !GetWorld() || IsActorBeingDestroyed() || IsParked())
+		return;
+
+	Registry = GetWorld()->GetSubsystem<UCombatantRegistry>();
+	if (Registry)
+		RegistrySlot = Registry->Register(this);
+	Clock = GetWorld()->GetSubsystem<UCombatClockSubsystem>();
+}
+
+FCombatantHandle ACombatant::GetHandle()
+{
+	EnsureRegistered();
+	return RegistrySlot != INDEX_NONE ? Registry->GetHandle(RegistrySlot) : FCombatantHandle();
+}
+
+FCombatantHandle ACombatant::GetHandleOf(AActor* Actor)
+{
+	ACombatant* Combatant = Cast<ACombatant>(Actor);
+	return Combatant ? Combatant->GetHandle() : FCombatantHandle();
+}
+
+ACombatant* ACombatant::GetTarget() const
+{
+	return Registry ? Registry->Resolve(TargetHandle) : nullptr;
+}
+
+float ACombatant::GetLocalTime() const
+{
+	return Clock && RegistrySlot != INDEX_NONE ? Clock->GetLocalTime(RegistrySlot) : GetWorld()->GetTimeSeconds();
+}
+
+float ACombatant::GetLocalDeltaTime() const
+{
+	return Clock && RegistrySlot != INDEX_NONE ? Clock->GetDeltaTime(RegistrySlot) : GetWorld()->GetDeltaSeconds();
+}
+
+void ACombatant::AssignTarget(AActor* NewTarget)
+{
+	TargetHandle = GetHandleOf(NewTarget);
+}
+
+bool ACombatant::CheckAndMarkAttackHit(AActor* Actor)
+{
+	FCombatantHandle Handle = GetHandleOf(Actor);
+	if (Handle.IsSet())
+	{
+		if (AttackHitCombatants.Contains(Handle))
+			return true;
+		AttackHitCombatants.Add(Handle);
+		return false;
+	}
+
+	if (AttackHitOthers.Contains(Actor))
+		return true;
+	AttackHitOthers.Add(Actor);
+	return false;
+}
+
+void ACombatant::GetLegacyMontages(UCombatArchetype& Legacy) const
+{
+	Legacy.AttackAnimations = AttackAnimations;
+	Legacy.TakeHit_StumbleBackwards = TakeHit_StumbleBackwards;
+}
+
+bool ACombatant::IsArchetypeLoaded() const
+{
+	return Archetype && ArchetypeSubsystem && ArchetypeSubsystem->IsLoaded(Archetype);
+}
+
+const FCombatTuning& ACombatant::GetTuning() const
+{
+	static const FCombatTuning DefaultTuning;
+	return ArchetypeSubsystem ? ArchetypeSubsystem->GetTuning(TuningIndex) : DefaultTuning;
+}
+
+UAnimMontage* ACombatant::GetLoadedMontage(const TArray<TSoftObjectPtr<UAnimMontage>>& Montages, int32 Index)
+{
+	return Montages.IsValidIndex(Index) ? Montages[Index].Get() : nullptr;
 }
 
 // Called every frame
@@ -35,7 +181,7 @@ void ACombatant::Tick(float DeltaTime)
 	Super::Tick(DeltaTime);
 
 	// Look towards target
-	if (RotateTowardsTarget)
+	if (IsRotatingTowardsTarget())
 		LookAtSmooth();
 
 }
@@ -47,17 +193,41 @@ void ACombatant::SetupPlayerInputComponent(UInputComponent* PlayerInputComponent
 
 }
 
+void ACombatant::SetCombatFlag(ECombatFlags Flag, bool Value)
+{
+	if (Value)
+		CombatFlags |= Flag;
+	else
+		CombatFlags &= ~Flag;
+	TargetLocked = HasAnyCombatFlags(ECombatFlags::TargetLocked);
+
+	// Mirror into the registry's packed array for batched scans
+	if (RegistrySlot != INDEX_NONE)
+		Registry->SetFlags(RegistrySlot, CombatFlags);
+}
+
+float ACombatant::PlayAnimMontage(UAnimMontage* AnimMontage, float InPlayRate, FName StartSectionName)
+{
+	COMBAT_TELEMETRY_ADD(Telemetry, MontagesStarted, 1);
+
+	return Super::PlayAnimMontage(AnimMontage, InPlayRate, StartSectionName);
+}
+
 void ACombatant::Attack()
 {
-	Attacking = true;
-	NextAttackReady = false;
-	AttackDamaging = false;
-	AttackHitActors.Empty();
+	SetCombatFlag(ECombatFlags::Attacking, true);
+	SetCombatFlag(ECombatFlags::NextAttackReady, false);
+	SetCombatFlag(ECombatFlags::AttackDamaging, false);
+	AttackHitCombatants.Reset();
+	AttackHitOthers.Reset();
+
+	COMBAT_EVENT(ATTACK_START, this, GetTarget());
 }
 
 void ACombatant::AttackLunge()
 {
 	// Look at target
+	ACombatant* Target = GetTarget();
 	if (Target != NULL)
 	{
 		FVector Direction = Target->GetActorLocation() - GetActorLocation();
@@ -66,61 +236,113 @@ void ACombatant::AttackLunge()
 		SetActorRotation(Rotation);
 	}
 
-	// Teleport forward
-	FVector NewLocation = GetActorLocation() + (GetActorForwardVector() * 70);
-	SetActorLocation(NewLocation, true);
+	// Jump forward - applied as root motion so it shares CharacterMovement's sweep
+	TSharedPtr<FRootMotionSource_MoveToForce> Lunge = MakeShared<FRootMotionSource_MoveToForce>();
+	Lunge->InstanceName = TEXT("AttackLunge");
+	Lunge->AccumulateMode = ERootMotionAccumulateMode::Override;
+	Lunge->Priority = 10;
+	Lunge->StartLocation = GetActorLocation();
+	Lunge->TargetLocation = GetActorLocation() + (GetActorForwardVector() * GetTuning().LungeDistance);
+	Lunge->Duration = LungeDuration;
+	Lunge->FinishVelocityParams.Mode = ERootMotionFinishVelocityMode::SetVelocity;
+	Lunge->FinishVelocityParams.SetVelocity = FVector::ZeroVector;
+	GetCharacterMovement()->ApplyRootMotionSource(Lunge);
 }
 
 void ACombatant::EndAttack()
 {
-	Attacking = false;
-	NextAttackReady = false;
+	if (IsAttacking())
+		COMBAT_EVENT(ATTACK_END, this);
+
+	SetCombatFlag(ECombatFlags::Attacking, false);
+	SetCombatFlag(ECombatFlags::NextAttackReady, false);
 }
 
 void ACombatant::SetAttackDamaging(bool Damaging)
 {
-	AttackDamaging = Damaging;
+	SetCombatFlag(ECombatFlags::AttackDamaging, Damaging);
 }
 
 void ACombatant::SetMovingForward(bool IsMovingForward)
 {
-	MovingForward = IsMovingForward;
+	SetCombatFlag(ECombatFlags::MovingForward, IsMovingForward);
 }
 
 void ACombatant::SetMovingBackwards(bool IsMovingBackwards)
 {
-	MovingBackwards = IsMovingBackwards;
+	SetCombatFlag(ECombatFlags::MovingBackwards, IsMovingBackwards);
 }
 
 void ACombatant::EndStumble()
 {
-	Stumbling = false;
+	SetCombatFlag(ECombatFlags::Stumbling, false);
 }
 
 void ACombatant::AttackNextReady()
 {
-	NextAttackReady = true;
+	SetCombatFlag(ECombatFlags::NextAttackReady, true);
 }
 
 void ACombatant::LookAtSmooth()
 {
 	// Smoothly rotate towards target
-	if (Target != NULL && TargetLocked && !Attacking && !GetCharacterMovement()->IsFalling())
+	ACombatant* Target = GetTarget();
+	if (Target != NULL && IsTargetLocked() && !IsAttacking() && !GetCharacterMovement()->IsFalling())
 	{
 		FVector Direction = Target->GetActorLocation() - GetActorLocation();
-		Direction = FVector(Direction.X, Direction.Y, 0);
-		FRotator Rotation = FRotationMatrix::MakeFromX(Direction).Rotator();
+		float CurrentYaw = GetActorRotation().Yaw;
+		float SmoothedYaw = CombatCore::SmoothYaw(CurrentYaw, CombatCore::YawTowards(Direction.X, Direction.Y), RotationSmoothing, GetLocalDeltaTime());
 
-		FRotator SmoothedRotation = FMath::Lerp(GetActorRotation(), Rotation, RotationSmoothing * GetWorld()->DeltaTimeSeconds);
 		// Save yaw difference to variable (for anim)
-		LastRotationSpeed = SmoothedRotation.Yaw - GetActorRotation().Yaw;
-		SetActorRotation(SmoothedRotation);
+		LastRotationSpeed = SmoothedYaw - CurrentYaw;
+		SetActorRotation(FRotator(0.0f, SmoothedYaw, 0.0f));
+	}
+}
+
+void ACombatant::StartForwardMotion(float Speed)
+{
+	StopForwardMotion();
+
+	TSharedPtr<FRootMotionSource_ConstantForce> Force = MakeShared<FRootMotionSource_ConstantForce>();
+	Force->InstanceName = TEXT("AttackForwardMotion");
+	Force->AccumulateMode = ERootMotionAccumulateMode::Override;
+	Force->Priority = 5;
+	Force->Force = GetActorForwardVector() * Speed;
+	Force->Duration = -1.0f;	// Until removed
+	Force->FinishVelocityParams.Mode = ERootMotionFinishVelocityMode::SetVelocity;
+	Force->FinishVelocityParams.SetVelocity = FVector::ZeroVector;
+	ForwardMotionID = GetCharacterMovement()->ApplyRootMotionSource(Force);
+}
+
+void ACombatant::StopForwardMotion()
+{
+	if (ForwardMotionID != (uint16)ERootMotionSourceID::Invalid)
+	{
+		GetCharacterMovement()->RemoveRootMotionSourceByID(ForwardMotionID);
+		ForwardMotionID = (uint16)ERootMotionSourceID::Invalid;
 	}
 }
 
+TSubclassOf<UCameraShakeBase> ACombatant::GetHitCameraShake() const
+{
+	return nullptr;
+}
+
+CombatCore::FActionState ACombatant::GetActionState() const
+{
+	CombatCore::FActionState State;
+	State.Attacking = IsAttacking();
+	State.NextAttackReady = IsNextAttackReady();
+	State.Rolling = IsRolling();
+	State.Stumbling = IsStumbling();
+	State.Falling = GetCharacterMovement()->IsFalling();
+	State.Loaded = IsArchetypeLoaded();
+	return State;
+}
+
 float ACombatant::GetCurrentRotationSpeed()
 {
-	if (RotateTowardsTarget)
+	if (IsRotatingTowardsTarget())
 	{
 		return LastRotationSpeed;
 	}
@@ -4,8 +4,68 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
+#include "CombatCore.h"
 #include "Combatant.generated.h"
 
+class UCombatArchetype;
+
+/** Combat state of one combatant, packed into a single word (see ACombatant::GetCombatFlags) */
+enum class ECombatFlags : uint16
+{
+	None				= 0,
+	TargetLocked		= 1 << 0,
+	Attacking			= 1 << 1,
+	AttackDamaging		= 1 << 2,	// Weapon currently applies damage
+	MovingForward		= 1 << 3,
+	MovingBackwards		= 1 << 4,
+	NextAttackReady		= 1 << 5,	// Combo window open
+	Stumbling			= 1 << 6,
+	RotateTowardsTarget	= 1 << 7,
+	Rolling				= 1 << 8,	// Player only
+
+	/** Performing an action that blocks movement input */
+	Busy				= Attacking | Rolling | Stumbling,
+};
+ENUM_CLASS_FLAGS(ECombatFlags)
+
+/**
+ * Reference to a combatant by registry slot and generation, resolved in O(1) by
+ * UCombatantRegistry::Resolve. Slots are reused, but a slot's generation changes when its
+ * combatant leaves, so handles to destroyed combatants resolve to null. 0 is never valid.
+ */
+struct FCombatantHandle
+{
+	static const uint32 IndexBits = 20;
+	static const uint32 IndexMask = (1u << IndexBits) - 1;
+	static const uint32 MaxGeneration = (1u << (32 - IndexBits)) - 1;
+
+	FCombatantHandle() : Value(0) {}
+	FCombatantHandle(int32 Index, uint32 Generation) : Value((Generation << IndexBits) | ((uint32)Index & IndexMask)) {}
+
+	int32 GetIndex() const { return Value & IndexMask; }
+	uint32 GetGeneration() const { return Value >> IndexBits; }
+	bool IsSet() const { return Value != 0; }
+
+	bool operator==(FCombatantHandle Other) const { return Value == Other.Value; }
+	bool operator!=(FCombatantHandle Other) const { return Value != Other.Value; }
+	friend uint32 GetTypeHash(FCombatantHandle Handle) { return Handle.Value; }
+
+	uint32 Value;
+};
+
+class UCombatArchetypeSubsystem;
+class UCombatantRegistry;
+class UCombatClockSubsystem;
+class UCombatTelemetrySubsystem;
+struct FCombatTuning;
+class UParticleSystem;
+class USoundBase;
+class UCameraShakeBase;
+class ACombatant;
+
+/** Victim, damage causer and amount of damage a combatant accepted */
+DECLARE_MULTICAST_DELEGATE_ThreeParams(FOnCombatantDamaged, ACombatant*, AActor*, float);
+
 UCLASS()
 class CARBON_API ACombatant : public ACharacter
 {
@@ -13,38 +73,101 @@ class CARBON_API ACombatant : public ACharacter
 
 public:
 	// Sets default values for this character's properties
-	ACombatant();
+	ACombatant(const FObjectInitializer& ObjectInitializer = FObjectInitializer::Get());
 
 protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
-	AActor * Target;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/** Current target (resolves to null once it is destroyed) */
+	FCombatantHandle TargetHandle;
+
+	/** Set TargetHandle from an actor - anything that isn't a combatant clears it */
+	void AssignTarget(AActor* NewTarget);
+
+	/**
+	 * Register with UCombatantRegistry if not already (targets can be assigned before their BeginPlay).
+	 * Does nothing while parked, so looking up a parked combatant never brings it back
+	 */
+	void EnsureRegistered();
+
+	/** Out of play, e.g. an enemy waiting in its pool - kept out of the registry */
+	virtual bool IsParked() const { return false; }
+
+	/** Give up the registry slot - every handle to this combatant goes stale */
+	void LeaveRegistry();
+
+	UCombatantRegistry* Registry;
+
+	UCombatClockSubsystem* Clock;
+
+	/** Cached for the COMBAT_TELEMETRY_* macros (null when telemetry is compiled out) */
+	UCombatTelemetrySubsystem* Telemetry;
+
+	void SetCombatFlag(ECombatFlags Flag, bool Value);
+
+	ECombatFlags CombatFlags;
+
+	/** Copy of the TargetLocked flag for blueprints that read the property (kept in sync by SetCombatFlag) */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Combat")
 	bool TargetLocked;
 
-	bool Attacking;
-	bool AttackDamaging;
-	bool MovingForward;
-	bool MovingBackwards;
-	bool NextAttackReady;
-	bool Stumbling;
+	/** Slot in UCombatantRegistry (INDEX_NONE when not registered) */
+	int32 RegistrySlot;
 
-	bool RotateTowardsTarget;
 	UPROPERTY(EditAnywhere, Category = "Animation")
 	float RotationSmoothing;
 
-	UPROPERTY(EditAnywhere, Category = "Animations")
-		TArray<UAnimMontage*> AttackAnimations;
+	/** Seconds over which AttackLunge moves the character forward */
+	UPROPERTY(EditAnywhere, Category = "Combat")
+	float LungeDuration;
+
+	/** ID of the root motion source pushing the character forward (0 if none) */
+	uint16 ForwardMotionID;
+
+	/** Shared animation set (streamed in on BeginPlay) */
+	UPROPERTY(EditAnywhere, Category = "Combat")
+	UCombatArchetype* Archetype;
+
+	/** Deprecated: set on the archetype instead. Only used while no Archetype is assigned */
+	UPROPERTY(EditAnywhere, Category = "Animations", meta = (DeprecatedProperty, DeprecationMessage = "Use the combat archetype's AttackAnimations"))
+	TArray<TSoftObjectPtr<UAnimMontage>> AttackAnimations;
+
+	/** Deprecated: set on the archetype instead. Only used while no Archetype is assigned */
+	UPROPERTY(EditAnywhere, Category = "Animations", meta = (DeprecatedProperty, DeprecationMessage = "Use the combat archetype's TakeHit_StumbleBackwards"))
+	TArray<TSoftObjectPtr<UAnimMontage>> TakeHit_StumbleBackwards;
 
-	UPROPERTY(EditAnywhere, Category = "Animations")
-		TArray<UAnimMontage*> TakeHit_StumbleBackwards;
+	/** True once the archetype's assets have streamed in - combatants don't fight before that */
+	bool IsArchetypeLoaded() const;
 
-	/* Actors hit with the last attack - Used to stop duplicate hits*/
-	TArray<AActor*> AttackHitActors;
+	/** Archetype's shared tuning (defaults before BeginPlay or without an archetype) */
+	const FCombatTuning& GetTuning() const;
+
+	UCombatArchetypeSubsystem* ArchetypeSubsystem;
+	int32 TuningIndex;
+
+	/** Take (or give back) this combatant's reference on its archetype's streamed assets - repeated calls do nothing */
+	void SetArchetypeHeld(bool Held);
+
+	bool ArchetypeHeld;
+
+	/** Montage at Index, or null if out of range or not loaded */
+	static UAnimMontage* GetLoadedMontage(const TArray<TSoftObjectPtr<UAnimMontage>>& Montages, int32 Index);
+
+	/* Combatants (and other actors) hit with the last attack - Used to stop duplicate hits*/
+	TArray<FCombatantHandle, TInlineAllocator<8>> AttackHitCombatants;
+	TArray<TWeakObjectPtr<AActor>> AttackHitOthers;
+
+	/** True if Actor was already hit by the current attack, otherwise remembers it and returns false */
+	bool CheckAndMarkAttackHit(AActor* Actor);
 
 	virtual void Attack();
 
+	/** Plays a montage (counted by combat telemetry) */
+	virtual float PlayAnimMontage(class UAnimMontage* AnimMontage, float InPlayRate = 1.0f, FName StartSectionName = NAME_None) override;
+
 	/** Anim called: Rotate and jump towards target */
 	UFUNCTION(BlueprintCallable, Category = "Combat")
 	virtual void AttackLunge();
@@ -75,12 +198,84 @@ protected:
 
 	virtual void LookAtSmooth();
 
-	/** Anim called: Get rate of actor's look rotation */
+	/** Move forward at Speed through CharacterMovement until StopForwardMotion is called */
+	void StartForwardMotion(float Speed);
+
+	void StopForwardMotion();
+
+	/** Anim called: Get rate of actor's look rotation
+	 *  (game thread only - thread-safe graphs should read UCombatantAnimInstance's proxy) */
 	UFUNCTION(BlueprintCallable, Category = "Animation")
 	float GetCurrentRotationSpeed();
 	float LastRotationSpeed;
 
+	friend struct FCombatantAnimInstanceProxy;
+
 public:	
+	/** Spawned where this combatant's weapon hits something (see UHitFeedbackSubsystem) */
+	UPROPERTY(EditAnywhere, Category = "Feedback")
+	UParticleSystem* HitSpark;
+
+	/** Played where this combatant's weapon hits something */
+	UPROPERTY(EditAnywhere, Category = "Feedback")
+	USoundBase* HitSound;
+
+	/** Camera shake for hits this combatant deals or takes (only used for the local player) */
+	virtual TSubclassOf<UCameraShakeBase> GetHitCameraShake() const;
+
+	UCombatArchetype* GetArchetype() const { return Archetype; }
+
+	/** Archetype's row in UCombatArchetypeSubsystem's tuning table */
+	int32 GetTuningIndex() const { return TuningIndex; }
+
+	float GetRotationSmoothing() const { return RotationSmoothing; }
+
+	/**
+	 * Copy the deprecated montage properties into Legacy (see UCombatArchetypeSubsystem::GetLegacyArchetype).
+	 * They are soft references as well, so loading a class doesn't load its old montages
+	 */
+	virtual void GetLegacyMontages(UCombatArchetype& Legacy) const;
+
+	/** Current target, or null if there is none or it has been destroyed */
+	ACombatant* GetTarget() const;
+
+	UCombatTelemetrySubsystem* GetTelemetry() const { return Telemetry; }
+
+	/** This combatant's own time (see UCombatClockSubsystem) - only compare it with its own timestamps */
+	float GetLocalTime() const;
+
+	/** Seconds this combatant's own time advanced this frame (slowed during hit-stop) */
+	float GetLocalDeltaTime() const;
+
+	FCombatantHandle GetTargetHandle() const { return TargetHandle; }
+
+	/** This combatant's handle (registering it first if needed) - unset while parked */
+	FCombatantHandle GetHandle();
+
+	/** Handle of Actor if it is a combatant, otherwise an unset handle */
+	static FCombatantHandle GetHandleOf(AActor* Actor);
+
+	/** Broadcast whenever any combatant (in any world) accepts damage */
+	static FOnCombatantDamaged OnAnyDamaged;
+
+	/** Current flags in the form the combat core's attack/roll rules take */
+	CombatCore::FActionState GetActionState() const;
+
+	ECombatFlags GetCombatFlags() const { return CombatFlags; }
+	bool HasAnyCombatFlags(ECombatFlags Mask) const { return EnumHasAnyFlags(CombatFlags, Mask); }
+	bool HasAllCombatFlags(ECombatFlags Mask) const { return EnumHasAllFlags(CombatFlags, Mask); }
+
+	UFUNCTION(BlueprintPure, Category = "Combat")
+	bool IsTargetLocked() const { return HasAnyCombatFlags(ECombatFlags::TargetLocked); }
+	bool IsAttacking() const { return HasAnyCombatFlags(ECombatFlags::Attacking); }
+	bool IsAttackDamaging() const { return HasAnyCombatFlags(ECombatFlags::AttackDamaging); }
+	bool IsMovingForward() const { return HasAnyCombatFlags(ECombatFlags::MovingForward); }
+	bool IsMovingBackwards() const { return HasAnyCombatFlags(ECombatFlags::MovingBackwards); }
+	bool IsNextAttackReady() const { return HasAnyCombatFlags(ECombatFlags::NextAttackReady); }
+	bool IsStumbling() const { return HasAnyCombatFlags(ECombatFlags::Stumbling); }
+	bool IsRotatingTowardsTarget() const { return HasAnyCombatFlags(ECombatFlags::RotateTowardsTarget); }
+	bool IsRolling() const { return HasAnyCombatFlags(ECombatFlags::Rolling); }
+
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
 
@@ -0,0 +1,27 @@
+// Sam Smith
+
+#include "CombatantAnimInstance.h"
+#include "Combatant.h"
+#include "GameFramework/CharacterMovementComponent.h"
+
+void FCombatantAnimInstanceProxy::PreUpdate(UAnimInstance* InAnimInstance, float DeltaSeconds)
+{
+	Super::PreUpdate(InAnimInstance, DeltaSeconds);
+
+	const ACombatant* Combatant = Cast<ACombatant>(InAnimInstance->TryGetPawnOwner());
+	if (!Combatant)
+		return;
+
+	TargetLocked = Combatant->IsTargetLocked();
+	Attacking = Combatant->IsAttacking();
+	Stumbling = Combatant->IsStumbling();
+	Rolling = Combatant->IsRolling();
+	MovingForward = Combatant->IsMovingForward();
+	MovingBackwards = Combatant->IsMovingBackwards();
+	RotationSpeed = Combatant->IsRotatingTowardsTarget() ? Combatant->LastRotationSpeed : 0.0f;
+	Speed = Combatant->GetVelocity().Size();
+	Falling = Combatant->GetCharacterMovement()->IsFalling();
+
+	if (const AEnemyBase* Enemy = Cast<AEnemyBase>(Combatant))
+		ActiveState = Enemy->ActiveState;
+}
@@ -0,0 +1,80 @@
+// Sam Smith
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Animation/AnimInstance.h"
+#include "Animation/AnimInstanceProxy.h"
+#include "EnemyBase.h"
+#include "CombatantAnimInstance.generated.h"
+
+/**
+ * Plain-data copy of a combatant's animation-relevant state.
+ * Filled once per frame on the game thread (PreUpdate), then only read by the
+ * anim graph, so graphs using it can run their update on worker threads.
+ */
+USTRUCT(BlueprintType)
+struct CARBON_API FCombatantAnimInstanceProxy : public FAnimInstanceProxy
+{
+	GENERATED_BODY()
+
+	FCombatantAnimInstanceProxy() {}
+
+	FCombatantAnimInstanceProxy(UAnimInstance* InAnimInstance)
+		: FAnimInstanceProxy(InAnimInstance)
+	{}
+
+	UPROPERTY(Transient, BlueprintReadOnly, Category = "Combat")
+	State ActiveState = State::IDLE;
+
+	UPROPERTY(Transient, BlueprintReadOnly, Category = "Combat")
+	bool TargetLocked = false;
+
+	UPROPERTY(Transient, BlueprintReadOnly, Category = "Combat")
+	bool Attacking = false;
+
+	UPROPERTY(Transient, BlueprintReadOnly, Category = "Combat")
+	bool Stumbling = false;
+
+	UPROPERTY(Transient, BlueprintReadOnly, Category = "Combat")
+	bool Rolling = false;
+
+	UPROPERTY(Transient, BlueprintReadOnly, Category = "Animation")
+	bool MovingForward = false;
+
+	UPROPERTY(Transient, BlueprintReadOnly, Category = "Animation")
+	bool MovingBackwards = false;
+
+	UPROPERTY(Transient, BlueprintReadOnly, Category = "Animation")
+	bool Falling = false;
+
+	/** Yaw change applied by LookAtSmooth last frame (see ACombatant::GetCurrentRotationSpeed) */
+	UPROPERTY(Transient, BlueprintReadOnly, Category = "Animation")
+	float RotationSpeed = 0.0f;
+
+	UPROPERTY(Transient, BlueprintReadOnly, Category = "Animation")
+	float Speed = 0.0f;
+
+protected:
+	/** Game thread: copy state from the owning combatant */
+	virtual void PreUpdate(UAnimInstance* InAnimInstance, float DeltaSeconds) override;
+};
+
+/**
+ * Base anim instance for ACombatant meshes (player and enemies).
+ * Anim blueprints should read the 'Proxy' struct instead of calling into the
+ * character, and enable 'Use Multi Threaded Animation Update'.
+ */
+UCLASS(Transient, Blueprintable)
+class CARBON_API UCombatantAnimInstance : public UAnimInstance
+{
+	GENERATED_BODY()
+
+	UPROPERTY(Transient, BlueprintReadOnly, Category = "Combat", meta = (AllowPrivateAccess = "true"))
+	FCombatantAnimInstanceProxy Proxy;
+
+	virtual FAnimInstanceProxy* CreateAnimInstanceProxy() override { return &Proxy; }
+	virtual void DestroyAnimInstanceProxy(FAnimInstanceProxy* InProxy) override {}
+
+	friend struct FCombatantAnimInstanceProxy;
+};
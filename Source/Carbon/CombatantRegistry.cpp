@@ -0,0 +1,64 @@
+// Sam Smith
+
+#include "CombatantRegistry.h"
+
+int32 UCombatantRegistry::Register(ACombatant* Combatant)
+{
+	int32 Slot;
+	if (FreeSlots.Num() > 0)
+	{
+		Slot = FreeSlots.Pop(false);
+		Combatants[Slot] = Combatant;
+	}
+	else
+	{
+		Slot = Combatants.Add(Combatant);
+		Flags.Add(ECombatFlags::None);
+		Generations.Add(1);
+		check((uint32)Slot <= FCombatantHandle::IndexMask);
+	}
+
+	Flags[Slot] = Combatant->GetCombatFlags();
+	return Slot;
+}
+
+void UCombatantRegistry::Unregister(int32 Slot)
+{
+	if (!Combatants.IsValidIndex(Slot))
+		return;
+
+	// Free slots keep no flags, so scans skip them without a separate check
+	Combatants[Slot] = nullptr;
+	Flags[Slot] = ECombatFlags::None;
+	Generations[Slot] = Generations[Slot] % FCombatantHandle::MaxGeneration + 1;
+	FreeSlots.Add(Slot);
+}
+
+int32 UCombatantRegistry::CountWithAnyFlags(ECombatFlags Mask) const
+{
+	// Branch-free loop over 16-bit words - vectorised by the compiler
+	const uint16* Words = reinterpret_cast<const uint16*>(Flags.GetData());
+	const uint16 MaskBits = (uint16)Mask;
+	const int32 Num = Flags.Num();
+
+	int32 Count = 0;
+	for (int32 Index = 0; Index < Num; ++Index)
+		Count += (Words[Index] & MaskBits) != 0;
+	return Count;
+}
+
+void UCombatantRegistry::GatherWithAllFlags(ECombatFlags Mask, TArray<ACombatant*>& OutCombatants) const
+{
+	if (Mask == ECombatFlags::None)
+		return;
+
+	const uint16* Words = reinterpret_cast<const uint16*>(Flags.GetData());
+	const uint16 MaskBits = (uint16)Mask;
+	const int32 Num = Flags.Num();
+
+	for (int32 Index = 0; Index < Num; ++Index)
+	{
+		if ((Words[Index] & MaskBits) == MaskBits)
+			OutCombatants.Add(Combatants[Index]);
+	}
+}
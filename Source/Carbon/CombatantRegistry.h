@@ -0,0 +1,62 @@
+// Sam Smith
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Combatant.h"
+#include "CombatantRegistry.generated.h"
+
+/**
+ * Every live combatant in the world, with their packed combat state mirrored into one
+ * contiguous array (structure of arrays) so systems can scan all of them without
+ * touching the actors, e.g. "every combatant whose attack is currently damaging".
+ * Also the handle table: FCombatantHandle resolves through the slot's generation.
+ */
+UCLASS()
+class CARBON_API UCombatantRegistry : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/** Returns the combatant's slot */
+	int32 Register(ACombatant* Combatant);
+
+	void Unregister(int32 Slot);
+
+	void SetFlags(int32 Slot, ECombatFlags NewFlags) { Flags[Slot] = NewFlags; }
+
+	ACombatant* GetCombatant(int32 Slot) const { return Combatants[Slot]; }
+
+	FCombatantHandle GetHandle(int32 Slot) const { return FCombatantHandle(Slot, Generations[Slot]); }
+
+	/** The combatant Handle refers to, or null if it has left since */
+	ACombatant* Resolve(FCombatantHandle Handle) const
+	{
+		const int32 Index = Handle.GetIndex();
+		return Handle.IsSet() && Generations.IsValidIndex(Index) && Generations[Index] == Handle.GetGeneration() ? Combatants[Index] : nullptr;
+	}
+
+	/** Number of slots (including free ones, which hold no flags and a null combatant) */
+	int32 GetNumSlots() const { return Combatants.Num(); }
+
+	/** Packed state of every slot, indexed like GetCombatant */
+	const ECombatFlags* GetFlags() const { return Flags.GetData(); }
+
+	/** Number of combatants with any of Mask set */
+	int32 CountWithAnyFlags(ECombatFlags Mask) const;
+
+	/** Appends every combatant with all of Mask set */
+	void GatherWithAllFlags(ECombatFlags Mask, TArray<ACombatant*>& OutCombatants) const;
+
+private:
+	UPROPERTY(Transient)
+	TArray<ACombatant*> Combatants;
+
+	TArray<ECombatFlags> Flags;
+
+	/** Bumped whenever a slot is freed (never 0) */
+	TArray<uint16> Generations;
+
+	TArray<int32> FreeSlots;
+};
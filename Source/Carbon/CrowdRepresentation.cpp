@@ -0,0 +1,137 @@
+// Sam Smith
+
+#include "CrowdRepresentation.h"
+#include "Carbon.h"
+#include "EnemyBase.h"
+#include "AIController.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Components/StaticMeshComponent.h"
+#include "Kismet/GameplayStatics.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+
+DECLARE_CYCLE_STAT(TEXT("Crowd Representation Update"), STAT_CrowdRepresentationUpdate, STATGROUP_Carbon);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Crowd Proxied Enemies"), STAT_CrowdProxiedEnemies, STATGROUP_Carbon);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Crowd Full Enemies"), STAT_CrowdFullEnemies, STATGROUP_Carbon);
+
+ACrowdRepresentation::ACrowdRepresentation()
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	BodyInstances = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("BodyInstances"));
+	RootComponent = BodyInstances;
+	BodyInstances->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	BodyInstances->NumCustomDataFloats = 2;
+
+	WeaponInstances = CreateDefaultSubobject<UInstancedStaticMeshComponent>(TEXT("WeaponInstances"));
+	WeaponInstances->SetupAttachment(RootComponent);
+	WeaponInstances->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+
+	ProxyDistance = 3000.0f;
+	ProxyHysteresis = 300.0f;
+	UpdateInterval = 0.25f;
+}
+
+void ACrowdRepresentation::BeginPlay()
+{
+	Super::BeginPlay();
+
+	SetActorTickInterval(UpdateInterval);
+
+	for (TActorIterator<AEnemyBase> It(GetWorld()); It; ++It)
+		Enemies.Add(*It);
+
+	ActorSpawnedHandle = GetWorld()->AddOnActorSpawnedHandler(FOnActorSpawned::FDelegate::CreateUObject(this, &ACrowdRepresentation::OnActorSpawned));
+}
+
+void ACrowdRepresentation::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	GetWorld()->RemoveOnActorSpawnedHandler(ActorSpawnedHandle);
+
+	// Give everything back its full representation
+	for (int32 Index = ProxiedEnemies.Num() - 1; Index >= 0; --Index)
+		RemoveProxy(Index);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ACrowdRepresentation::OnActorSpawned(AActor* Actor)
+{
+	// Pooled enemies are tracked too (they are only parked after spawning, and proxied again
+	// once taken from the pool) - ShouldBeProxy skips them while parked
+	if (AEnemyBase* Enemy = Cast<AEnemyBase>(Actor))
+		Enemies.Add(Enemy);
+}
+
+void ACrowdRepresentation::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_CrowdRepresentationUpdate);
+
+	Super::Tick(DeltaTime);
+
+	APawn* Player = UGameplayStatics::GetPlayerPawn(this, 0);
+	if (!Player)
+		return;
+	FVector PlayerLocation = Player->GetActorLocation();
+
+	// Swap proxies back (destroyed enemies are nulled by GC and just lose their instance)
+	for (int32 Index = ProxiedEnemies.Num() - 1; Index >= 0; --Index)
+	{
+		AEnemyBase* Enemy = ProxiedEnemies[Index];
+		if (!Enemy || !ShouldBeProxy(Enemy, PlayerLocation, true))
+			RemoveProxy(Index);
+	}
+
+	// Swap far enemies out
+	Enemies.RemoveAllSwap([](AEnemyBase* Enemy) { return Enemy == nullptr; });
+	for (AEnemyBase* Enemy : Enemies)
+	{
+		if (!Enemy->IsCrowdProxy() && ShouldBeProxy(Enemy, PlayerLocation, false))
+			AddProxy(Enemy);
+	}
+
+	SET_DWORD_STAT(STAT_CrowdProxiedEnemies, ProxiedEnemies.Num());
+	SET_DWORD_STAT(STAT_CrowdFullEnemies, Enemies.Num() - ProxiedEnemies.Num());
+}
+
+bool ACrowdRepresentation::ShouldBeProxy(const AEnemyBase* Enemy, const FVector& PlayerLocation, bool IsProxy) const
+{
+	// Parked enemies are hidden already - an instance would draw them back
+	if (Enemy->IsPooled())
+		return false;
+
+	if (Enemy->ActiveState != State::IDLE && Enemy->ActiveState != State::CHASE_FAR)
+		return false;
+
+	// Proxies don't move - CHASE_FAR squad waiters walking to their hold range stay full actors
+	const AAIController* AIController = Cast<AAIController>(Enemy->GetController());
+	if (AIController && AIController->IsFollowingAPath())
+		return false;
+
+	// Hysteresis stops enemies on the boundary from swapping every update
+	float Threshold = IsProxy ? ProxyDistance - ProxyHysteresis : ProxyDistance;
+	return FVector::DistSquared(Enemy->GetActorLocation(), PlayerLocation) > FMath::Square(Threshold);
+}
+
+void ACrowdRepresentation::AddProxy(AEnemyBase* Enemy)
+{
+	// Only enemies standing still are proxied, so their instance transform is captured once
+	int32 Index = BodyInstances->AddInstanceWorldSpace(Enemy->GetMesh()->GetComponentTransform());
+	BodyInstances->SetCustomDataValue(Index, AnimationRowDataIndex, 0.0f);
+	BodyInstances->SetCustomDataValue(Index, AnimationStartDataIndex, GetWorld()->GetTimeSeconds(), true);
+	WeaponInstances->AddInstanceWorldSpace(Enemy->GetWeapon()->GetComponentTransform());
+
+	ProxiedEnemies.Add(Enemy);
+	Enemy->SetCrowdProxy(true);
+}
+
+void ACrowdRepresentation::RemoveProxy(int32 Index)
+{
+	// RemoveInstance shifts later instances down, exactly like RemoveAt
+	BodyInstances->RemoveInstance(Index);
+	WeaponInstances->RemoveInstance(Index);
+
+	if (AEnemyBase* Enemy = ProxiedEnemies[Index])
+		Enemy->SetCrowdProxy(false);
+	ProxiedEnemies.RemoveAt(Index);
+}
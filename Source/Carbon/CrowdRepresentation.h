@@ -0,0 +1,75 @@
+// Sam Smith
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "CrowdRepresentation.generated.h"
+
+class AEnemyBase;
+class UInstancedStaticMeshComponent;
+
+/**
+ * Cheap representation tier for distant, unengaged enemies.
+ * Enemies that are IDLE or CHASE_FAR, not walking anywhere and far from the player are hidden
+ * and drawn as instances instead (body mesh with a vertex-animation material, plus their weapon).
+ * They swap back to their full actor as soon as they come close, leave those states or are
+ * given a move.
+ * Place one in the level.
+ */
+UCLASS()
+class CARBON_API ACrowdRepresentation : public AActor
+{
+	GENERATED_BODY()
+
+	/** Body instances - the material is expected to play back baked vertex animation */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Crowd", meta = (AllowPrivateAccess = "true"))
+	UInstancedStaticMeshComponent* BodyInstances;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Crowd", meta = (AllowPrivateAccess = "true"))
+	UInstancedStaticMeshComponent* WeaponInstances;
+
+public:
+	ACrowdRepresentation();
+
+	/** Enemies further than this from the player are drawn as instances */
+	UPROPERTY(EditAnywhere, Category = "Crowd")
+	float ProxyDistance;
+
+	/** Proxied enemies only swap back once closer than ProxyDistance minus this */
+	UPROPERTY(EditAnywhere, Category = "Crowd")
+	float ProxyHysteresis;
+
+	/** Seconds between representation updates */
+	UPROPERTY(EditAnywhere, Category = "Crowd")
+	float UpdateInterval;
+
+	/** Custom data index holding the vertex animation row (0 = idle) */
+	static const int32 AnimationRowDataIndex = 0;
+	/** Custom data index holding the world time the animation started at */
+	static const int32 AnimationStartDataIndex = 1;
+
+	virtual void Tick(float DeltaTime) override;
+
+protected:
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	void OnActorSpawned(AActor* Actor);
+
+	bool ShouldBeProxy(const AEnemyBase* Enemy, const FVector& PlayerLocation, bool IsProxy) const;
+
+	void AddProxy(AEnemyBase* Enemy);
+
+	void RemoveProxy(int32 Index);
+
+	UPROPERTY(Transient)
+	TArray<AEnemyBase*> Enemies;
+
+	/** Proxied enemies - index matches their instance index in both ISM components */
+	UPROPERTY(Transient)
+	TArray<AEnemyBase*> ProxiedEnemies;
+
+	FDelegateHandle ActorSpawnedHandle;
+};
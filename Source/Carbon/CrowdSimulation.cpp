@@ -0,0 +1,279 @@
+// Sam Smith
+
+#include "CrowdSimulation.h"
+#include "Carbon.h"
+#include "CombatArchetype.h"
+#include "CombatantRegistry.h"
+#include "EnemyKnight.h"
+#include "UtilityAI.h"
+#include "Engine/World.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "Kismet/GameplayStatics.h"
+
+DECLARE_CYCLE_STAT(TEXT("Crowd Simulation"), STAT_CrowdSimulation, STATGROUP_Carbon);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Crowd Entities"), STAT_CrowdEntities, STATGROUP_Carbon);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Crowd Promotions"), STAT_CrowdPromotions, STATGROUP_Carbon);
+
+static TAutoConsoleVariable<float> CVarCrowdPromotionDistance(
+	TEXT("carbon.Crowd.PromotionDistance"), 1000.0f,
+	TEXT("Entities closer than this to their target are promoted to full enemy actors (keep it below the archetypes' AggroRange, or entities never leave IDLE)."));
+
+static TAutoConsoleVariable<float> CVarCrowdAttackDuration(
+	TEXT("carbon.Crowd.AttackDuration"), 1.5f,
+	TEXT("Seconds an entity spends in ATTACK (stands in for the attack montage)."));
+
+static FAutoConsoleCommandWithWorldAndArgs CrowdSpawnCommand(
+	TEXT("carbon.Crowd.Spawn"),
+	TEXT("carbon.Crowd.Spawn <Count> [Radius] - add Count knight entities around the player"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		APawn* Player = UGameplayStatics::GetPlayerPawn(World, 0);
+		UCrowdSimulationSubsystem* Crowd = World ? World->GetSubsystem<UCrowdSimulationSubsystem>() : nullptr;
+		if (!Player || !Crowd)
+			return;
+
+		int32 Count = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000;
+		float Radius = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 20000.0f;
+		FRandomStream Random(Count);
+		for (int32 Index = 0; Index < Count; ++Index)
+		{
+			FVector Offset = Random.GetUnitVector().GetSafeNormal2D() * Random.FRandRange(CVarCrowdPromotionDistance.GetValueOnGameThread(), Radius);
+			Crowd->AddEntity(AEnemyKnight::StaticClass(), Player->GetActorLocation() + Offset, Random.FRandRange(-180.0f, 180.0f), Player);
+		}
+	}));
+
+int32 UCrowdSimulationSubsystem::AddEntity(TSubclassOf<AEnemyBase> ActorClass, const FVector& Location, float Yaw, AActor* Target)
+{
+	int32 TargetIndex = Targets.AddUnique(ACombatant::GetHandleOf(Target));
+
+	ArchetypeIndices.Add(FindOrAddArchetype(ActorClass));
+	Locations.Add(Location);
+	Yaws.Add(Yaw);
+	States.Add(State::IDLE);
+	TargetIndices.Add(TargetIndex);
+	ActionEndTimes.Add(0.0f);
+	LongAttackTimes.Add(-BIG_NUMBER);
+	return TargetDistances.Add(BIG_NUMBER);
+}
+
+int32 UCrowdSimulationSubsystem::FindOrAddArchetype(TSubclassOf<AEnemyBase> ActorClass)
+{
+	int32 Index = Archetypes.IndexOfByPredicate([ActorClass](const FCrowdArchetype& Archetype) { return Archetype.ActorClass == ActorClass; });
+	if (Index != INDEX_NONE)
+		return Index;
+
+	// Everything entities need is read once from the class defaults
+	const AEnemyBase* Defaults = ActorClass->GetDefaultObject<AEnemyBase>();
+	UCombatArchetypeSubsystem* ArchetypeSubsystem = GetWorld()->GetSubsystem<UCombatArchetypeSubsystem>();
+	FCrowdArchetype Archetype;
+	Archetype.ActorClass = ActorClass;
+	Archetype.Archetype = Defaults->GetArchetype() ? Defaults->GetArchetype() : ArchetypeSubsystem->GetLegacyArchetype(Defaults);
+	Archetype.TuningIndex = ArchetypeSubsystem->GetTuningIndex(Archetype.Archetype);
+	// Held while entities exist, so the montages are in by the time one is promoted
+	ArchetypeSubsystem->Acquire(Archetype.Archetype);
+	Archetype.Actions = GetWorld()->GetSubsystem<UUtilitySubsystem>()->GetActions(Archetype.TuningIndex, Archetype.Archetype);
+	Archetype.MoveSpeed = Defaults->GetCharacterMovement()->MaxWalkSpeed;
+	Archetype.RotationSmoothing = Defaults->GetRotationSmoothing();
+	if (const AEnemyKnight* Knight = Cast<AEnemyKnight>(Defaults))
+	{
+		Archetype.HasLongAttack = true;
+		Archetype.LongAttackCooldown = Knight->GetLongAttackCooldown();
+	}
+	return Archetypes.Add(Archetype);
+}
+
+void UCrowdSimulationSubsystem::RemoveEntity(int32 Index)
+{
+	Locations.RemoveAtSwap(Index, 1, false);
+	Yaws.RemoveAtSwap(Index, 1, false);
+	States.RemoveAtSwap(Index, 1, false);
+	TargetIndices.RemoveAtSwap(Index, 1, false);
+	ArchetypeIndices.RemoveAtSwap(Index, 1, false);
+	ActionEndTimes.RemoveAtSwap(Index, 1, false);
+	LongAttackTimes.RemoveAtSwap(Index, 1, false);
+	TargetDistances.RemoveAtSwap(Index, 1, false);
+}
+
+void UCrowdSimulationSubsystem::GetChaserClasses(TArray<CombatCore::FChaserClass, TInlineAllocator<8>>& OutClasses) const
+{
+	const FCombatTuningRow* Tuning = GetWorld()->GetSubsystem<UCombatArchetypeSubsystem>()->GetTuningTable();
+
+	for (const FCrowdArchetype& Archetype : Archetypes)
+	{
+		CombatCore::FChaserClass& Class = OutClasses.AddDefaulted_GetRef();
+		Class.Tuning = Tuning[Archetype.TuningIndex].Tuning.GetCoreTuning();
+		Class.Actions = &Archetype.Actions;
+		Class.MoveSpeed = Archetype.MoveSpeed;
+		Class.RotationSmoothing = Archetype.RotationSmoothing;
+		Class.HasLongAttack = Archetype.HasLongAttack;
+		Class.LongAttackCooldown = Archetype.LongAttackCooldown;
+	}
+}
+
+CombatCore::FChaser UCrowdSimulationSubsystem::GetChaser(int32 Index) const
+{
+	CombatCore::FChaser Chaser;
+	Chaser.Location = { Locations[Index].X, Locations[Index].Y, Locations[Index].Z };
+	Chaser.Yaw = Yaws[Index];
+	Chaser.LongAttackTime = LongAttackTimes[Index];
+	Chaser.Role = CombatCore::ESquadRole::None;
+	Chaser.SquadOffset = { 0.0f, 0.0f, 0.0f };
+	return Chaser;
+}
+
+void UCrowdSimulationSubsystem::SetChaser(int32 Index, const CombatCore::FChaser& Chaser)
+{
+	Locations[Index] = FVector(Chaser.Location.X, Chaser.Location.Y, Chaser.Location.Z);
+	Yaws[Index] = Chaser.Yaw;
+	LongAttackTimes[Index] = Chaser.LongAttackTime;
+}
+
+void UCrowdSimulationSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_CrowdSimulation);
+
+	float Now = GetWorld()->GetTimeSeconds();
+
+	ProcessTargets();
+	ProcessIdle();
+	ProcessChaseFar(DeltaTime);
+	ProcessChaseClose(DeltaTime, Now);
+	ProcessTimers(Now);
+	ProcessPromotion();
+
+	SET_DWORD_STAT(STAT_CrowdEntities, Locations.Num());
+}
+
+void UCrowdSimulationSubsystem::ProcessTargets()
+{
+	// Resolve targets once, everything below works on plain arrays
+	UCombatantRegistry* Registry = GetWorld()->GetSubsystem<UCombatantRegistry>();
+	const ECombatFlags* Flags = Registry->GetFlags();
+	ChaseTargets.SetNumUninitialized(Targets.Num(), false);
+	for (int32 Index = 0; Index < Targets.Num(); ++Index)
+	{
+		ACombatant* Target = Registry->Resolve(Targets[Index]);
+		const FVector Location = Target ? Target->GetActorLocation() : FVector(BIG_NUMBER);
+		CombatCore::FChaseTarget& ChaseTarget = ChaseTargets[Index];
+		ChaseTarget.Location = { Location.X, Location.Y, Location.Z };
+		ChaseTarget.Yaw = Target ? Target->GetActorRotation().Yaw : 0.0f;
+		ChaseTarget.Rolling = Target && EnumHasAnyFlags(Flags[Targets[Index].GetIndex()], ECombatFlags::Rolling);
+		ChaseTarget.Attacking = Target && EnumHasAnyFlags(Flags[Targets[Index].GetIndex()], ECombatFlags::Attacking);
+	}
+
+	for (int32 Index = 0; Index < Locations.Num(); ++Index)
+	{
+		const CombatCore::FVec3& TargetLocation = ChaseTargets[TargetIndices[Index]].Location;
+		TargetDistances[Index] = FVector::Dist(FVector(TargetLocation.X, TargetLocation.Y, TargetLocation.Z), Locations[Index]);
+	}
+}
+
+void UCrowdSimulationSubsystem::ProcessIdle()
+{
+	const FCombatTuningRow* Tuning = GetWorld()->GetSubsystem<UCombatArchetypeSubsystem>()->GetTuningTable();
+
+	for (int32 Index = 0; Index < States.Num(); ++Index)
+	{
+		if (States[Index] == State::IDLE)
+			States[Index] = (State)CombatCore::IdleTransition(TargetDistances[Index], Tuning[Archetypes[ArchetypeIndices[Index]].TuningIndex].Tuning.GetCoreTuning(), true);
+	}
+}
+
+void UCrowdSimulationSubsystem::ProcessChaseFar(float DeltaTime)
+{
+	TArray<CombatCore::FChaserClass, TInlineAllocator<8>> Classes;
+	GetChaserClasses(Classes);
+
+	for (int32 Index = 0; Index < States.Num(); ++Index)
+	{
+		if (States[Index] != State::CHASE_FAR)
+			continue;
+
+		CombatCore::FChaser Chaser = GetChaser(Index);
+		States[Index] = (State)CombatCore::StepChaseFar(Chaser, Classes[ArchetypeIndices[Index]], ChaseTargets[TargetIndices[Index]], DeltaTime);
+		SetChaser(Index, Chaser);
+	}
+}
+
+void UCrowdSimulationSubsystem::ProcessChaseClose(float DeltaTime, float Now)
+{
+	TArray<CombatCore::FChaserClass, TInlineAllocator<8>> Classes;
+	GetChaserClasses(Classes);
+	const float AttackDuration = CVarCrowdAttackDuration.GetValueOnGameThread();
+
+	for (int32 Index = 0; Index < States.Num(); ++Index)
+	{
+		if (States[Index] != State::CHASE_CLOSE)
+			continue;
+
+		// Same step as the fight simulator: utility scored melee, long attack or close in.
+		// Entities have no collision to trace against - line of sight is assumed
+		CombatCore::FChaser Chaser = GetChaser(Index);
+		States[Index] = (State)CombatCore::StepChaseClose(Chaser, Classes[ArchetypeIndices[Index]], ChaseTargets[TargetIndices[Index]], Now, DeltaTime, true);
+		SetChaser(Index, Chaser);
+
+		if (States[Index] == State::ATTACK)
+			ActionEndTimes[Index] = Now + AttackDuration;
+	}
+}
+
+void UCrowdSimulationSubsystem::ProcessTimers(float Now)
+{
+	for (int32 Index = 0; Index < States.Num(); ++Index)
+	{
+		if (States[Index] == State::ATTACK && Now >= ActionEndTimes[Index])
+			States[Index] = State::CHASE_CLOSE;
+	}
+}
+
+void UCrowdSimulationSubsystem::ProcessPromotion()
+{
+	const float PromotionDistance = CVarCrowdPromotionDistance.GetValueOnGameThread();
+	UCombatArchetypeSubsystem* ArchetypeSubsystem = GetWorld()->GetSubsystem<UCombatArchetypeSubsystem>();
+
+	for (int32 Index = Locations.Num() - 1; Index >= 0; --Index)
+	{
+		if (TargetDistances[Index] > PromotionDistance)
+			continue;
+
+		// An actor without its montages can't fight - keep simulating the entity until they stream in
+		const UCombatArchetype* Archetype = Archetypes[ArchetypeIndices[Index]].Archetype;
+		if (Archetype && !ArchetypeSubsystem->IsLoaded(Archetype))
+			continue;
+
+		FActorSpawnParameters Params;
+		Params.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+		AEnemyBase* Enemy = GetWorld()->SpawnActor<AEnemyBase>(Archetypes[ArchetypeIndices[Index]].ActorClass,
+			Locations[Index], FRotator(0.0f, Yaws[Index], 0.0f), Params);
+		if (Enemy)
+		{
+			Enemy->SetTarget(GetWorld()->GetSubsystem<UCombatantRegistry>()->Resolve(Targets[TargetIndices[Index]]));
+			Enemy->PromoteFromCrowd(States[Index]);
+			INC_DWORD_STAT(STAT_CrowdPromotions);
+		}
+
+		RemoveEntity(Index);
+	}
+}
+
+void UCrowdSimulationSubsystem::Deinitialize()
+{
+	if (UCombatArchetypeSubsystem* ArchetypeSubsystem = GetWorld()->GetSubsystem<UCombatArchetypeSubsystem>())
+	{
+		for (const FCrowdArchetype& Archetype : Archetypes)
+			ArchetypeSubsystem->Release(Archetype.Archetype);
+	}
+	Archetypes.Empty();
+
+	Super::Deinitialize();
+}
+
+ETickableTickType UCrowdSimulationSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Always;
+}
+
+TStatId UCrowdSimulationSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UCrowdSimulationSubsystem, STATGROUP_Tickables);
+}
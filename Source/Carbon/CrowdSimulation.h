@@ -0,0 +1,90 @@
+// Sam Smith
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "EnemyBase.h"
+#include "CrowdSimulation.generated.h"
+
+/**
+ * Entity path for very large crowds.
+ * Enemies far from the player exist only as rows in structure-of-arrays fragments
+ * (transform, FSM state, target, timers, archetype) and are stepped by one processor
+ * per state, through the same CombatCore steps (and archetype action sets) the fight
+ * simulator runs. Entities that come within carbon.Crowd.PromotionDistance of their target
+ * are promoted to full enemy actors, once their archetype has streamed in. That is inside
+ * ChaseFarRange's reach of a fight, so squads only ever hold actors and entities fight
+ * alone (squad role NONE).
+ */
+UCLASS()
+class CARBON_API UCrowdSimulationSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	/** Add an entity that will become an ActorClass enemy once promoted. Returns its index. */
+	int32 AddEntity(TSubclassOf<AEnemyBase> ActorClass, const FVector& Location, float Yaw, AActor* Target);
+
+	int32 GetNumEntities() const { return Locations.Num(); }
+
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+private:
+	/** Per-class parameters shared by all of its entities */
+	struct FCrowdArchetype
+	{
+		TSubclassOf<AEnemyBase> ActorClass;
+		UCombatArchetype* Archetype = nullptr;
+		int32 TuningIndex = 0;
+		CombatCore::FUtilityActions Actions;
+		float MoveSpeed = 0.0f;
+		float RotationSmoothing = 0.0f;
+		bool HasLongAttack = false;
+		float LongAttackCooldown = 0.0f;
+	};
+
+	int32 FindOrAddArchetype(TSubclassOf<AEnemyBase> ActorClass);
+
+	void RemoveEntity(int32 Index);
+
+	/** Step inputs for every archetype, indexed like Archetypes (tuning read fresh from the table) */
+	void GetChaserClasses(TArray<CombatCore::FChaserClass, TInlineAllocator<8>>& OutClasses) const;
+
+	/** Entity Index as CombatCore steps it (no squad role) */
+	CombatCore::FChaser GetChaser(int32 Index) const;
+
+	void SetChaser(int32 Index, const CombatCore::FChaser& Chaser);
+
+	// Processors
+	void ProcessTargets();
+	void ProcessIdle();
+	void ProcessChaseFar(float DeltaTime);
+	void ProcessChaseClose(float DeltaTime, float Now);
+	void ProcessTimers(float Now);
+	void ProcessPromotion();
+
+	TArray<FCrowdArchetype> Archetypes;
+
+	TArray<FCombatantHandle> Targets;
+
+	/** Location, facing and state of each target (from ProcessTargets), indexed like Targets */
+	TArray<CombatCore::FChaseTarget> ChaseTargets;
+
+	// Fragments - one row per entity
+	TArray<FVector> Locations;
+	TArray<float> Yaws;
+	TArray<State> States;
+	TArray<int32> TargetIndices;
+	TArray<int32> ArchetypeIndices;
+	TArray<float> ActionEndTimes;		// End of the current attack
+	TArray<float> LongAttackTimes;		// Last long attack (knights)
+	TArray<float> TargetDistances;		// From ProcessTargets
+};
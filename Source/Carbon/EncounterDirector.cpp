@@ -0,0 +1,293 @@
+// Sam Smith
+
+#include "EncounterDirector.h"
+#include "Carbon.h"
+#include "CombatantRegistry.h"
+#include "EnemyBase.h"
+#include "EnemyPool.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "Kismet/GameplayStatics.h"
+
+DECLARE_CYCLE_STAT(TEXT("Encounter Director"), STAT_EncounterDirector, STATGROUP_Carbon);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Encounter Spawns"), STAT_EncounterSpawns, STATGROUP_Carbon);
+
+static TAutoConsoleVariable<int32> CVarEncounterSpawnsPerFrame(
+	TEXT("carbon.Encounter.SpawnsPerFrame"), 2,
+	TEXT("Most enemies each encounter director places per frame."));
+
+/** Wave length carbon.Encounter.Start uses when neither its arguments nor the config give one */
+static const float DefaultBenchmarkWaveSeconds = 30.0f;
+
+namespace
+{
+	AEncounterDirector* FindDirector(UWorld* World)
+	{
+		for (TActorIterator<AEncounterDirector> It(World); It; ++It)
+		{
+			if (It->Config)
+				return *It;
+		}
+		return nullptr;
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs EncounterStartCommand(
+	TEXT("carbon.Encounter.Start"),
+	TEXT("carbon.Encounter.Start [EnemiesPerWave] [Waves] [Seed] [WaveSeconds] [MaxAlive] - run the first director's encounter, ")
+	TEXT("optionally resized to fixed-pace waves of EnemiesPerWave (spawned as fast as the frame budget allows, ")
+	TEXT("at most MaxAlive at once), each lasting at most WaveSeconds"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		AEncounterDirector* Director = World ? FindDirector(World) : nullptr;
+		if (!Director || Director->Config->Waves.Num() == 0)
+		{
+			UE_LOG(LogCarbon, Warning, TEXT("carbon.Encounter.Start: no encounter director with waves in this world"));
+			return;
+		}
+
+		UEncounterConfig* Source = Director->Config;
+		UEncounterConfig* EncounterConfig = Source;
+		if (Args.Num() > 0)
+		{
+			EncounterConfig = DuplicateObject(Source, Director);
+			EncounterConfig->Adaptive = false;
+			EncounterConfig->Seed = Args.Num() > 2 ? FCString::Atoi(*Args[2]) : Source->Seed;
+
+			int32 PerWave = FMath::Max(1, FCString::Atoi(*Args[0]));
+			int32 NumWaves = Args.Num() > 1 ? FMath::Max(1, FCString::Atoi(*Args[1])) : Source->Waves.Num();
+			float WaveSeconds = Args.Num() > 3 ? FCString::Atof(*Args[3]) : 0.0f;
+			int32 MaxAlive = Args.Num() > 4 ? FMath::Clamp(FCString::Atoi(*Args[4]), 1, PerWave) : PerWave;
+			EncounterConfig->Waves.Reset();
+			for (int32 Index = 0; Index < NumWaves; ++Index)
+			{
+				FEncounterWave Wave = Source->Waves[Index % Source->Waves.Num()];
+				Wave.Count = PerWave;
+				Wave.MaxAlive = MaxAlive;
+				Wave.SpawnInterval = 0.0f;
+				// Nothing kills enemies in a benchmark, so every wave has to time out
+				if (WaveSeconds > 0.0f)
+					Wave.Duration = WaveSeconds;
+				else if (Wave.Duration <= 0.0f)
+					Wave.Duration = DefaultBenchmarkWaveSeconds;
+				EncounterConfig->Waves.Add(Wave);
+			}
+		}
+
+		Director->StartEncounter(EncounterConfig, UGameplayStatics::GetPlayerPawn(World, 0));
+	}));
+
+static FAutoConsoleCommandWithWorld EncounterStopCommand(
+	TEXT("carbon.Encounter.Stop"),
+	TEXT("Stop the first director's encounter and return its enemies to the pool"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (AEncounterDirector* Director = World ? FindDirector(World) : nullptr)
+			Director->StopEncounter();
+	}));
+
+AEncounterDirector::AEncounterDirector()
+{
+	PrimaryActorTick.bCanEverTick = true;
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+
+	Config = nullptr;
+	StartOnBeginPlay = false;
+	ActiveConfig = nullptr;
+	WaveIndex = INDEX_NONE;
+	SpawnedInWave = 0;
+	WaveStartTime = 0.0f;
+	NextSpawnTime = 0.0f;
+	Intensity = 1.0f;
+	DamageTakenRate = 0.0f;
+	HitRate = 0.0f;
+	PendingDamageTaken = 0.0f;
+	PendingHits = 0;
+}
+
+void AEncounterDirector::BeginPlay()
+{
+	Super::BeginPlay();
+
+	DamagedHandle = ACombatant::OnAnyDamaged.AddUObject(this, &AEncounterDirector::OnCombatantDamaged);
+
+	if (StartOnBeginPlay)
+		StartEncounter(Config, UGameplayStatics::GetPlayerPawn(GetWorld(), 0));
+}
+
+void AEncounterDirector::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	ACombatant::OnAnyDamaged.Remove(DamagedHandle);
+
+	// When the whole world goes away there is nothing to hand enemies back to
+	if (EndPlayReason == EEndPlayReason::Destroyed || EndPlayReason == EEndPlayReason::RemovedFromWorld)
+		StopEncounter();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AEncounterDirector::StartEncounter(UEncounterConfig* NewConfig, AActor* NewTarget)
+{
+	StopEncounter();
+	if (!NewConfig || NewConfig->Waves.Num() == 0)
+		return;
+
+	ActiveConfig = NewConfig;
+	Target = NewTarget;
+	Stream.Initialize(NewConfig->Seed);
+	Intensity = FMath::Clamp(1.0f, NewConfig->MinIntensity, NewConfig->MaxIntensity);
+	DamageTakenRate = 0.0f;
+	HitRate = 0.0f;
+	PendingDamageTaken = 0.0f;
+	PendingHits = 0;
+
+	UE_LOG(LogCarbon, Log, TEXT("%s starting %s: %d waves, seed %d"), *GetName(), *NewConfig->GetName(), NewConfig->Waves.Num(), NewConfig->Seed);
+	StartWave(0);
+}
+
+void AEncounterDirector::StopEncounter()
+{
+	if (UEnemyPoolSubsystem* Pool = GetWorld()->GetSubsystem<UEnemyPoolSubsystem>())
+	{
+		UCombatantRegistry* Registry = GetWorld()->GetSubsystem<UCombatantRegistry>();
+		for (FCombatantHandle Handle : Alive)
+			Pool->Release(Cast<AEnemyBase>(Registry->Resolve(Handle)));
+	}
+	Alive.Reset();
+
+	ActiveConfig = nullptr;
+	WaveIndex = INDEX_NONE;
+}
+
+void AEncounterDirector::StartWave(int32 Index)
+{
+	const FEncounterWave& Wave = ActiveConfig->Waves[Index];
+	WaveIndex = Index;
+	SpawnedInWave = 0;
+	WaveStartTime = GetWorld()->GetTimeSeconds() + Wave.Delay;
+	NextSpawnTime = WaveStartTime;
+
+	// This wave's enemies are built during the delay, the next wave's during this fight
+	PrewarmWave(Index);
+	PrewarmWave(Index + 1);
+}
+
+void AEncounterDirector::PrewarmWave(int32 Index)
+{
+	if (!ActiveConfig->Waves.IsValidIndex(Index))
+		return;
+
+	const FEncounterWave& Wave = ActiveConfig->Waves[Index];
+	UEnemyPoolSubsystem* Pool = GetWorld()->GetSubsystem<UEnemyPoolSubsystem>();
+	for (TSubclassOf<AEnemyBase> Class : Wave.EnemyClasses)
+		Pool->Prewarm(Class, FMath::Min(Wave.Count, Wave.MaxAlive), GetActorLocation());
+}
+
+void AEncounterDirector::SpawnEnemy(const FEncounterWave& Wave)
+{
+	++SpawnedInWave;
+	if (Wave.EnemyClasses.Num() == 0)
+		return;
+
+	TSubclassOf<AEnemyBase> Class = Wave.EnemyClasses[Stream.RandRange(0, Wave.EnemyClasses.Num() - 1)];
+	AActor* Point = SpawnPoints.Num() > 0 ? SpawnPoints[Stream.RandRange(0, SpawnPoints.Num() - 1)] : nullptr;
+	if (!Point)
+		Point = this;
+
+	// Spread around the point, uniformly over the disc
+	float Angle = Stream.FRandRange(0.0f, 2.0f * PI);
+	float Radius = ActiveConfig->SpawnRadius * FMath::Sqrt(Stream.FRand());
+	FVector Location = Point->GetActorLocation() + FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0.0f) * Radius;
+
+	AEnemyBase* Enemy = GetWorld()->GetSubsystem<UEnemyPoolSubsystem>()->Acquire(Class,
+		FTransform(FRotator(0.0f, Point->GetActorRotation().Yaw, 0.0f), Location), Target.Get());
+	if (Enemy)
+	{
+		Alive.Add(Enemy->GetHandle());
+		INC_DWORD_STAT(STAT_EncounterSpawns);
+	}
+}
+
+void AEncounterDirector::OnCombatantDamaged(ACombatant* Victim, AActor* Causer, float Damage)
+{
+	AActor* EncounterTarget = Target.Get();
+	if (!ActiveConfig || !EncounterTarget)
+		return;
+
+	if (Victim == EncounterTarget)
+		PendingDamageTaken += Damage;
+	else if (Causer == EncounterTarget)
+		++PendingHits;
+}
+
+void AEncounterDirector::UpdateIntensity(float DeltaTime)
+{
+	// Exponential moving averages - every event adds 1/Window, decaying over Window seconds
+	const float Window = FMath::Max(ActiveConfig->RateWindow, 0.1f);
+	const float Decay = FMath::Exp(-DeltaTime / Window);
+	DamageTakenRate = DamageTakenRate * Decay + PendingDamageTaken / Window;
+	HitRate = HitRate * Decay + PendingHits / Window;
+	PendingDamageTaken = 0.0f;
+	PendingHits = 0;
+
+	if (!ActiveConfig->Adaptive)
+		return;
+
+	// Positive while the player hits more and gets hurt less than targeted
+	float Ahead = HitRate / FMath::Max(ActiveConfig->TargetHitsPerSecond, KINDA_SMALL_NUMBER)
+		- DamageTakenRate / FMath::Max(ActiveConfig->TargetDamageTakenPerSecond, KINDA_SMALL_NUMBER);
+	Intensity = FMath::Clamp(Intensity + Ahead * ActiveConfig->IntensityAdjustRate * DeltaTime, ActiveConfig->MinIntensity, ActiveConfig->MaxIntensity);
+}
+
+void AEncounterDirector::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (!ActiveConfig)
+		return;
+
+	SCOPE_CYCLE_COUNTER(STAT_EncounterDirector);
+
+	const float Now = GetWorld()->GetTimeSeconds();
+
+	// Enemies that were destroyed, returned to the pool or killed no longer count
+	UCombatantRegistry* Registry = GetWorld()->GetSubsystem<UCombatantRegistry>();
+	Alive.RemoveAllSwap([Registry](FCombatantHandle Handle)
+	{
+		AEnemyBase* Enemy = Cast<AEnemyBase>(Registry->Resolve(Handle));
+		return !Enemy || Enemy->IsPooled() || Enemy->ActiveState == State::DEAD;
+	});
+
+	UpdateIntensity(DeltaTime);
+
+	const FEncounterWave& Wave = ActiveConfig->Waves[WaveIndex];
+	if (Now < WaveStartTime)
+		return;
+
+	// The timeout holds whether or not the wave finished spawning - one capped by MaxAlive may
+	// never get to, as long as nothing kills its enemies
+	const bool TimedOut = Wave.Duration > 0.0f && Now >= WaveStartTime + Wave.Duration;
+	const bool Cleared = SpawnedInWave >= Wave.Count && Alive.Num() == 0;
+	if (TimedOut || Cleared)
+	{
+		if (ActiveConfig->Waves.IsValidIndex(WaveIndex + 1))
+			StartWave(WaveIndex + 1);
+		else
+		{
+			UE_LOG(LogCarbon, Log, TEXT("%s finished %s (%d enemies left)"), *GetName(), *ActiveConfig->GetName(), Alive.Num());
+			StopEncounter();
+		}
+		return;
+	}
+
+	// Construction is spread by the pool's pre-warm budget, placement by this one
+	const int32 MaxAlive = FMath::Max(1, FMath::RoundToInt(Wave.MaxAlive * Intensity));
+	for (int32 Budget = CVarEncounterSpawnsPerFrame.GetValueOnGameThread(); Budget > 0; --Budget)
+	{
+		if (SpawnedInWave >= Wave.Count || Alive.Num() >= MaxAlive || Now < NextSpawnTime)
+			break;
+
+		SpawnEnemy(Wave);
+		NextSpawnTime = Now + Wave.SpawnInterval / FMath::Max(Intensity, KINDA_SMALL_NUMBER);
+	}
+}
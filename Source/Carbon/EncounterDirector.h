@@ -0,0 +1,180 @@
+// Sam Smith
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "GameFramework/Actor.h"
+#include "Combatant.h"
+#include "EncounterDirector.generated.h"
+
+class AEnemyBase;
+
+/** One wave of an encounter */
+USTRUCT(BlueprintType)
+struct FEncounterWave
+{
+	GENERATED_BODY()
+
+	/** Each enemy's class is picked from these (with the encounter's seed) */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Wave")
+	TArray<TSubclassOf<AEnemyBase>> EnemyClasses;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Wave")
+	int32 Count = 5;
+
+	/** Most enemies of this wave alive at once (scaled by intensity) */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Wave")
+	int32 MaxAlive = 5;
+
+	/** Seconds between spawns (divided by intensity) */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Wave")
+	float SpawnInterval = 0.5f;
+
+	/** Seconds of quiet before the wave starts */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Wave")
+	float Delay = 2.0f;
+
+	/**
+	 * The next wave starts after this many seconds even if enemies are left (or still to spawn), and the last wave
+	 * ends the encounter (returning the rest to the pool). 0 = only once they are all gone
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Wave")
+	float Duration = 60.0f;
+};
+
+/** Waves and pacing of an encounter */
+UCLASS(BlueprintType)
+class CARBON_API UEncounterConfig : public UPrimaryDataAsset
+{
+	GENERATED_BODY()
+
+public:
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Encounter")
+	TArray<FEncounterWave> Waves;
+
+	/** Seeds spawn point and class picks - the same seed spawns the same encounter */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Encounter")
+	int32 Seed = 0;
+
+	/** Enemies are spread up to this far from their spawn point */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Encounter")
+	float SpawnRadius = 200.0f;
+
+	/** Scale pressure by how the player is doing (off = fixed pacing, for benchmarks) */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Pressure")
+	bool Adaptive = true;
+
+	/** Damage per second the player should be taking */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Pressure")
+	float TargetDamageTakenPerSecond = 0.5f;
+
+	/** Hits per second the player should be landing */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Pressure")
+	float TargetHitsPerSecond = 1.0f;
+
+	/** Seconds the damage taken and hit rates are averaged over */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Pressure")
+	float RateWindow = 5.0f;
+
+	/** Intensity change per second per target rate the player is ahead (or behind) */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Pressure")
+	float IntensityAdjustRate = 0.1f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Pressure")
+	float MinIntensity = 0.5f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Pressure")
+	float MaxIntensity = 2.0f;
+};
+
+/**
+ * Spawns an encounter's waves from spawn points, and assigns each enemy its target.
+ * Enemies come from UEnemyPoolSubsystem: a wave's enemies (and the next wave's) are pre-warmed
+ * when it starts, and at most carbon.Encounter.SpawnsPerFrame are taken from the pool per frame.
+ * With an adaptive config, intensity rises while the player lands hits faster and takes damage
+ * slower than the config's target rates (and falls otherwise), scaling how many enemies are
+ * alive at once and how fast they arrive.
+ * carbon.Encounter.Start [EnemiesPerWave] [Waves] [Seed] [WaveSeconds] [MaxAlive] runs a fixed-pace encounter for
+ * benchmarks (a MaxAlive below EnemiesPerWave exercises waves that only end by timing out).
+ */
+UCLASS()
+class CARBON_API AEncounterDirector : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	AEncounterDirector();
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Encounter")
+	UEncounterConfig* Config;
+
+	/** Picked from with the encounter's seed (the director itself if empty) */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Encounter")
+	TArray<AActor*> SpawnPoints;
+
+	/** Start Config against the player on BeginPlay */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Encounter")
+	bool StartOnBeginPlay;
+
+	/** Run NewConfig from its first wave, with every enemy fighting NewTarget */
+	UFUNCTION(BlueprintCallable, Category = "Encounter")
+	void StartEncounter(UEncounterConfig* NewConfig, AActor* NewTarget);
+
+	/** Stop spawning and return every enemy still alive to the pool */
+	UFUNCTION(BlueprintCallable, Category = "Encounter")
+	void StopEncounter();
+
+	UFUNCTION(BlueprintCallable, Category = "Encounter")
+	bool IsRunning() const { return ActiveConfig != nullptr; }
+
+	UFUNCTION(BlueprintCallable, Category = "Encounter")
+	float GetIntensity() const { return Intensity; }
+
+	UFUNCTION(BlueprintCallable, Category = "Encounter")
+	int32 GetNumAlive() const { return Alive.Num(); }
+
+	virtual void Tick(float DeltaTime) override;
+
+protected:
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	void StartWave(int32 Index);
+
+	/** Pre-warm the pool for wave Index (if there is one) */
+	void PrewarmWave(int32 Index);
+
+	void SpawnEnemy(const FEncounterWave& Wave);
+
+	void UpdateIntensity(float DeltaTime);
+
+	void OnCombatantDamaged(ACombatant* Victim, AActor* Causer, float Damage);
+
+	UPROPERTY(Transient)
+	UEncounterConfig* ActiveConfig;
+
+	TWeakObjectPtr<AActor> Target;
+
+	FRandomStream Stream;
+
+	int32 WaveIndex;
+	int32 SpawnedInWave;
+	float WaveStartTime;
+	float NextSpawnTime;
+
+	/** Enemies spawned by this encounter that are still around */
+	TArray<FCombatantHandle> Alive;
+
+	float Intensity;
+	float DamageTakenRate;
+	float HitRate;
+
+	/** Damage taken / hits landed by the target since the last tick */
+	float PendingDamageTaken;
+	int32 PendingHits;
+
+	FDelegateHandle DamagedHandle;
+};
@@ -6,21 +6,44 @@
 #include "Engine/World.h"
 #include "GameFramework/CharacterMovementComponent.h"
 #include "Components/StaticMeshComponent.h"
+#include "Carbon.h"
+#include "IAnimationBudgetAllocator.h"
+#include "SkeletalMeshComponentBudgeted.h"
+#include "CombatArchetype.h"
+#include "UtilityAI.h"
+#include "CombatTelemetry.h"
+#include "CombatEventLog.h"
+#include "HitFeedbackSubsystem.h"
+
+static_assert((uint8)State::DEAD == (uint8)CombatCore::EState::Dead, "State must mirror CombatCore::EState");
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Enemies Nav Walking"), STAT_EnemiesNavWalking, STATGROUP_Carbon);
 
 // Sets default values
-AEnemyBase::AEnemyBase()
+AEnemyBase::AEnemyBase(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer.SetDefaultSubobjectClass<USkeletalMeshComponentBudgeted>(ACharacter::MeshComponentName))
 {
 	// Create weapon
 	Weapon = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("Weapon"));
 	Weapon->SetupAttachment(GetMesh(), "RightHandItem");
 	Weapon->SetCollisionResponseToAllChannels(ECollisionResponse::ECR_Overlap);
 
+	// Navmesh walking (see UpdateMovementMode) projects onto the navmesh every so often instead of sweeping
+	GetCharacterMovement()->bSweepWhileNavWalking = false;
+	GetCharacterMovement()->NavMeshProjectionInterval = 0.2f;
+
  	// Set this character to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = true;
-	MovingForward = false;
-	Attacking = false;
 	Interruptable = true;
+	KeepClosingIn = false;
+	CrowdProxy = false;
+	Pooled = false;
+	TargetPlayerOnBeginPlay = true;
 	LastStumbleIndex = 0;
+	SquadRole = ESquadRole::NONE;
+	SquadOffset = FVector::ZeroVector;
+	TauntCooldown = 4.0f;
+	TauntTimestamp = -TauntCooldown;
 }
 
 // Called when the game starts or when spawned
@@ -30,8 +53,16 @@ void AEnemyBase::BeginPlay()
 
 	ActiveState = State::IDLE;
 
-	//* Temporary NPC target solution */
-	Target = UGameplayStatics::GetPlayerPawn(GetWorld(), 0);
+	if (TargetPlayerOnBeginPlay)
+		AssignTarget(UGameplayStatics::GetPlayerPawn(GetWorld(), 0));
+}
+
+void AEnemyBase::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (USquadSubsystem* Squads = GetWorld()->GetSubsystem<USquadSubsystem>())
+		Squads->Leave(this);
+
+	Super::EndPlay(EndPlayReason);
 }
 
 // Called every frame
@@ -40,10 +71,38 @@ void AEnemyBase::Tick(float DeltaTime)
 	Super::Tick(DeltaTime);
 
 	TickStateMachine();
+
+	if (!CrowdProxy)
+	{
+		UpdateMovementMode();
+		UpdateAnimationSignificance();
+	}
+}
+
+void AEnemyBase::UpdateMovementMode()
+{
+	ACombatant* Target = GetTarget();
+	UCharacterMovementComponent* Movement = GetCharacterMovement();
+	if (!Movement->IsMovingOnGround())
+		return;
+
+	// Attacks, lunges and stumbles need proper collision, as does anything close to the target
+	bool FullMovement = ActiveState == State::ATTACK || ActiveState == State::STUMBLE
+		|| (Target && FVector::DistSquared(GetActorLocation(), Target->GetActorLocation()) <= FMath::Square(GetTuning().NavWalkingRange));
+
+	EMovementMode WantedMode = FullMovement ? MOVE_Walking : MOVE_NavWalking;
+	if (Movement->MovementMode != WantedMode)
+		Movement->SetMovementMode(WantedMode);
+
+	if (WantedMode == MOVE_NavWalking)
+		INC_DWORD_STAT(STAT_EnemiesNavWalking);
 }
 
 void AEnemyBase::TickStateMachine()
 {
+	COMBAT_TELEMETRY_SCOPE(Telemetry, StateMachineMs);
+	COMBAT_TELEMETRY_ADD(Telemetry, EnemiesInState[(int32)ActiveState], 1);
+
 	switch (ActiveState)
 	{
 		case State::IDLE:
@@ -61,25 +120,99 @@ void AEnemyBase::TickStateMachine()
 		case State::STUMBLE:
 			StateStumble();
 			break;
+		case State::TAUNT:
+			StateTaunt();
+			break;
 		case State::DEAD:
 			StateDead();
 			break;
 	}
 }
 
+void AEnemyBase::UpdateAnimationSignificance()
+{
+	ACombatant* Target = GetTarget();
+	USkeletalMeshComponentBudgeted* BudgetedMesh = Cast<USkeletalMeshComponentBudgeted>(GetMesh());
+	IAnimationBudgetAllocator* Allocator = IAnimationBudgetAllocator::Get(GetWorld());
+	if (!BudgetedMesh || !Allocator)
+		return;
+
+	// Attacks and stumbles rely on anim notifies (SetAttackDamaging, EndAttack, EndStumble),
+	// so those montages are never skipped or interpolated, even when off-screen
+	bool NotifyCritical = ActiveState == State::ATTACK || ActiveState == State::STUMBLE;
+
+	// Otherwise prioritise enemies that are close to their target and visible
+	float Significance = 0.1f;
+	if (Target)
+		Significance = 1.0f / FMath::Max(1.0f, FVector::Distance(GetActorLocation(), Target->GetActorLocation()) / 300.0f);
+	if (GetMesh()->WasRecentlyRendered())
+		Significance *= 2.0f;
+	if (NotifyCritical)
+		Significance = 10.0f;
+
+	Allocator->SetComponentSignificance(BudgetedMesh, Significance, NotifyCritical, NotifyCritical, !NotifyCritical);
+}
+
 void AEnemyBase::SetState(State NewState)
 {
-	if (ActiveState != State::DEAD)
-		ActiveState = NewState;
+	if (ActiveState == State::DEAD || ActiveState == NewState)
+		return;
+
+	COMBAT_EVENT(STATE_TRANSITION, this, GetTarget(), (float)ActiveState, (uint8)NewState);
+	ActiveState = NewState;
+}
+
+void AEnemyBase::JoinSquad()
+{
+	if (USquadSubsystem* Squads = GetWorld()->GetSubsystem<USquadSubsystem>())
+		Squads->Join(this, GetTarget());
+}
+
+bool AEnemyBase::FollowSquadRole()
+{
+	ACombatant* Target = GetTarget();
+	switch (SquadRole)
+	{
+		case ESquadRole::WAITER:
+			SetState(State::CHASE_FAR);
+			return true;
+
+		case ESquadRole::TAUNTER:
+			SetState(State::TAUNT);
+			return true;
+
+		case ESquadRole::FLANKER:
+		{
+			// Strike once the target has turned away, otherwise hold the flank slot
+			FVector FromTarget = (GetActorLocation() - Target->GetActorLocation()).GetSafeNormal2D();
+			if (FVector::DotProduct(Target->GetActorForwardVector(), FromTarget) < 0.0f)
+				return false;
+
+			FVector Slot = Target->GetActorLocation() + SquadOffset;
+			AAIController* AIController = Cast<AAIController>(Controller);
+			if (FVector::DistSquared2D(GetActorLocation(), Slot) > FMath::Square(100.0f) && !AIController->IsFollowingAPath())
+			{
+				AIController->MoveToLocation(Slot, 50.0f);
+				COMBAT_TELEMETRY_ADD(Telemetry, PathRequests, 1);
+			}
+			return true;
+		}
+
+		default:
+			return false;
+	}
 }
 
 void AEnemyBase::StateIdle()
 {
+	ACombatant* Target = GetTarget();
 	//* Temporary 'target sensing' implementation */
-	// Check if player within distance
-	if (Target && FVector::Distance(Target->GetActorLocation(), GetActorLocation()) <= 1200.0f)
+	// Check if player within distance (and ready to fight)
+	if (Target && CombatCore::IdleTransition(FVector::Distance(Target->GetActorLocation(), GetActorLocation()),
+		GetTuning().GetCoreTuning(), IsArchetypeLoaded()) == CombatCore::EState::ChaseClose)
 	{
-		TargetLocked = true;
+		SetCombatFlag(ECombatFlags::TargetLocked, true);
+		JoinSquad();
 
 		SetState(State::CHASE_CLOSE);
 	}
@@ -87,93 +220,161 @@ void AEnemyBase::StateIdle()
 
 void AEnemyBase::StateChaseClose()
 {
+	ACombatant* Target = GetTarget();
 	// DEFAULT:
-	//		Attack target when close,
-	//		otherwise move towards target
+	//		Attack target when close (or long attack, for enemies that have one),
+	//		otherwise move towards target (unless already in range and KeepClosingIn is off)
+	//		Chosen by utility scoring (see the archetype's Actions)
 
-	if (Target && !Attacking && !Stumbling)
+	if (Target && !HasAnyCombatFlags(ECombatFlags::Attacking | ECombatFlags::Stumbling))
 	{
-		float Distance = FVector::Distance(GetActorLocation(), Target->GetActorLocation());
+		if (FollowSquadRole())
+			return;
 
-		// CLOSE ENOUGH TO ATTACK
-		if (Distance <= 300.0f)
+		// Never mid-attack or mid-stumble - the guard above covers that
+		switch (GetWorld()->GetSubsystem<UUtilitySubsystem>()->Decide(this))
 		{
-			// Attack if looking towards target
-			FVector TargetDirection = Target->GetActorLocation() - GetActorLocation();
-			float DotProduct = FVector::DotProduct(GetActorForwardVector(), TargetDirection.GetSafeNormal());
-
-			if (DotProduct >= 0.95f && !Attacking && !Stumbling)
+			case EUtilityAction::ATTACK:
 				Attack(false);
+				return;
+			case EUtilityAction::LONG_ATTACK:
+				if (TryLongAttack())
+					return;
+				break;
+			default:
+				break;
 		}
-		else
+
+		if (KeepClosingIn || FVector::Distance(GetActorLocation(), Target->GetActorLocation()) > GetTuning().AttackRange)
 		{
 			// Move towards target
 			AAIController* AIController = Cast<AAIController>(Controller);
 			if (!AIController->IsFollowingAPath())
 			{
 				AIController->MoveToActor(Target);
+				COMBAT_TELEMETRY_ADD(Telemetry, PathRequests, 1);
 			}
 		}
 	}
 }
 
+bool AEnemyBase::GetUtilityInputs(CombatCore::FUtilityInputs& Inputs)
+{
+	ACombatant* Target = GetTarget();
+	if (!Target || ActiveState != State::CHASE_CLOSE || HasAnyCombatFlags(ECombatFlags::Attacking | ECombatFlags::Stumbling))
+		return false;
+
+	FVector TargetDirection = Target->GetActorLocation() - GetActorLocation();
+	Inputs[(int32)CombatCore::EUtilityInput::Distance] = TargetDirection.Size();
+	Inputs[(int32)CombatCore::EUtilityInput::Facing] = FVector::DotProduct(GetActorForwardVector(), TargetDirection.GetSafeNormal());
+	Inputs[(int32)CombatCore::EUtilityInput::TargetRolling] = Target->IsRolling() ? 1.0f : 0.0f;
+	Inputs[(int32)CombatCore::EUtilityInput::TargetAttacking] = Target->IsAttacking() ? 1.0f : 0.0f;
+
+	// No long attack: never off cooldown, so never worth a line of sight query
+	Inputs[(int32)CombatCore::EUtilityInput::Cooldown] = MAX_flt;
+	Inputs[(int32)CombatCore::EUtilityInput::LineOfSight] = 0.0f;
+	return true;
+}
+
 void AEnemyBase::StateChaseFar()
 {
+	ACombatant* Target = GetTarget();
 	// DEFAULT:
 	//		Idle behaviour until player comes within range
+	//		Squad waiters hold at range until the squad gives them a slot
+
+	if (!Target)
+		return;
 
-	if (FVector::Distance(GetActorLocation(), Target->GetActorLocation()) < 850.0f)
+	float Distance = FVector::Distance(GetActorLocation(), Target->GetActorLocation());
+	if (SquadRole == ESquadRole::WAITER)
 	{
-		SetState(State::CHASE_CLOSE);
+		AAIController* AIController = Cast<AAIController>(Controller);
+		if (Distance < GetTuning().ChaseFarRange)
+		{
+			if (AIController->IsFollowingAPath())
+				AIController->StopMovement();
+		}
+		else if (Distance > GetTuning().ChaseFarRange + 200.0f && !AIController->IsFollowingAPath())
+		{
+			AIController->MoveToActor(Target, GetTuning().ChaseFarRange);
+			COMBAT_TELEMETRY_ADD(Telemetry, PathRequests, 1);
+		}
+		return;
 	}
+
+	if (SquadRole != ESquadRole::NONE)
+		SetState(State::CHASE_CLOSE);
+	else
+		SetState((State)CombatCore::ChaseFarTransition(Distance, GetTuning().GetCoreTuning()));
 }
 
 void AEnemyBase::StateAttack()
 {
 	// DEFAULT:
-	//		Move forward if active attack needs is
+	//		Apply damage while the weapon is active (forward motion is driven by SetMovingForward)
 	//		More advanced implementations may make use of the 'AttackReady' bool to string attacks
 
 	// Check if weapon overlapping other actors
-	if (AttackDamaging)
+	if (IsAttackDamaging())
 	{
 		TSet<AActor*> OverlappingActors;
 		Weapon->GetOverlappingActors(OverlappingActors);
+		COMBAT_TELEMETRY_ADD(Telemetry, OverlapQueries, 1);
 
 		for (AActor* OtherActor : OverlappingActors)
 		{
 			if (OtherActor == this)
 				continue;
 
-			if (!AttackHitActors.Contains(OtherActor))
+			if (!CheckAndMarkAttackHit(OtherActor))
 			{
 				float AppliedDamage = UGameplayStatics::ApplyDamage(OtherActor, 1.0f, GetController(), this, UDamageType::StaticClass());
 				if (AppliedDamage > 0.0f)
 				{
-					AttackHitActors.Add(OtherActor);
+					COMBAT_TELEMETRY_ADD(Telemetry, HitsApplied, 1);
+					COMBAT_EVENT(HIT, this, OtherActor, AppliedDamage);
+					GetWorld()->GetSubsystem<UHitFeedbackSubsystem>()->AddHit(this, OtherActor);
 				}
 			}
 		}
 	}
-
-	if (MovingForward)
-		MoveForward();
 }
 
 void AEnemyBase::StateStumble()
 {
-	if (Stumbling)
-	{
-		if (MovingBackwards)
-			AddMovementInput(-GetActorForwardVector(), 40.0f * GetWorld()->GetDeltaSeconds());
-	}
-	else
-		SetState(State::CHASE_CLOSE);		
+	if (IsStumbling() && IsMovingBackwards())
+		AddMovementInput(-GetActorForwardVector(), GetTuning().StumblePushScale * GetLocalDeltaTime());
+
+	SetState((State)CombatCore::StumbleTransition(IsStumbling()));
 }
 
 void AEnemyBase::StateTaunt()
 {
+	ACombatant* Target = GetTarget();
+	// DEFAULT:
+	//		Face the target from where we are and taunt every so often, until the squad needs us
+
+	if (SquadRole != ESquadRole::TAUNTER || !Target)
+	{
+		SetState(State::CHASE_CLOSE);
+		return;
+	}
+
+	if (HasAnyCombatFlags(ECombatFlags::Busy))
+		return;
 
+	AAIController* AIController = Cast<AAIController>(Controller);
+	if (AIController->IsFollowingAPath())
+		AIController->StopMovement();
+	FocusTarget();
+
+	float Now = GetLocalTime();
+	if (Now >= TauntTimestamp + TauntCooldown && Archetype && Archetype->Taunt.Get())
+	{
+		TauntTimestamp = Now;
+		PlayAnimMontage(Archetype->Taunt.Get());
+	}
 }
 
 void AEnemyBase::StateDead()
@@ -191,7 +392,108 @@ void AEnemyBase::SetupPlayerInputComponent(UInputComponent* PlayerInputComponent
 void AEnemyBase::FocusTarget()
 {
 	AAIController* Control = Cast<AAIController>(GetController());
-	Control->SetFocus(Target);
+	Control->SetFocus(GetTarget());
+}
+
+void AEnemyBase::SetTarget(AActor* NewTarget)
+{
+	FCombatantHandle NewHandle = GetHandleOf(NewTarget);
+	if (NewHandle == TargetHandle)
+		return;
+
+	COMBAT_EVENT(TARGET_SWITCH, this, NewTarget);
+	TargetHandle = NewHandle;
+
+	// Fight alongside whoever else is on the new target
+	if (IsTargetLocked())
+		JoinSquad();
+}
+
+void AEnemyBase::PromoteFromCrowd(State EntityState)
+{
+	// Entity attacks have no montage to continue, so pick up the chase instead
+	if (EntityState == State::IDLE)
+		return;
+
+	SetCombatFlag(ECombatFlags::TargetLocked, true);
+	JoinSquad();
+	SetState(EntityState == State::CHASE_FAR ? State::CHASE_FAR : State::CHASE_CLOSE);
+}
+
+void AEnemyBase::SetCrowdProxy(bool IsProxy)
+{
+	CrowdProxy = IsProxy;
+
+	// The state machine keeps ticking so the enemy still notices the player approaching,
+	// but mesh, animation and movement work is skipped while drawn as an instance
+	// (and a parked enemy stays hidden either way)
+	SetVisualsActive(!IsProxy && !Pooled);
+}
+
+void AEnemyBase::SetPooled(bool IsPooled)
+{
+	if (Pooled == IsPooled)
+		return;
+	Pooled = IsPooled;
+
+	// Before leaving the registry - dropping collision ends overlaps, whose handlers look this enemy up
+	SetActorTickEnabled(!IsPooled);
+	SetActorEnableCollision(!IsPooled);
+	SetVisualsActive(!IsPooled && !CrowdProxy);
+
+	if (IsPooled)
+	{
+		if (USquadSubsystem* Squads = GetWorld()->GetSubsystem<USquadSubsystem>())
+			Squads->Leave(this);
+		if (AAIController* AIController = Cast<AAIController>(Controller))
+		{
+			AIController->StopMovement();
+			AIController->ClearFocus(EAIFocusPriority::Gameplay);
+		}
+
+		StopAnimMontage();
+		StopForwardMotion();
+		SetCombatFlag(ECombatFlags::Busy | ECombatFlags::TargetLocked | ECombatFlags::AttackDamaging
+			| ECombatFlags::MovingForward | ECombatFlags::MovingBackwards | ECombatFlags::NextAttackReady, false);
+		ActiveState = State::IDLE;
+		TargetHandle = FCombatantHandle();
+		LeaveRegistry();
+
+		// Parked enemies don't keep their montages resident
+		SetArchetypeHeld(false);
+	}
+	else
+	{
+		EnsureRegistered();
+		GetCharacterMovement()->SetMovementMode(MOVE_Walking);
+
+		// Streams back in if it was dropped meanwhile - IDLE waits for it before fighting
+		SetArchetypeHeld(true);
+	}
+}
+
+void AEnemyBase::SetVisualsActive(bool Active)
+{
+	SetActorHiddenInGame(!Active);
+	GetMesh()->SetComponentTickEnabled(Active);
+	GetCharacterMovement()->SetComponentTickEnabled(Active);
+
+	USkeletalMeshComponentBudgeted* BudgetedMesh = Cast<USkeletalMeshComponentBudgeted>(GetMesh());
+	IAnimationBudgetAllocator* Allocator = IAnimationBudgetAllocator::Get(GetWorld());
+	if (BudgetedMesh && Allocator)
+	{
+		if (Active)
+			Allocator->RegisterComponent(BudgetedMesh);
+		else
+			Allocator->UnregisterComponent(BudgetedMesh);
+	}
+}
+
+void AEnemyBase::GetLegacyMontages(UCombatArchetype& Legacy) const
+{
+	Super::GetLegacyMontages(Legacy);
+
+	Legacy.OverheadSmash = OverheadSmash;
 }
 
 float AEnemyBase::TakeDamage(float DamageAmount, FDamageEvent const & DamageEvent, AController * EventInstigator, AActor * DamageCauser)
@@ -201,11 +503,14 @@ float AEnemyBase::TakeDamage(float DamageAmount, FDamageEvent const & DamageEven
 	//		Play random stumble animation
 	//		Rotate towards damage source
 
-	if (DamageCauser == this)
+	if (DamageCauser == this || !IsArchetypeLoaded())
 		return 0.0f;
 
 	//* TODO: Remove health *//
 
+	COMBAT_EVENT(DAMAGE, this, DamageCauser, DamageAmount);
+	OnAnyDamaged.Broadcast(this, DamageCauser, DamageAmount);
+
 	// Don't stumble if not interruptable (still take damage though)
 	if (!Interruptable)
 		return DamageAmount;
@@ -214,33 +519,50 @@ float AEnemyBase::TakeDamage(float DamageAmount, FDamageEvent const & DamageEven
 	EndAttack();
 	SetMovingBackwards(false);
 	SetMovingForward(false);
-	Stumbling = true;
+	SetCombatFlag(ECombatFlags::Stumbling, true);
 	SetState(State::STUMBLE);
 	Cast<AAIController>(Controller)->StopMovement();
 
-	// Play random stumble animation from array - Does not repeat last animation used
-	int AnimationIndex;
-	do { AnimationIndex = FMath::RandRange(0, TakeHit_StumbleBackwards.Num() - 1); }
-	while (AnimationIndex == LastStumbleIndex);
+	// Play random stumble animation from array - Does not repeat last animation used (if there is another)
+	const int NumStumbles = Archetype ? Archetype->TakeHit_StumbleBackwards.Num() : 0;
+	int AnimationIndex = FMath::RandRange(0, FMath::Max(NumStumbles - 1, 0));
+	while (NumStumbles > 1 && AnimationIndex == LastStumbleIndex)
+		AnimationIndex = FMath::RandRange(0, NumStumbles - 1);
 
-	PlayAnimMontage(TakeHit_StumbleBackwards[AnimationIndex]);
+	if (Archetype)
+		PlayAnimMontage(GetLoadedMontage(Archetype->TakeHit_StumbleBackwards, AnimationIndex));
 	LastStumbleIndex = AnimationIndex;
 
+	COMBAT_EVENT(STUMBLE, this, DamageCauser, 0.0f, (uint8)AnimationIndex);
+
 
 	// Rotate towards source of damage
-	FVector Direction = DamageCauser->GetActorLocation() - GetActorLocation();
-	Direction = FVector(Direction.X, Direction.Y, 0);
-	FRotator Rotation = FRotationMatrix::MakeFromX(Direction).Rotator();
-	SetActorRotation(Rotation);
+	if (DamageCauser)
+	{
+		FVector Direction = DamageCauser->GetActorLocation() - GetActorLocation();
+		Direction = FVector(Direction.X, Direction.Y, 0);
+		FRotator Rotation = FRotationMatrix::MakeFromX(Direction).Rotator();
+		SetActorRotation(Rotation);
+	}
 
 	return DamageAmount;
 }
 
 
-void AEnemyBase::MoveForward()
+float AEnemyBase::GetForwardMotionSpeed() const
 {
-	FVector NewLocation = GetActorLocation() + (GetActorForwardVector() * 500.0f * GetWorld()->GetDeltaSeconds());
-	SetActorLocation(NewLocation, true);
+	return GetTuning().ForwardMotionSpeed;
+}
+
+void AEnemyBase::SetMovingForward(bool IsMovingForward)
+{
+	Super::SetMovingForward(IsMovingForward);
+
+	// Forward motion is handed to CharacterMovement once, instead of swept every frame
+	if (IsMovingForward)
+		StartForwardMotion(GetForwardMotionSpeed());
+	else
+		StopForwardMotion();
 }
 
 void AEnemyBase::Attack(bool Rotate)
@@ -252,7 +574,8 @@ void AEnemyBase::Attack(bool Rotate)
 	Cast<AAIController>(Controller)->StopMovement();
 
 	// Rotate towards target
-	if (Rotate)
+	ACombatant* Target = GetTarget();
+	if (Rotate && Target)
 	{
 		FVector Direction = Target->GetActorLocation() - GetActorLocation();
 		Direction = FVector(Direction.X, Direction.Y, 0);
@@ -260,8 +583,11 @@ void AEnemyBase::Attack(bool Rotate)
 		SetActorRotation(Rotation);
 	}
 
-	int RandomIndex = FMath::RandRange(0, AttackAnimations.Num() - 1);
-	PlayAnimMontage(AttackAnimations[RandomIndex]);
+	if (Archetype && Archetype->AttackAnimations.Num() > 0)
+	{
+		int RandomIndex = FMath::RandRange(0, Archetype->AttackAnimations.Num() - 1);
+		PlayAnimMontage(GetLoadedMontage(Archetype->AttackAnimations, RandomIndex));
+	}
 }
 
 void AEnemyBase::AttackNextReady()
@@ -272,6 +598,7 @@ void AEnemyBase::AttackNextReady()
 void AEnemyBase::EndAttack()
 {
 	Super::EndAttack();
+	SetMovingForward(false);
 	SetState(State::CHASE_CLOSE);
 }
 
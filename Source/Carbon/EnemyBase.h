@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "Combatant.h"
+#include "SquadSubsystem.h"
 #include "GameFramework/Character.h"
 #include "EnemyBase.generated.h"
 
@@ -29,18 +30,33 @@ class CARBON_API AEnemyBase : public ACombatant
 
 public:
 	// Sets default values for this character's properties
-	AEnemyBase();
+	AEnemyBase(const FObjectInitializer& ObjectInitializer = FObjectInitializer::Get());
 
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Finite State Machine")
 	State ActiveState;
 
 	virtual float TakeDamage(float DamageAmount, struct FDamageEvent const & DamageEvent, class AController * EventInstigator, AActor * DamageCauser);
 
-	UPROPERTY(EditAnywhere, Category = "Animations")
-	UAnimMontage * OverheadSmash;
+	/** Deprecated: set on the archetype instead. Only used while no Archetype is assigned */
+	UPROPERTY(EditAnywhere, Category = "Animations", meta = (DeprecatedProperty, DeprecationMessage = "Use the combat archetype's OverheadSmash"))
+	TSoftObjectPtr<UAnimMontage> OverheadSmash;
+
+	virtual void GetLegacyMontages(UCombatArchetype& Legacy) const override;
 
 	int LastStumbleIndex;
 
+	/** Role handed out by USquadSubsystem (NONE = fight alone) */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Squad")
+	ESquadRole SquadRole;
+
+	/** Placed enemies go for the player on BeginPlay - spawned ones are given a target by their spawner */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Combat")
+	bool TargetPlayerOnBeginPlay;
+
+	/** Seconds between taunts while taunting for the squad */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Squad")
+	float TauntCooldown;
+
 	// Not implemented movement speed variables yet
 	/*UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Movement")
 		float ChaseFarMovementSpeed;
@@ -53,15 +69,37 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	virtual void TickStateMachine();
 
+	/** Use cheap navmesh walking out of melee, full CharacterMovement for melee, attacks and stumbles */
+	void UpdateMovementMode();
+
+	/** Report how important this enemy's animation is to the animation budget allocator */
+	void UpdateAnimationSignificance();
+
 	void SetState(State NewState);
 
+	/** Join the squad fighting Target, if any */
+	void JoinSquad();
+
+	/** Act on the squad role where it overrides chasing - returns true if it did */
+	bool FollowSquadRole();
+
+	/** Flankers: target location + SquadOffset is the slot to hold */
+	FVector SquadOffset;
+
+	float TauntTimestamp;
+
 	virtual void StateIdle();
 
 	// State: Actively trying to keep close and attack the target
 	virtual void StateChaseClose();
 
+	/** Start the long attack UUtilitySubsystem chose - false if this enemy has none */
+	virtual bool TryLongAttack() { return false; }
+
 	// State: Engaged but not currently trying to attack (idle behaviour)
 	virtual void StateChaseFar();
 
@@ -73,7 +111,11 @@ protected:
 
 	virtual void StateDead();
 
-	virtual void MoveForward();
+	/** Speed the attack's forward motion moves at (see SetMovingForward) */
+	virtual float GetForwardMotionSpeed() const;
+
+	/** Anim called: Start/stop moving forward during an attack */
+	void SetMovingForward(bool IsMovingForward);
 
 	virtual void Attack(bool Rotate = true);
 
@@ -85,6 +127,21 @@ protected:
 
 	bool Interruptable;
 
+	/**
+	 * Keep walking at the target inside AttackRange while no attack is chosen (e.g. not yet facing
+	 * it), rather than standing and turning. The knight does, as it always has
+	 */
+	bool KeepClosingIn;
+
+	bool CrowdProxy;
+
+	bool Pooled;
+
+	virtual bool IsParked() const override { return Pooled; }
+
+	/** Show/hide the mesh and switch mesh, movement and animation budget work on/off */
+	void SetVisualsActive(bool Active);
+
 public:	
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
@@ -94,6 +151,35 @@ public:
 
 	void FocusTarget();
 
+	void SetTarget(AActor* NewTarget);
+
+	/** Continue from the state a crowd entity was in when it was promoted to this actor */
+	void PromoteFromCrowd(State EntityState);
+
+	/** Hide the full actor while ACrowdRepresentation draws it as an instance (or restore it) */
+	void SetCrowdProxy(bool IsProxy);
+
+	bool IsCrowdProxy() const { return CrowdProxy; }
+
+	/**
+	 * Park in (or take out of) UEnemyPoolSubsystem. Parked enemies don't tick, collide or
+	 * render, have left the registry, their squad and their target, and are IDLE again.
+	 */
+	void SetPooled(bool IsPooled);
+
+	bool IsPooled() const { return Pooled; }
+
+	/** Written by USquadSubsystem when the squad is replanned */
+	void SetSquadRole(ESquadRole Role, const FVector& Offset) { SquadRole = Role; SquadOffset = Offset; }
+
+	ESquadRole GetSquadRole() const { return SquadRole; }
+
+	/**
+	 * Fill Inputs (indexed by CombatCore::EUtilityInput) against the current target for
+	 * UUtilitySubsystem - false if this enemy isn't choosing a chase action right now
+	 */
+	virtual bool GetUtilityInputs(CombatCore::FUtilityInputs& Inputs);
+
 	/** Returns Weapon subobject **/
 	FORCEINLINE class UStaticMeshComponent* GetWeapon() const { return Weapon; }
 	
@@ -5,52 +5,59 @@
 #include "Kismet/GameplayStatics.h"
 #include "Engine/World.h"
 #include "GameFramework/CharacterMovementComponent.h"
+#include "VisibilitySubsystem.h"
+#include "CombatArchetype.h"
+#include "CombatTelemetry.h"
 
 AEnemyKnight::AEnemyKnight()
 {
 	LongAttackCooldown = 5.0f;
 	LongAttackTimestamp = -LongAttackCooldown;
+	KeepClosingIn = true;
 }
 
-void AEnemyKnight::StateChaseClose()
+bool AEnemyKnight::GetUtilityInputs(CombatCore::FUtilityInputs& Inputs)
 {
 	// KNIGHT:
 	//		Long range attack || short range attack || move closer
 
-	if (Target && !Attacking && !Stumbling)
+	if (!Super::GetUtilityInputs(Inputs))
+		return false;
+
+	const float Cooldown = FMath::Max(0.0f, LongAttackTimestamp + LongAttackCooldown - GetLocalTime());
+	Inputs[(int32)CombatCore::EUtilityInput::Cooldown] = Cooldown;
+
+	// Line of sight is read from the shared (batched, cached) visibility service - only
+	// asked for when a long attack could actually happen, so it doesn't trace for everyone
+	if (Cooldown <= 0.0f && Inputs[(int32)CombatCore::EUtilityInput::Distance] <= GetTuning().LongAttackRange)
 	{
-		float Distance = FVector::Distance(GetActorLocation(), Target->GetActorLocation());
-		AAIController* AIController = Cast<AAIController>(Controller);
-
-		// Attack if looking towards target
-		FVector TargetDirection = Target->GetActorLocation() - GetActorLocation();
-		float DotProduct = FVector::DotProduct(GetActorForwardVector(), TargetDirection.GetSafeNormal());
-		// Close enough for an attack
-		if (Distance <= 900.0f && DotProduct >= 0.95f)
-		{
-			if (Distance <= 300.0f)
-			{
-				Attack(false);
-				return;
-			}
-			else if (UGameplayStatics::GetTimeSeconds(GetWorld()) >= LongAttackTimestamp + LongAttackCooldown
-				&& AIController->LineOfSightTo(Target))
-			{
-				LongAttackTimestamp = UGameplayStatics::GetTimeSeconds(GetWorld());
-				LongAttack(true);
-				return;
-			}
-		}
-		// Move towards target
-		if (!AIController->IsFollowingAPath())
-		{
-			AIController->MoveToActor(Target);
-		}
+		Inputs[(int32)CombatCore::EUtilityInput::LineOfSight] =
+			GetWorld()->GetSubsystem<UVisibilitySubsystem>()->GetLineOfSight(this, GetTarget()) == ELineOfSight::VISIBLE ? 1.0f : 0.0f;
 	}
+	return true;
+}
+
+bool AEnemyKnight::TryLongAttack()
+{
+	// Only an attack that actually started uses up the cooldown
+	if (!LongAttack(true))
+		return false;
+
+	LongAttackTimestamp = GetLocalTime();
+	return true;
 }
 
-void AEnemyKnight::LongAttack(bool Rotate)
+bool AEnemyKnight::LongAttack(bool Rotate)
 {
+	ACombatant* Target = GetTarget();
+	UAnimMontage* Montage = nullptr;
+	if (IsArchetypeLoaded() && Archetype->LongAttackAnimations.Num() > 0)
+		Montage = GetLoadedMontage(Archetype->LongAttackAnimations, FMath::RandRange(0, Archetype->LongAttackAnimations.Num() - 1));
+
+	// Without a montage nothing would ever end the attack
+	if (!Target || !Montage)
+		return false;
+
 	Super::Attack();
 	SetMovingBackwards(false);
 	SetMovingForward(false);
@@ -68,17 +75,23 @@ void AEnemyKnight::LongAttack(bool Rotate)
 
 	// Calculate speed of jump (based on distance to player at *start* of jump)
 	float Distance = FVector::Distance(GetActorLocation(), Target->GetActorLocation());
-	LongAttackForwardSpeed = Distance + 600.0f;
+	LongAttackForwardSpeed = CombatCore::LongAttackSpeed(Distance, GetTuning().GetCoreTuning());
 
 	// Play attack animation
-	int RandomIndex = FMath::RandRange(0, LongAttackAnimations.Num() - 1);
-	PlayAnimMontage(LongAttackAnimations[RandomIndex]);
+	PlayAnimMontage(Montage);
+	return true;
 }
 
-void AEnemyKnight::MoveForward()
+float AEnemyKnight::GetForwardMotionSpeed() const
 {
-	FVector NewLocation = GetActorLocation() + (GetActorForwardVector() * LongAttackForwardSpeed * GetWorld()->GetDeltaSeconds());
-	SetActorLocation(NewLocation);
+	return LongAttackForwardSpeed;
+}
+
+void AEnemyKnight::GetLegacyMontages(UCombatArchetype& Legacy) const
+{
+	Super::GetLegacyMontages(Legacy);
+
+	Legacy.LongAttackAnimations = LongAttackAnimations;
 }
 
 float AEnemyKnight::TakeDamage(float DamageAmount, struct FDamageEvent const & DamageEvent, class AController * EventInstigator, AActor * DamageCauser)
@@ -86,21 +99,7 @@ float AEnemyKnight::TakeDamage(float DamageAmount, struct FDamageEvent const & D
 	if (DamageCauser == this)
 		return 0.0f;
 
-
-	if (QuickHitsTaken == 0 || GetWorld()->GetTimeSeconds() - QuickHitsTimestamp <= 1.0f)
-	{
-		QuickHitsTaken++;
-		QuickHitsTimestamp = GetWorld()->GetTimeSeconds();
-
-		if (QuickHitsTaken >= 4)
-			Interruptable = false;
-	}
-	else
-	{
-		QuickHitsTaken = 0;
-		Interruptable = true;
-	}
-
+	Interruptable = CombatCore::TakeQuickHit(QuickHits, GetLocalTime(), Interruptable);
 
 	return Super::TakeDamage(DamageAmount, DamageEvent, EventInstigator, DamageCauser);
 }
@@ -17,18 +17,27 @@ class CARBON_API AEnemyKnight : public AEnemyBase
 public:
 	AEnemyKnight();
 
-	UPROPERTY(EditAnywhere, Category = "Animations")
-	TArray<UAnimMontage*> LongAttackAnimations;
+	/** Deprecated: set on the archetype instead. Only used while no Archetype is assigned */
+	UPROPERTY(EditAnywhere, Category = "Animations", meta = (DeprecatedProperty, DeprecationMessage = "Use the combat archetype's LongAttackAnimations"))
+	TArray<TSoftObjectPtr<UAnimMontage>> LongAttackAnimations;
+
+	virtual void GetLegacyMontages(UCombatArchetype& Legacy) const override;
 
 	float TakeDamage(float DamageAmount, FDamageEvent const & DamageEvent, AController * EventInstigator, AActor * DamageCauser);
 
+	float GetLongAttackCooldown() const { return LongAttackCooldown; }
+
+	/** Adds the long attack's cooldown and (when it could happen) line of sight */
+	virtual bool GetUtilityInputs(CombatCore::FUtilityInputs& Inputs) override;
+
 protected:
-	
-	void StateChaseClose();
 
-	void LongAttack(bool Rotate = true);
+	virtual bool TryLongAttack() override;
+
+	/** Start the jump attack - false (changing nothing) without a target or a loaded animation */
+	bool LongAttack(bool Rotate = true);
 
-	void MoveForward();
+	float GetForwardMotionSpeed() const;
 
 private:
 	// Long-range jump attack
@@ -38,6 +47,5 @@ private:
 	float LongAttackForwardSpeed;
 
 	// After x consecutive hits, the knight cannot be interrupted 
-	int QuickHitsTaken;
-	float QuickHitsTimestamp;
+	CombatCore::FQuickHits QuickHits;
 };
@@ -0,0 +1,138 @@
+// Sam Smith
+
+#include "EnemyPool.h"
+#include "Carbon.h"
+#include "EnemyBase.h"
+#include "Engine/World.h"
+
+DECLARE_CYCLE_STAT(TEXT("Enemy Pool Prewarm"), STAT_EnemyPoolPrewarm, STATGROUP_Carbon);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Enemy Pool Prewarmed"), STAT_EnemyPoolPrewarmed, STATGROUP_Carbon);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Enemy Pool Misses"), STAT_EnemyPoolMisses, STATGROUP_Carbon);
+
+static TAutoConsoleVariable<float> CVarEnemyPoolPrewarmBudgetMs(
+	TEXT("carbon.EnemyPool.PrewarmBudgetMs"), 1.0f,
+	TEXT("Game thread time spent spawning pre-warmed enemies per frame."));
+
+static TAutoConsoleVariable<int32> CVarEnemyPoolMaxParked(
+	TEXT("carbon.EnemyPool.MaxParked"), 32,
+	TEXT("Most enemies parked per class - released enemies beyond this are destroyed."));
+
+void UEnemyPoolSubsystem::Prewarm(TSubclassOf<AEnemyBase> Class, int32 Count, const FVector& Location)
+{
+	if (!Class || Count <= 0)
+		return;
+
+	FEnemyPool& Pool = Pools.FindOrAdd(Class);
+	Pool.Pending = FMath::Max(Pool.Pending, Count - Pool.Parked.Num());
+	PrewarmLocations.Add(Class, Location);
+}
+
+bool UEnemyPoolSubsystem::IsPrewarming(TSubclassOf<AEnemyBase> Class) const
+{
+	const FEnemyPool* Pool = Pools.Find(Class);
+	return Pool && Pool->Pending > 0;
+}
+
+AEnemyBase* UEnemyPoolSubsystem::Acquire(TSubclassOf<AEnemyBase> Class, const FTransform& Transform, AActor* Target)
+{
+	if (!Class)
+		return nullptr;
+
+	AEnemyBase* Enemy = nullptr;
+	FEnemyPool& Pool = Pools.FindOrAdd(Class);
+	while (!Enemy && Pool.Parked.Num() > 0)
+	{
+		Enemy = Pool.Parked.Pop(false);
+		if (!IsValid(Enemy))
+			Enemy = nullptr;
+	}
+
+	if (Enemy)
+	{
+		Enemy->SetActorTransform(Transform, false, nullptr, ETeleportType::ResetPhysics);
+		Enemy->SetPooled(false);
+	}
+	else
+	{
+		Enemy = Spawn(Class, Transform);
+		INC_DWORD_STAT(STAT_EnemyPoolMisses);
+	}
+
+	if (Enemy)
+		Enemy->SetTarget(Target);
+	return Enemy;
+}
+
+void UEnemyPoolSubsystem::Release(AEnemyBase* Enemy)
+{
+	if (!IsValid(Enemy) || Enemy->IsPooled())
+		return;
+
+	FEnemyPool& Pool = Pools.FindOrAdd(Enemy->GetClass());
+	if (Pool.Parked.Num() >= CVarEnemyPoolMaxParked.GetValueOnGameThread())
+	{
+		Enemy->Destroy();
+		return;
+	}
+
+	Enemy->SetPooled(true);
+	Pool.Parked.Add(Enemy);
+}
+
+AEnemyBase* UEnemyPoolSubsystem::Spawn(TSubclassOf<AEnemyBase> Class, const FTransform& Transform)
+{
+	AEnemyBase* Enemy = GetWorld()->SpawnActorDeferred<AEnemyBase>(Class, Transform, nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+	if (!Enemy)
+		return nullptr;
+
+	// Whoever takes it from the pool decides what it fights
+	Enemy->TargetPlayerOnBeginPlay = false;
+	Enemy->FinishSpawning(Transform);
+
+	if (!Enemy->GetController())
+		Enemy->SpawnDefaultController();
+	return Enemy;
+}
+
+void UEnemyPoolSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_EnemyPoolPrewarm);
+
+	const double EndTime = FPlatformTime::Seconds() + CVarEnemyPoolPrewarmBudgetMs.GetValueOnGameThread() / 1000.0;
+	const int32 MaxParked = CVarEnemyPoolMaxParked.GetValueOnGameThread();
+	bool Spawned = false;
+
+	for (auto& Pair : Pools)
+	{
+		FEnemyPool& Pool = Pair.Value;
+		Pool.Pending = FMath::Max(0, FMath::Min(Pool.Pending, MaxParked - Pool.Parked.Num()));
+		while (Pool.Pending > 0)
+		{
+			// Always make some progress, however small the budget
+			if (Spawned && FPlatformTime::Seconds() >= EndTime)
+				return;
+
+			--Pool.Pending;
+			Spawned = true;
+
+			const FVector* Location = PrewarmLocations.Find(Pair.Key);
+			AEnemyBase* Enemy = Spawn(Pair.Key, FTransform(Location ? *Location : FVector::ZeroVector));
+			if (!Enemy)
+				continue;
+
+			Enemy->SetPooled(true);
+			Pool.Parked.Add(Enemy);
+			INC_DWORD_STAT(STAT_EnemyPoolPrewarmed);
+		}
+	}
+}
+
+ETickableTickType UEnemyPoolSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Always;
+}
+
+TStatId UEnemyPoolSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UEnemyPoolSubsystem, STATGROUP_Tickables);
+}
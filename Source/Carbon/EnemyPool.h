@@ -0,0 +1,64 @@
+// Sam Smith
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "EnemyPool.generated.h"
+
+class AEnemyBase;
+
+USTRUCT()
+struct FEnemyPool
+{
+	GENERATED_BODY()
+
+	/** Parked enemies, ready to be taken */
+	UPROPERTY(Transient)
+	TArray<AEnemyBase*> Parked;
+
+	/** Enemies still to be spawned by pre-warming */
+	int32 Pending = 0;
+};
+
+/**
+ * Parked enemy actors, per class, so arenas and encounters don't spawn (construct, register
+ * components, BeginPlay) enemies on the frame they need them.
+ * Pre-warm requests are spawned in Tick, with at most carbon.EnemyPool.PrewarmBudgetMs spent
+ * per frame (at least one enemy is always spawned). Taking from an empty pool falls back to
+ * spawning on the spot, counted by the Enemy Pool Misses stat.
+ */
+UCLASS()
+class CARBON_API UEnemyPoolSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	/** Make sure at least Count enemies of Class are parked, queueing spawns near Location for any missing */
+	void Prewarm(TSubclassOf<AEnemyBase> Class, int32 Count, const FVector& Location);
+
+	/** True while pre-warms of Class are still queued */
+	bool IsPrewarming(TSubclassOf<AEnemyBase> Class) const;
+
+	/** Take a parked enemy of Class (or spawn one), place it at Transform and set it on Target */
+	AEnemyBase* Acquire(TSubclassOf<AEnemyBase> Class, const FTransform& Transform, AActor* Target);
+
+	/** Park Enemy for reuse (destroyed instead if its pool is full) */
+	void Release(AEnemyBase* Enemy);
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+private:
+	AEnemyBase* Spawn(TSubclassOf<AEnemyBase> Class, const FTransform& Transform);
+
+	UPROPERTY(Transient)
+	TMap<TSubclassOf<AEnemyBase>, FEnemyPool> Pools;
+
+	/** Where pre-warmed enemies of each class are spawned (they are parked, so nothing sees them) */
+	TMap<TSubclassOf<AEnemyBase>, FVector> PrewarmLocations;
+};
@@ -0,0 +1,83 @@
+// Sam Smith
+
+#include "EnemyRanged.h"
+#include "AIController.h"
+#include "Kismet/GameplayStatics.h"
+#include "Engine/World.h"
+#include "Components/SkeletalMeshComponent.h"
+#include "VisibilitySubsystem.h"
+#include "CombatArchetype.h"
+#include "CombatTelemetry.h"
+
+AEnemyRanged::AEnemyRanged()
+{
+	MuzzleSocket = TEXT("RightHandItem");
+	ShotCooldown = 2.0f;
+	ShotTimestamp = -ShotCooldown;
+}
+
+void AEnemyRanged::StateChaseClose()
+{
+	// RANGED:
+	//		Shoot when within AttackRange, with a clear line and the cooldown passed,
+	//		otherwise move closer
+
+	ACombatant* Target = GetTarget();
+	if (Target && !HasAnyCombatFlags(ECombatFlags::Attacking | ECombatFlags::Stumbling))
+	{
+		if (FollowSquadRole())
+			return;
+
+		float Distance = FVector::Distance(GetActorLocation(), Target->GetActorLocation());
+		AAIController* AIController = Cast<AAIController>(Controller);
+		float Now = GetLocalTime();
+
+		// Line of sight is only asked for once a shot could actually happen
+		bool CanShoot = Distance <= GetTuning().AttackRange && Now >= ShotTimestamp + ShotCooldown;
+		if (CanShoot && GetWorld()->GetSubsystem<UVisibilitySubsystem>()->GetLineOfSight(this, Target) == ELineOfSight::VISIBLE)
+		{
+			ShotTimestamp = Now;
+			Attack(true);
+			return;
+		}
+
+		// Move closer while out of range (or blocked), hold position otherwise
+		if (Distance > GetTuning().AttackRange || CanShoot)
+		{
+			if (!AIController->IsFollowingAPath())
+			{
+				AIController->MoveToActor(Target);
+				COMBAT_TELEMETRY_ADD(Telemetry, PathRequests, 1);
+			}
+		}
+		else if (AIController->IsFollowingAPath())
+			AIController->StopMovement();
+	}
+}
+
+void AEnemyRanged::StateAttack()
+{
+}
+
+void AEnemyRanged::SetAttackDamaging(bool Damaging)
+{
+	if (Damaging && !IsAttackDamaging())
+		FireProjectile();
+
+	Super::SetAttackDamaging(Damaging);
+}
+
+void AEnemyRanged::FireProjectile()
+{
+	ACombatant* Target = GetTarget();
+	if (!Target)
+		return;
+
+	FVector Origin = GetMesh()->DoesSocketExist(MuzzleSocket) ? GetMesh()->GetSocketLocation(MuzzleSocket) : GetActorLocation();
+
+	// Aim where the target will be when the projectile gets there (first order)
+	float FlightTime = FVector::Distance(Origin, Target->GetActorLocation()) / FMath::Max(Projectile.Speed, 1.0f);
+	FVector AimPoint = Target->GetActorLocation() + Target->GetVelocity() * FlightTime;
+
+	GetWorld()->GetSubsystem<UProjectileSubsystem>()->Fire(this, Projectile, Origin, AimPoint - Origin);
+}
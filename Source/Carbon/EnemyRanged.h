@@ -0,0 +1,46 @@
+// Sam Smith
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "EnemyBase.h"
+#include "ProjectileSubsystem.h"
+#include "EnemyRanged.generated.h"
+
+/**
+ * Keeps its distance and shoots projectiles (see UProjectileSubsystem) at the target.
+ * Uses the archetype's attack animations: the projectile is released where the montage
+ * opens its damage window (SetAttackDamaging), so melee montages work as they are.
+ */
+UCLASS()
+class CARBON_API AEnemyRanged : public AEnemyBase
+{
+	GENERATED_BODY()
+
+public:
+	AEnemyRanged();
+
+protected:
+	virtual void StateChaseClose() override;
+
+	/** No weapon swing to check - the projectile does the damage */
+	virtual void StateAttack() override;
+
+	virtual void SetAttackDamaging(bool Damaging) override;
+
+	/** Release a projectile from the muzzle, leading the target */
+	void FireProjectile();
+
+private:
+	UPROPERTY(EditAnywhere, Category = "Combat")
+	FProjectileType Projectile;
+
+	/** Projectiles are released from this socket on the mesh (or the actor's location if missing) */
+	UPROPERTY(EditAnywhere, Category = "Combat")
+	FName MuzzleSocket;
+
+	/** Seconds between shots */
+	UPROPERTY(EditAnywhere, Category = "Combat")
+	float ShotCooldown;
+	float ShotTimestamp;
+};
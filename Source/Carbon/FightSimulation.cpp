@@ -0,0 +1,473 @@
+// Sam Smith
+
+#include "FightSimulation.h"
+#include "Carbon.h"
+#include "CarbonCharacter.h"
+#include "CombatArchetype.h"
+#include "CombatCore.h"
+#include "EnemyKnight.h"
+#include "SquadSubsystem.h"
+#include "UtilityAI.h"
+#include "Async/ParallelFor.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "HAL/PlatformTime.h"
+
+namespace FightSimulation
+{
+	/** Fixed timings standing in for montages and notifies, and when a fight is over */
+	struct FSettings
+	{
+		float Step = 1.0f / 30.0f;
+		float TimeLimit = 120.0f;
+		float AttackDuration = 1.5f;
+		float AttackHitTime = 0.5f;		// Into the attack, when the damage window opens
+		float StumbleDuration = 0.8f;
+		float SpawnRadius = 1500.0f;
+		int32 EnemyHits = 3;			// Hits that take an enemy out
+		int32 PlayerHits = 10;			// Hits that take the player out
+		float ReplanInterval = 0.5f;	// carbon.Squad.ReplanInterval
+		CombatCore::FSquadSettings Squad = {};
+	};
+
+	/** What one combatant class brings to a fight, read once from its defaults */
+	struct FClass
+	{
+		FCombatTuning Tuning;
+		CombatCore::FUtilityActions Actions;
+		float MoveSpeed = 600.0f;
+		float RotationSmoothing = 5.0f;
+		bool HasLongAttack = false;
+		float LongAttackCooldown = 0.0f;
+		bool HasQuickHits = false;
+	};
+
+	FClass ReadClass(TSubclassOf<ACombatant> CombatantClass)
+	{
+		const ACombatant* Defaults = CombatantClass->GetDefaultObject<ACombatant>();
+		FClass Class;
+		static const TArray<FUtilityActionScoring> NoActions;
+		const UCombatArchetype* Archetype = Defaults->GetArchetype();
+		if (Archetype)
+			Class.Tuning = Archetype->Tuning;
+		FUtilityActionScoring::BuildCoreActions(Archetype ? Archetype->Actions : NoActions, Class.Tuning, Class.Actions);
+		Class.MoveSpeed = Defaults->GetCharacterMovement()->MaxWalkSpeed;
+		Class.RotationSmoothing = Defaults->GetRotationSmoothing();
+		if (const AEnemyKnight* Knight = Cast<AEnemyKnight>(Defaults))
+		{
+			Class.HasLongAttack = true;
+			Class.LongAttackCooldown = Knight->GetLongAttackCooldown();
+			Class.HasQuickHits = true;
+		}
+		return Class;
+	}
+
+	/** Class as CombatCore's enemy steps read it - points at Class's action set */
+	CombatCore::FChaserClass GetChaserClass(const FClass& Class)
+	{
+		CombatCore::FChaserClass Chaser;
+		Chaser.Tuning = Class.Tuning.GetCoreTuning();
+		Chaser.Actions = &Class.Actions;
+		Chaser.MoveSpeed = Class.MoveSpeed;
+		Chaser.RotationSmoothing = Class.RotationSmoothing;
+		Chaser.HasLongAttack = Class.HasLongAttack;
+		Chaser.LongAttackCooldown = Class.LongAttackCooldown;
+		return Chaser;
+	}
+
+	CombatCore::FVec3 ToCore(const FVector& Vector)
+	{
+		return CombatCore::FVec3 { Vector.X, Vector.Y, Vector.Z };
+	}
+
+	FVector FromCore(const CombatCore::FVec3& Vector)
+	{
+		return FVector(Vector.X, Vector.Y, Vector.Z);
+	}
+
+	enum class EOutcome : uint8
+	{
+		Won,
+		Lost,
+		TimedOut
+	};
+
+	struct FResult
+	{
+		EOutcome Outcome = EOutcome::TimedOut;
+		float Duration = 0.0f;
+		int32 HitsDealt = 0;
+		int32 HitsTaken = 0;
+	};
+
+	/**
+	 * One fight, with nothing shared with any other - enemies are structure-of-arrays columns,
+	 * the player a handful of values, and no engine objects are touched while stepping.
+	 */
+	class FFight
+	{
+	public:
+		FFight(const FSettings& InSettings, const FClass& InPlayerClass, const TArray<FClass>& InEnemyClasses, int32 NumEnemies, int32 Seed)
+			: Settings(InSettings)
+			, PlayerClass(InPlayerClass)
+			, EnemyClasses(InEnemyClasses)
+		{
+			FRandomStream Random(Seed);
+			for (int32 Index = 0; Index < NumEnemies; ++Index)
+			{
+				float Angle = Random.FRandRange(0.0f, 2.0f * PI);
+				float Radius = Settings.SpawnRadius * FMath::Sqrt(Random.FRandRange(0.25f, 1.0f));
+				Locations.Add(FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0.0f) * Radius);
+				Yaws.Add(Random.FRandRange(-180.0f, 180.0f));
+				States.Add(CombatCore::EState::Idle);
+				ClassIndices.Add(Random.RandRange(0, EnemyClasses.Num() - 1));
+				ActionTimes.Add(0.0f);
+				HitLanded.Add(false);
+				LongAttackTimes.Add(-BIG_NUMBER);
+				Roles.Add(CombatCore::ESquadRole::None);
+				SquadOffsets.Add(CombatCore::FVec3 { 0.0f, 0.0f, 0.0f });
+				QuickHits.AddDefaulted();
+				Interruptable.Add(true);
+				HitsTaken.Add(0);
+			}
+			NumAlive = NumEnemies;
+		}
+
+		/** Advance one fixed step - false once the fight is over */
+		bool Step()
+		{
+			Now += Settings.Step;
+			if (SquadDirty || Now >= NextPlanTime)
+				PlanSquad();
+			StepPlayer();
+			StepEnemies();
+
+			if (NumAlive == 0)
+				Result.Outcome = EOutcome::Won;
+			else if (Result.HitsTaken >= Settings.PlayerHits)
+				Result.Outcome = EOutcome::Lost;
+			else if (Now < Settings.TimeLimit)
+				return true;
+
+			Result.Duration = Now;
+			return false;
+		}
+
+		const FResult& GetResult() const { return Result; }
+
+	private:
+		void StepPlayer()
+		{
+			const FCombatTuning& Tuning = PlayerClass.Tuning;
+
+			if (PlayerStumbling)
+			{
+				PlayerStumbling = Now - PlayerActionTime < Settings.StumbleDuration;
+				return;
+			}
+
+			if (PlayerAttacking)
+			{
+				if (!PlayerHitLanded && Now - PlayerActionTime >= Settings.AttackHitTime)
+				{
+					PlayerHitLanded = true;
+					if (States[PlayerTarget] != CombatCore::EState::Dead
+						&& FVector::Dist(Locations[PlayerTarget], PlayerLocation) <= Tuning.AttackRange + Tuning.LungeDistance)
+						HitEnemy(PlayerTarget);
+				}
+				PlayerAttacking = Now - PlayerActionTime < Settings.AttackDuration;
+				return;
+			}
+
+			// Keep the locked target until it drops or gets too far, then lock the closest
+			if (PlayerTarget == INDEX_NONE || States[PlayerTarget] == CombatCore::EState::Dead
+				|| FVector::Dist(Locations[PlayerTarget], PlayerLocation) >= Tuning.TargetLockDistance)
+			{
+				PlayerTarget = INDEX_NONE;
+				float ClosestSquared = MAX_flt;
+				for (int32 Index = 0; Index < Locations.Num(); ++Index)
+				{
+					const float DistanceSquared = FVector::DistSquared(Locations[Index], PlayerLocation);
+					if (States[Index] != CombatCore::EState::Dead && DistanceSquared < ClosestSquared)
+					{
+						PlayerTarget = Index;
+						ClosestSquared = DistanceSquared;
+					}
+				}
+			}
+
+			// Locked on: always facing the target
+			const FVector Offset = Locations[PlayerTarget] - PlayerLocation;
+			const float Distance = Offset.Size();
+			PlayerYaw = CombatCore::YawTowards(Offset.X, Offset.Y);
+			if (Distance > Tuning.AttackRange)
+			{
+				PlayerLocation += Offset.GetSafeNormal() * FMath::Min(PlayerClass.MoveSpeed * Settings.Step, Distance - Tuning.AttackRange);
+				return;
+			}
+
+			CombatCore::FActionState Action = {};
+			Action.Loaded = true;
+			if (CombatCore::CanAttack(Action))
+			{
+				PlayerAttacking = true;
+				PlayerHitLanded = false;
+				PlayerActionTime = Now;
+			}
+		}
+
+		/** Hand out squad roles to everyone fighting, as USquadSubsystem does for the actors */
+		void PlanSquad()
+		{
+			PlanIndices.Reset();
+			PlanMembers.Reset();
+			for (int32 Index = 0; Index < Locations.Num(); ++Index)
+			{
+				// Anyone not fighting (dead) drops out of the squad
+				const CombatCore::ESquadRole Role = Roles[Index];
+				Roles[Index] = CombatCore::ESquadRole::None;
+				if (States[Index] == CombatCore::EState::Idle || States[Index] == CombatCore::EState::Dead)
+					continue;
+
+				PlanIndices.Add(Index);
+				PlanMembers.Add(CombatCore::FSquadMember { ToCore(Locations[Index]), Role,
+					States[Index] == CombatCore::EState::Attack || States[Index] == CombatCore::EState::Stumble });
+			}
+
+			PlanRoles.SetNumUninitialized(PlanMembers.Num());
+			PlanOffsets.SetNumUninitialized(PlanMembers.Num());
+			CombatCore::PlanSquad(PlanMembers.GetData(), PlanMembers.Num(), ToCore(PlayerLocation), PlayerYaw,
+				Settings.Squad, PlanRoles.GetData(), PlanOffsets.GetData());
+
+			for (int32 Member = 0; Member < PlanIndices.Num(); ++Member)
+			{
+				Roles[PlanIndices[Member]] = PlanRoles[Member];
+				SquadOffsets[PlanIndices[Member]] = PlanOffsets[Member];
+			}
+
+			NextPlanTime = Now + Settings.ReplanInterval;
+			SquadDirty = false;
+		}
+
+		void StepEnemies()
+		{
+			// Rolls aren't simulated
+			const CombatCore::FChaseTarget Player = { ToCore(PlayerLocation), PlayerYaw, false, PlayerAttacking };
+
+			for (int32 Index = 0; Index < Locations.Num(); ++Index)
+			{
+				const FClass& Class = EnemyClasses[ClassIndices[Index]];
+				const CombatCore::FChaserClass ChaserClass = GetChaserClass(Class);
+				CombatCore::FChaser Chaser = { ToCore(Locations[Index]), Yaws[Index], LongAttackTimes[Index], Roles[Index], SquadOffsets[Index] };
+
+				switch (States[Index])
+				{
+					case CombatCore::EState::Idle:
+						States[Index] = CombatCore::IdleTransition(FVector::Dist(PlayerLocation, Locations[Index]), ChaserClass.Tuning, true);
+						// Joins the squad, as AEnemyBase::StateIdle does
+						SquadDirty |= States[Index] != CombatCore::EState::Idle;
+						break;
+
+					case CombatCore::EState::ChaseFar:
+						States[Index] = CombatCore::StepChaseFar(Chaser, ChaserClass, Player, Settings.Step);
+						break;
+
+					case CombatCore::EState::ChaseClose:
+						// Same step as the crowd entities, with no arena geometry to block the line of sight
+						States[Index] = CombatCore::StepChaseClose(Chaser, ChaserClass, Player, Now, Settings.Step, true);
+						if (States[Index] == CombatCore::EState::Attack)
+						{
+							ActionTimes[Index] = Now;
+							HitLanded[Index] = false;
+						}
+						break;
+
+					case CombatCore::EState::Taunt:
+						States[Index] = CombatCore::StepTaunt(Chaser, ChaserClass, Player, Settings.Step);
+						break;
+
+					case CombatCore::EState::Attack:
+						if (!HitLanded[Index] && Now - ActionTimes[Index] >= Settings.AttackHitTime)
+						{
+							HitLanded[Index] = true;
+							if (FVector::Dist(PlayerLocation, Locations[Index]) <= ChaserClass.Tuning.AttackRange + Class.Tuning.LungeDistance)
+								HitPlayer();
+						}
+						if (Now - ActionTimes[Index] >= Settings.AttackDuration)
+							States[Index] = CombatCore::EState::ChaseClose;
+						break;
+
+					case CombatCore::EState::Stumble:
+						States[Index] = CombatCore::StumbleTransition(Now - ActionTimes[Index] < Settings.StumbleDuration);
+						break;
+
+					default:
+						break;
+				}
+
+				Locations[Index] = FromCore(Chaser.Location);
+				Yaws[Index] = Chaser.Yaw;
+				LongAttackTimes[Index] = Chaser.LongAttackTime;
+			}
+		}
+
+		/** The player's damage window caught enemy Index */
+		void HitEnemy(int32 Index)
+		{
+			++Result.HitsDealt;
+			if (++HitsTaken[Index] >= Settings.EnemyHits)
+			{
+				States[Index] = CombatCore::EState::Dead;
+				--NumAlive;
+				SquadDirty = true;
+				return;
+			}
+
+			// Same as AEnemyKnight/AEnemyBase::TakeDamage: quick hits, then a stumble if still interruptable
+			if (EnemyClasses[ClassIndices[Index]].HasQuickHits)
+				Interruptable[Index] = CombatCore::TakeQuickHit(QuickHits[Index], Now, Interruptable[Index]);
+			if (!Interruptable[Index])
+				return;
+
+			const FVector Offset = PlayerLocation - Locations[Index];
+			States[Index] = CombatCore::EState::Stumble;
+			ActionTimes[Index] = Now;
+			Yaws[Index] = CombatCore::YawTowards(Offset.X, Offset.Y);
+		}
+
+		/** An enemy's damage window caught the player (rolls aren't simulated) */
+		void HitPlayer()
+		{
+			++Result.HitsTaken;
+			PlayerAttacking = false;
+			PlayerStumbling = true;
+			PlayerActionTime = Now;
+		}
+
+		const FSettings& Settings;
+		const FClass& PlayerClass;
+		const TArray<FClass>& EnemyClasses;
+
+		float Now = 0.0f;
+		FResult Result;
+
+		// Player stand-in
+		FVector PlayerLocation = FVector::ZeroVector;
+		float PlayerYaw = 0.0f;
+		int32 PlayerTarget = INDEX_NONE;
+		float PlayerActionTime = 0.0f;
+		bool PlayerAttacking = false;
+		bool PlayerHitLanded = false;
+		bool PlayerStumbling = false;
+
+		// Enemy columns
+		TArray<FVector> Locations;
+		TArray<float> Yaws;
+		TArray<CombatCore::EState> States;
+		TArray<int32> ClassIndices;
+		TArray<float> ActionTimes;			// Start of the current attack or stumble
+		TArray<bool> HitLanded;
+		TArray<float> LongAttackTimes;
+		TArray<CombatCore::FQuickHits> QuickHits;
+		TArray<bool> Interruptable;
+		TArray<int32> HitsTaken;
+		TArray<CombatCore::ESquadRole> Roles;
+		TArray<CombatCore::FVec3> SquadOffsets;
+		int32 NumAlive = 0;
+
+		// One squad, everyone fighting the player
+		float NextPlanTime = 0.0f;
+		bool SquadDirty = true;
+		TArray<int32> PlanIndices;
+		TArray<CombatCore::FSquadMember> PlanMembers;
+		TArray<CombatCore::ESquadRole> PlanRoles;
+		TArray<CombatCore::FVec3> PlanOffsets;
+	};
+}
+
+int32 UFightSimulationCommandlet::Main(const FString& Params)
+{
+	using namespace FightSimulation;
+
+	int32 NumFights = 1000;
+	int32 NumEnemies = 4;
+	int32 Seed = 0;
+	FSettings Settings;
+	FParse::Value(*Params, TEXT("Fights="), NumFights);
+	FParse::Value(*Params, TEXT("Enemies="), NumEnemies);
+	FParse::Value(*Params, TEXT("Seed="), Seed);
+	FParse::Value(*Params, TEXT("Step="), Settings.Step);
+	FParse::Value(*Params, TEXT("TimeLimit="), Settings.TimeLimit);
+	Settings.ReplanInterval = USquadSubsystem::GetReplanInterval();
+	Settings.Squad = USquadSubsystem::GetPlanSettings();
+	const bool SingleThread = FParse::Param(*Params, TEXT("SingleThread"));
+	if (NumFights < 1 || NumEnemies < 1 || Settings.Step <= 0.0f)
+	{
+		UE_LOG(LogCarbon, Error, TEXT("Usage: -run=FightSimulation [-Fights=1000] [-Enemies=4] [-EnemyClasses=<class>,<class>] [-Player=<class>] [-Step=0.0333] [-TimeLimit=120] [-Seed=0] [-SingleThread]"));
+		return 1;
+	}
+
+	// Classes are resolved up front - their defaults are all a fight reads
+	FString PlayerPath;
+	TSubclassOf<ACombatant> PlayerClass = ACarbonCharacter::StaticClass();
+	if (FParse::Value(*Params, TEXT("Player="), PlayerPath))
+		PlayerClass = LoadClass<ACombatant>(nullptr, *PlayerPath);
+
+	FString EnemyPaths;
+	TArray<TSubclassOf<ACombatant>> EnemyClasses;
+	if (FParse::Value(*Params, TEXT("EnemyClasses="), EnemyPaths, false))
+	{
+		TArray<FString> Paths;
+		EnemyPaths.ParseIntoArray(Paths, TEXT(","));
+		for (const FString& Path : Paths)
+			EnemyClasses.Add(LoadClass<AEnemyBase>(nullptr, *Path));
+	}
+	else
+		EnemyClasses.Add(AEnemyKnight::StaticClass());
+
+	if (!PlayerClass || EnemyClasses.Contains(nullptr))
+	{
+		UE_LOG(LogCarbon, Error, TEXT("Could not load the player or an enemy class"));
+		return 1;
+	}
+
+	const FClass Player = ReadClass(PlayerClass);
+	TArray<FClass> Enemies;
+	for (TSubclassOf<ACombatant> EnemyClass : EnemyClasses)
+		Enemies.Add(ReadClass(EnemyClass));
+
+	// Every fight is its own task, stepped to the end
+	TArray<FResult> Results;
+	Results.SetNum(NumFights);
+	const double StartTime = FPlatformTime::Seconds();
+	ParallelFor(NumFights, [&](int32 Index)
+	{
+		FFight Fight(Settings, Player, Enemies, NumEnemies, Seed + Index);
+		while (Fight.Step())
+		{
+		}
+		Results[Index] = Fight.GetResult();
+	}, SingleThread ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None);
+	const double WallTime = FMath::Max(FPlatformTime::Seconds() - StartTime, SMALL_NUMBER);
+
+	int32 Outcomes[3] = {};
+	double SimulatedTime = 0.0;
+	int64 HitsDealt = 0;
+	int64 HitsTaken = 0;
+	for (const FResult& Result : Results)
+	{
+		Outcomes[(int32)Result.Outcome]++;
+		SimulatedTime += Result.Duration;
+		HitsDealt += Result.HitsDealt;
+		HitsTaken += Result.HitsTaken;
+	}
+
+	UE_LOG(LogCarbon, Display, TEXT("%d fights of 1 vs %d (%s), %.1f Hz steps, %d worker threads"), NumFights, NumEnemies,
+		SingleThread ? TEXT("single thread") : TEXT("parallel"), 1.0f / Settings.Step, SingleThread ? 1 : FTaskGraphInterface::Get().GetNumWorkerThreads());
+	UE_LOG(LogCarbon, Display, TEXT("  Won %d, lost %d, timed out %d"), Outcomes[(int32)EOutcome::Won], Outcomes[(int32)EOutcome::Lost], Outcomes[(int32)EOutcome::TimedOut]);
+	UE_LOG(LogCarbon, Display, TEXT("  Average fight %.1f s, %.1f hits dealt, %.1f hits taken"),
+		SimulatedTime / NumFights, (double)HitsDealt / NumFights, (double)HitsTaken / NumFights);
+	UE_LOG(LogCarbon, Display, TEXT("  %.3f s wall time: %.0f fights/s, %.0fx real time"), WallTime, NumFights / WallTime, SimulatedTime / WallTime);
+
+	return 0;
+}
@@ -0,0 +1,28 @@
+// Sam Smith
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "FightSimulation.generated.h"
+
+/**
+ * Headless fight simulator for AI tuning and load tests.
+ *   -run=FightSimulation [-Fights=1000] [-Enemies=4] [-EnemyClasses=<class>,<class>] [-Player=<class>]
+ *     [-Step=0.0333] [-TimeLimit=120] [-Seed=0] [-SingleThread] -nullrhi
+ * Runs Fights independent fights of a player stand-in against Enemies enemies, each on its own
+ * task-graph task, stepped at a fixed rate with the same CombatCore rules (and class defaults,
+ * archetype tuning and action sets) the combatant actors use: utility scored chase actions,
+ * shared with the crowd entities, and squad roles planned like USquadSubsystem (carbon.Squad.*).
+ * Montages are replaced by fixed attack and stumble durations, and the game has no health yet,
+ * so a fight ends after a set number of hits.
+ * Reports the outcome split and aggregate fights per second.
+ */
+UCLASS()
+class UFightSimulationCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,202 @@
+// Sam Smith
+
+#include "HitFeedbackSubsystem.h"
+#include "Carbon.h"
+#include "Combatant.h"
+#include "CombatClock.h"
+#include "Camera/CameraShakeBase.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Components/AudioComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/WorldSettings.h"
+#include "Kismet/GameplayStatics.h"
+#include "Particles/ParticleSystemComponent.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Hit Feedback Played"), STAT_HitFeedbackPlayed, STATGROUP_Carbon);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Hit Feedback Dropped"), STAT_HitFeedbackDropped, STATGROUP_Carbon);
+
+static TAutoConsoleVariable<int32> CVarHitFeedbackMaxEffects(
+	TEXT("carbon.HitFeedback.MaxEffects"), 8,
+	TEXT("Hit sparks (and, separately, hit sounds) that can play at once. Read when the pools are created."));
+
+static TAutoConsoleVariable<float> CVarHitFeedbackShakeInterval(
+	TEXT("carbon.HitFeedback.ShakeInterval"), 0.1f,
+	TEXT("Minimum seconds between hit camera shakes."));
+
+static TAutoConsoleVariable<float> CVarHitFeedbackMaxShakeScale(
+	TEXT("carbon.HitFeedback.MaxShakeScale"), 2.0f,
+	TEXT("Largest shake scale when several hits land in one frame."));
+
+static TAutoConsoleVariable<float> CVarHitFeedbackHitStopDuration(
+	TEXT("carbon.HitFeedback.HitStopDuration"), 0.08f,
+	TEXT("Seconds a hit slows down the combatants involved (0 = no hit-stop)."));
+
+static TAutoConsoleVariable<float> CVarHitFeedbackHitStopScale(
+	TEXT("carbon.HitFeedback.HitStopScale"), 0.05f,
+	TEXT("Time scale of combatants during hit-stop."));
+
+void UHitFeedbackSubsystem::AddHit(ACombatant* Instigator, AActor* Victim, bool HitStopInstigator)
+{
+	if (!Instigator || !Victim)
+		return;
+
+	// Merge with this instigator's other hits on this victim this frame - each instigator keeps
+	// its own entry, so its own hit-stop
+	for (FPendingHit& Hit : PendingHits)
+	{
+		if (Hit.Instigator == Instigator && Hit.Victim == Victim)
+		{
+			Hit.Count++;
+			Hit.HitStopInstigator |= HitStopInstigator;
+			return;
+		}
+	}
+
+	PendingHits.Add({ Instigator, Victim, Victim->GetActorLocation(), 1, HitStopInstigator });
+}
+
+void UHitFeedbackSubsystem::CreatePools()
+{
+	UWorld* World = GetWorld();
+	AWorldSettings* Owner = World->GetWorldSettings();
+	int32 PoolSize = FMath::Max(1, CVarHitFeedbackMaxEffects.GetValueOnGameThread());
+
+	for (int32 Index = 0; Index < PoolSize; ++Index)
+	{
+		UParticleSystemComponent* Effect = NewObject<UParticleSystemComponent>(Owner);
+		Effect->bAutoActivate = false;
+		Effect->bAutoDestroy = false;
+		Effect->RegisterComponentWithWorld(World);
+		EffectPool.Add(Effect);
+
+		UAudioComponent* Sound = NewObject<UAudioComponent>(Owner);
+		Sound->bAutoActivate = false;
+		Sound->bAutoDestroy = false;
+		Sound->RegisterComponentWithWorld(World);
+		SoundPool.Add(Sound);
+	}
+}
+
+UParticleSystemComponent* UHitFeedbackSubsystem::AcquireEffect()
+{
+	for (int32 Tries = 0; Tries < EffectPool.Num(); ++Tries)
+	{
+		UParticleSystemComponent* Effect = EffectPool[NextEffect];
+		NextEffect = (NextEffect + 1) % EffectPool.Num();
+		if (!Effect->IsActive())
+			return Effect;
+	}
+	return nullptr;
+}
+
+UAudioComponent* UHitFeedbackSubsystem::AcquireSound()
+{
+	for (int32 Tries = 0; Tries < SoundPool.Num(); ++Tries)
+	{
+		UAudioComponent* Sound = SoundPool[NextSound];
+		NextSound = (NextSound + 1) % SoundPool.Num();
+		if (!Sound->IsPlaying())
+			return Sound;
+	}
+	return nullptr;
+}
+
+void UHitFeedbackSubsystem::Tick(float DeltaTime)
+{
+	if (PendingHits.Num() == 0)
+		return;
+
+	if (EffectPool.Num() == 0)
+		CreatePools();
+
+	UWorld* World = GetWorld();
+	APawn* Player = UGameplayStatics::GetPlayerPawn(World, 0);
+	int32 PlayerHits = 0;
+
+	UCombatClockSubsystem* Clock = World->GetSubsystem<UCombatClockSubsystem>();
+	const float HitStopDuration = CVarHitFeedbackHitStopDuration.GetValueOnGameThread();
+	const float HitStopScale = CVarHitFeedbackHitStopScale.GetValueOnGameThread();
+
+	for (const FPendingHit& Hit : PendingHits)
+	{
+		ACombatant* Instigator = Hit.Instigator.Get();
+		if (!Instigator)
+			continue;
+
+		if (Instigator == Player || Hit.Victim == Player)
+			PlayerHits += Hit.Count;
+
+		Clock->HitStop(Cast<ACombatant>(Hit.Victim.Get()), HitStopDuration, HitStopScale);
+		if (Hit.HitStopInstigator)
+			Clock->HitStop(Instigator, HitStopDuration, HitStopScale);
+
+		if (Instigator->HitSpark)
+		{
+			if (UParticleSystemComponent* Effect = AcquireEffect())
+			{
+				Effect->SetTemplate(Instigator->HitSpark);
+				Effect->SetWorldLocation(Hit.Location);
+				Effect->ActivateSystem(true);
+				INC_DWORD_STAT(STAT_HitFeedbackPlayed);
+			}
+			else
+				INC_DWORD_STAT(STAT_HitFeedbackDropped);
+		}
+
+		if (Instigator->HitSound)
+		{
+			if (UAudioComponent* Sound = AcquireSound())
+			{
+				Sound->SetSound(Instigator->HitSound);
+				Sound->SetWorldLocation(Hit.Location);
+				Sound->Play();
+				INC_DWORD_STAT(STAT_HitFeedbackPlayed);
+			}
+			else
+				INC_DWORD_STAT(STAT_HitFeedbackDropped);
+		}
+	}
+	PendingHits.Reset();
+
+	// One shake for every hit the player dealt or took this frame, scaled up a little per extra hit
+	ACombatant* PlayerCombatant = Cast<ACombatant>(Player);
+	float Now = World->GetTimeSeconds();
+	if (PlayerHits > 0 && PlayerCombatant && PlayerCombatant->GetHitCameraShake() && Now - LastShakeTime >= CVarHitFeedbackShakeInterval.GetValueOnGameThread())
+	{
+		if (APlayerController* Controller = Cast<APlayerController>(PlayerCombatant->GetController()))
+		{
+			float Scale = FMath::Min(1.0f + 0.25f * (PlayerHits - 1), CVarHitFeedbackMaxShakeScale.GetValueOnGameThread());
+			Controller->PlayerCameraManager->StartCameraShake(PlayerCombatant->GetHitCameraShake(), Scale);
+			LastShakeTime = Now;
+		}
+	}
+}
+
+void UHitFeedbackSubsystem::Deinitialize()
+{
+	for (UParticleSystemComponent* Effect : EffectPool)
+	{
+		if (Effect)
+			Effect->DestroyComponent();
+	}
+	for (UAudioComponent* Sound : SoundPool)
+	{
+		if (Sound)
+			Sound->DestroyComponent();
+	}
+	EffectPool.Empty();
+	SoundPool.Empty();
+
+	Super::Deinitialize();
+}
+
+ETickableTickType UHitFeedbackSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Always;
+}
+
+TStatId UHitFeedbackSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UHitFeedbackSubsystem, STATGROUP_Tickables);
+}
@@ -0,0 +1,68 @@
+// Sam Smith
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "HitFeedbackSubsystem.generated.h"
+
+class ACombatant;
+class UParticleSystemComponent;
+class UAudioComponent;
+
+/**
+ * Plays hit sparks, hit sounds and camera shakes for successful hits.
+ * Hits are queued and played once at the end of the frame, merged per instigator and victim,
+ * so a combo hitting several times in one frame produces one spark/sound per victim and at
+ * most one camera shake. Sparks and sounds play on small fixed pools of components created once,
+ * which also caps how many effects run at the same time (extra hits get no effect).
+ * Each hit also briefly freezes its victim (and, for melee hits, the attacker) through
+ * UCombatClockSubsystem, leaving everyone else at full speed.
+ */
+UCLASS()
+class CARBON_API UHitFeedbackSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	/** Queue feedback for Instigator's weapon hitting Victim (HitStopInstigator = false for hits from range) */
+	void AddHit(ACombatant* Instigator, AActor* Victim, bool HitStopInstigator = true);
+
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+private:
+	struct FPendingHit
+	{
+		TWeakObjectPtr<ACombatant> Instigator;
+		TWeakObjectPtr<AActor> Victim;
+		FVector Location;
+		int32 Count;
+		bool HitStopInstigator;
+	};
+
+	void CreatePools();
+
+	/** A pooled component that isn't playing, or null if all of them are */
+	UParticleSystemComponent* AcquireEffect();
+	UAudioComponent* AcquireSound();
+
+	TArray<FPendingHit> PendingHits;
+
+	UPROPERTY(Transient)
+	TArray<UParticleSystemComponent*> EffectPool;
+
+	UPROPERTY(Transient)
+	TArray<UAudioComponent*> SoundPool;
+
+	int32 NextEffect = 0;
+	int32 NextSound = 0;
+
+	float LastShakeTime = -BIG_NUMBER;
+};
@@ -0,0 +1,263 @@
+// Sam Smith
+
+#include "LockOnCamera.h"
+#include "Carbon.h"
+#include "Combatant.h"
+#include "CombatCore.h"
+#include "Engine/World.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "GameFramework/Controller.h"
+#include "GameFramework/SpringArmComponent.h"
+#include "Kismet/GameplayStatics.h"
+
+DECLARE_CYCLE_STAT(TEXT("Lock-On Camera"), STAT_LockOnCamera, STATGROUP_Carbon);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Lock-On Camera Probes"), STAT_LockOnCameraProbes, STATGROUP_Carbon);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Lock-On Camera Jerk"), STAT_LockOnCameraJerk, STATGROUP_Carbon);
+
+static TAutoConsoleVariable<float> CVarCameraJitterMs(
+	TEXT("carbon.Camera.JitterMs"), 0.0f,
+	TEXT("Stall each frame for a random 0 to JitterMs milliseconds, to measure camera smoothness under uneven frame times (not in shipping builds)."));
+
+static FAutoConsoleCommandWithWorldAndArgs CameraReportCommand(
+	TEXT("carbon.Camera.Report"),
+	TEXT("carbon.Camera.Report [reset] - log the player's lock-on camera jerk (RMS and peak) since the last reset"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		APawn* Player = World ? UGameplayStatics::GetPlayerPawn(World, 0) : nullptr;
+		ULockOnCameraComponent* Camera = Player ? Player->FindComponentByClass<ULockOnCameraComponent>() : nullptr;
+		if (!Camera)
+		{
+			UE_LOG(LogCarbon, Warning, TEXT("carbon.Camera.Report: the player has no lock-on camera"));
+			return;
+		}
+
+		UE_LOG(LogCarbon, Log, TEXT("Lock-on camera jerk: RMS %.0f, peak %.0f deg/s^3"), Camera->GetRmsJerk(), Camera->GetPeakJerk());
+		if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+			Camera->ResetMetrics();
+	}));
+
+ULockOnCameraComponent::ULockOnCameraComponent()
+{
+	// After movement, so the view frames this frame's positions (the arm is made to follow it)
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.TickGroup = TG_PostPhysics;
+
+	MinFramingDistance = 400.0f;
+	FramingPitch = -15.0f;
+	FramingBias = 0.5f;
+	ArmPerDistance = 0.25f;
+	MaxArmLength = 900.0f;
+	RotationStiffness = 6.0f;
+	ArmStiffness = 8.0f;
+	ProbeMoveThreshold = 5.0f;
+
+	Boom = nullptr;
+	LockedOn = false;
+	YawVelocity = 0.0f;
+	PitchVelocity = 0.0f;
+	ArmLength = 0.0f;
+	ArmVelocity = 0.0f;
+	DefaultArmLength = 0.0f;
+	DefaultCollisionTest = true;
+	ProbeLength = MAX_flt;
+	ProbedOrigin = FVector::ZeroVector;
+	ProbedTarget = FVector::ZeroVector;
+	ProbedCamera = FVector::ZeroVector;
+	LastRotation = FRotator::ZeroRotator;
+	LastAngularVelocity = FVector2D::ZeroVector;
+	LastAngularAcceleration = FVector2D::ZeroVector;
+	MetricFrames = 0;
+	LastJerk = 0.0f;
+	PeakJerk = 0.0f;
+	JerkSquaredSum = 0.0;
+	JerkSamples = 0;
+}
+
+void ULockOnCameraComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	Boom = GetOwner()->FindComponentByClass<USpringArmComponent>();
+	if (!Boom)
+	{
+		UE_LOG(LogCarbon, Warning, TEXT("%s has a lock-on camera but no spring arm"), *GetOwner()->GetName());
+		SetComponentTickEnabled(false);
+		return;
+	}
+
+	// Movement, then this, then the arm
+	if (ACharacter* Character = Cast<ACharacter>(GetOwner()))
+		AddTickPrerequisiteComponent(Character->GetCharacterMovement());
+	Boom->AddTickPrerequisiteComponent(this);
+}
+
+void ULockOnCameraComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	EndLockOn();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void ULockOnCameraComponent::BeginLockOn(const FRotator& ControlRotation)
+{
+	LockedOn = true;
+	YawVelocity = 0.0f;
+	PitchVelocity = 0.0f;
+	ArmVelocity = 0.0f;
+	ArmLength = Boom->TargetArmLength;
+	DefaultArmLength = Boom->TargetArmLength;
+	DefaultCollisionTest = Boom->bDoCollisionTest;
+	Boom->bDoCollisionTest = false;
+
+	ProbeHandle = FTraceHandle();
+	ProbeLength = MAX_flt;
+	ProbedOrigin = FVector(BIG_NUMBER);
+
+	LastRotation = ControlRotation;
+	MetricFrames = 0;
+}
+
+void ULockOnCameraComponent::EndLockOn()
+{
+	if (!LockedOn)
+		return;
+
+	LockedOn = false;
+	Boom->TargetArmLength = DefaultArmLength;
+	Boom->bDoCollisionTest = DefaultCollisionTest;
+	ProbeHandle = FTraceHandle();
+}
+
+void ULockOnCameraComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+#if !UE_BUILD_SHIPPING
+	const float JitterMs = CVarCameraJitterMs.GetValueOnGameThread();
+	if (JitterMs > 0.0f)
+		FPlatformProcess::Sleep(FMath::FRandRange(0.0f, JitterMs) * 0.001f);
+#endif
+
+	SCOPE_CYCLE_COUNTER(STAT_LockOnCamera);
+
+	ACombatant* Owner = Cast<ACombatant>(GetOwner());
+	ACombatant* Target = Owner ? Owner->GetTarget() : nullptr;
+	AController* Controller = Owner ? Owner->GetController() : nullptr;
+	if (!Target || !Owner->IsTargetLocked() || !Controller)
+	{
+		EndLockOn();
+		return;
+	}
+
+	FRotator Rotation = Controller->GetControlRotation();
+	if (!LockedOn)
+		BeginLockOn(Rotation);
+
+	// World time - the camera doesn't join in the owner's hit-stop
+	const float WorldDelta = GetWorld()->GetDeltaSeconds();
+	if (WorldDelta <= 0.0f)
+		return;
+
+	const FVector OwnerLocation = Owner->GetActorLocation();
+	const FVector TargetLocation = Target->GetActorLocation();
+	const FVector ToTarget = TargetLocation - OwnerLocation;
+	const float Distance = ToTarget.Size2D();
+
+	// Face the target from behind the owner, tilted towards its height (yaw is free up close,
+	// where the target would swing across the view)
+	const FRotator TargetRotation = ToTarget.Rotation();
+	float Yaw = Rotation.Yaw;
+	float Pitch = FRotator::NormalizeAxis(Rotation.Pitch);
+	float WantedYaw = Distance > MinFramingDistance ? TargetRotation.Yaw : Yaw;
+	float WantedPitch = FramingPitch + FRotator::NormalizeAxis(TargetRotation.Pitch) * FramingBias;
+
+	CombatCore::SpringDamp(Yaw, YawVelocity, Yaw + CombatCore::NormalizeAxis(WantedYaw - Yaw), RotationStiffness, WorldDelta);
+	CombatCore::SpringDamp(Pitch, PitchVelocity, WantedPitch, RotationStiffness, WorldDelta);
+	Rotation = FRotator(Pitch, Yaw, 0.0f);
+	Controller->SetControlRotation(Rotation);
+
+	// Pull back to fit both, but not through whatever the last probe found in the way
+	const float WantedArm = FMath::Min(DefaultArmLength + Distance * ArmPerDistance, MaxArmLength);
+	const FVector Origin = Boom->GetComponentLocation();
+	UpdateProbe(Target, Origin, Origin - Rotation.Vector() * WantedArm);
+
+	CombatCore::SpringDamp(ArmLength, ArmVelocity, FMath::Min(WantedArm, ProbeLength), ArmStiffness, WorldDelta);
+	// Never wait on the spring to leave geometry
+	ArmLength = FMath::Min(ArmLength, ProbeLength);
+	Boom->TargetArmLength = ArmLength;
+
+	UpdateMetrics(Rotation, WorldDelta);
+}
+
+void ULockOnCameraComponent::UpdateProbe(AActor* Target, const FVector& Origin, const FVector& CameraLocation)
+{
+	UWorld* World = GetWorld();
+
+	if (ProbeHandle.IsValid())
+	{
+		FTraceDatum Datum;
+		if (World->QueryTraceData(ProbeHandle, Datum))
+		{
+			ProbeHandle = FTraceHandle();
+			ProbeLength = Datum.OutHits.Num() > 0 && Datum.OutHits[0].bBlockingHit ? Datum.OutHits[0].Distance : MAX_flt;
+		}
+		else if (!World->IsTraceHandleValid(ProbeHandle, false))
+		{
+			// Result was dropped - sweep again
+			ProbeHandle = FTraceHandle();
+			ProbedOrigin = FVector(BIG_NUMBER);
+		}
+		else
+			return;
+	}
+
+	const float MaxMoveSquared = FMath::Square(ProbeMoveThreshold);
+	if (FVector::DistSquared(Origin, ProbedOrigin) <= MaxMoveSquared
+		&& FVector::DistSquared(Target->GetActorLocation(), ProbedTarget) <= MaxMoveSquared
+		&& FVector::DistSquared(CameraLocation, ProbedCamera) <= MaxMoveSquared)
+		return;
+
+	ProbedOrigin = Origin;
+	ProbedTarget = Target->GetActorLocation();
+	ProbedCamera = CameraLocation;
+
+	FCollisionQueryParams Params(SCENE_QUERY_STAT(LockOnCameraProbe), false, GetOwner());
+	Params.AddIgnoredActor(Target);
+	ProbeHandle = World->AsyncSweepByChannel(EAsyncTraceType::Single, Origin, CameraLocation, FQuat::Identity,
+		Boom->ProbeChannel, FCollisionShape::MakeSphere(Boom->ProbeSize), Params);
+	INC_DWORD_STAT(STAT_LockOnCameraProbes);
+}
+
+void ULockOnCameraComponent::UpdateMetrics(const FRotator& Rotation, float DeltaTime)
+{
+	// Finite differences of the view's yaw and pitch - jerk needs three frames of history
+	FVector2D AngularVelocity(FRotator::NormalizeAxis(Rotation.Yaw - LastRotation.Yaw), FRotator::NormalizeAxis(Rotation.Pitch - LastRotation.Pitch));
+	AngularVelocity /= DeltaTime;
+	FVector2D AngularAcceleration = (AngularVelocity - LastAngularVelocity) / DeltaTime;
+
+	if (MetricFrames >= 2)
+	{
+		LastJerk = ((AngularAcceleration - LastAngularAcceleration) / DeltaTime).Size();
+		PeakJerk = FMath::Max(PeakJerk, LastJerk);
+		JerkSquaredSum += FMath::Square((double)LastJerk);
+		++JerkSamples;
+		SET_FLOAT_STAT(STAT_LockOnCameraJerk, LastJerk);
+	}
+
+	LastRotation = Rotation;
+	LastAngularVelocity = AngularVelocity;
+	LastAngularAcceleration = AngularAcceleration;
+	++MetricFrames;
+}
+
+float ULockOnCameraComponent::GetRmsJerk() const
+{
+	return JerkSamples > 0 ? (float)FMath::Sqrt(JerkSquaredSum / JerkSamples) : 0.0f;
+}
+
+void ULockOnCameraComponent::ResetMetrics()
+{
+	PeakJerk = 0.0f;
+	JerkSquaredSum = 0.0;
+	JerkSamples = 0;
+}
@@ -0,0 +1,121 @@
+// Sam Smith
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "WorldCollision.h"
+#include "LockOnCamera.generated.h"
+
+class USpringArmComponent;
+
+/**
+ * Camera for a combatant locked on to a target, updated after movement so it frames where
+ * both ended up this frame. Control rotation and the owner's spring arm length follow
+ * critically damped springs towards a view of the owner and the target, stepped with world
+ * (not hit-stop) time.
+ * While locked, the spring arm's own collision test is off: occlusion by arena geometry is
+ * one async sweep (the arm's probe size and channel) whose result, a frame old, caps the arm
+ * length - and no sweep is made while the owner, the target and the camera all stay put.
+ * Lock-on camera angular jerk is tracked per frame, see carbon.Camera.Report.
+ */
+UCLASS(ClassGroup = (Carbon), meta = (BlueprintSpawnableComponent))
+class CARBON_API ULockOnCameraComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	ULockOnCameraComponent();
+
+	/** Closer than this (horizontally) the yaw is left to the player */
+	UPROPERTY(EditAnywhere, Category = "Camera")
+	float MinFramingDistance;
+
+	/** Pitch of the view, plus FramingBias of the pitch towards the target */
+	UPROPERTY(EditAnywhere, Category = "Camera")
+	float FramingPitch;
+
+	/** How much the view tilts towards a target above or below */
+	UPROPERTY(EditAnywhere, Category = "Camera")
+	float FramingBias;
+
+	/** Arm length added per unit of distance to the target, to keep both in frame */
+	UPROPERTY(EditAnywhere, Category = "Camera")
+	float ArmPerDistance;
+
+	UPROPERTY(EditAnywhere, Category = "Camera")
+	float MaxArmLength;
+
+	/** Spring stiffness of the view rotation (settles in about 4 / stiffness seconds) */
+	UPROPERTY(EditAnywhere, Category = "Camera")
+	float RotationStiffness;
+
+	/** Spring stiffness of the arm length */
+	UPROPERTY(EditAnywhere, Category = "Camera")
+	float ArmStiffness;
+
+	/** The occlusion sweep is only repeated once the owner, target or camera moved this far */
+	UPROPERTY(EditAnywhere, Category = "Camera")
+	float ProbeMoveThreshold;
+
+	bool IsLockedOn() const { return LockedOn; }
+
+	/** Angular jerk of the view this frame, in degrees per second cubed */
+	float GetJerk() const { return LastJerk; }
+
+	/** Root mean square and peak jerk since the last ResetMetrics */
+	float GetRmsJerk() const;
+	float GetPeakJerk() const { return PeakJerk; }
+
+	void ResetMetrics();
+
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+protected:
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	void BeginLockOn(const FRotator& ControlRotation);
+
+	/** Hand the camera back to the player and the spring arm */
+	void EndLockOn();
+
+	/** Collect the last sweep's result, and sweep again if anything moved since it was made */
+	void UpdateProbe(AActor* Target, const FVector& Origin, const FVector& CameraLocation);
+
+	void UpdateMetrics(const FRotator& Rotation, float DeltaTime);
+
+	UPROPERTY(Transient)
+	USpringArmComponent* Boom;
+
+	bool LockedOn;
+
+	// Spring state
+	float YawVelocity;
+	float PitchVelocity;
+	float ArmLength;
+	float ArmVelocity;
+
+	/** Spring arm settings restored when the lock ends */
+	float DefaultArmLength;
+	bool DefaultCollisionTest;
+
+	// Occlusion probe
+	FTraceHandle ProbeHandle;
+	float ProbeLength;			// Unblocked arm length found by the last sweep
+	FVector ProbedOrigin;
+	FVector ProbedTarget;
+	FVector ProbedCamera;
+
+	// Jerk
+	FRotator LastRotation;
+	FVector2D LastAngularVelocity;
+	FVector2D LastAngularAcceleration;
+	int32 MetricFrames;
+	float LastJerk;
+	float PeakJerk;
+	double JerkSquaredSum;
+	int32 JerkSamples;
+};
@@ -0,0 +1,288 @@
+// Sam Smith
+
+#include "ProjectileSubsystem.h"
+#include "Carbon.h"
+#include "CombatantRegistry.h"
+#include "CombatEventLog.h"
+#include "CombatTelemetry.h"
+#include "HitFeedbackSubsystem.h"
+#include "Components/InstancedStaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+#include "GameFramework/DamageType.h"
+#include "GameFramework/WorldSettings.h"
+#include "Kismet/GameplayStatics.h"
+
+DECLARE_CYCLE_STAT(TEXT("Projectile Simulation"), STAT_ProjectileSimulation, STATGROUP_Carbon);
+DECLARE_CYCLE_STAT(TEXT("Projectile Visuals"), STAT_ProjectileVisuals, STATGROUP_Carbon);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Projectiles"), STAT_Projectiles, STATGROUP_Carbon);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Projectile Sweeps"), STAT_ProjectileSweeps, STATGROUP_Carbon);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Projectiles Dropped"), STAT_ProjectilesDropped, STATGROUP_Carbon);
+
+static TAutoConsoleVariable<int32> CVarProjectileMax(
+	TEXT("carbon.Projectile.Max"), 4096,
+	TEXT("Most projectiles alive at once (read when the world starts)."));
+
+static TAutoConsoleVariable<int32> CVarProjectileAsync(
+	TEXT("carbon.Projectile.Async"), 1,
+	TEXT("1: sweep projectiles with async traces (hits land a frame later), 0: sweep on the game thread."));
+
+static FAutoConsoleCommandWithWorldAndArgs ProjectileSprayCommand(
+	TEXT("carbon.Projectile.Spray"),
+	TEXT("carbon.Projectile.Spray [Count] - fire Count harmless projectiles in random directions from the player"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		UProjectileSubsystem* Projectiles = World ? World->GetSubsystem<UProjectileSubsystem>() : nullptr;
+		APawn* Player = World ? UGameplayStatics::GetPlayerPawn(World, 0) : nullptr;
+		if (!Projectiles || !Player)
+			return;
+
+		FProjectileType Type;
+		Type.Damage = 0.0f;
+		int32 Count = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000;
+		for (int32 Index = 0; Index < Count; ++Index)
+		{
+			FVector Direction = FMath::VRand();
+			Direction.Z = FMath::Abs(Direction.Z) * 0.25f;
+			Projectiles->Fire(Cast<ACombatant>(Player), Type, Player->GetActorLocation(), Direction);
+		}
+	}));
+
+void UProjectileSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	// Preallocated, so firing never allocates
+	int32 Max = CVarProjectileMax.GetValueOnGameThread();
+	Locations.Reserve(Max);
+	Velocities.Reserve(Max);
+	SweepStarts.Reserve(Max);
+	SweepEnds.Reserve(Max);
+	GravityZ.Reserve(Max);
+	ExpireTimes.Reserve(Max);
+	Damages.Reserve(Max);
+	Radii.Reserve(Max);
+	Instigators.Reserve(Max);
+	VisualIndices.Reserve(Max);
+	TraceHandles.Reserve(Max);
+}
+
+void UProjectileSubsystem::Deinitialize()
+{
+	for (UInstancedStaticMeshComponent* Visual : Visuals)
+	{
+		if (Visual)
+			Visual->DestroyComponent();
+	}
+	Visuals.Empty();
+	VisualIndexByMesh.Empty();
+
+	Super::Deinitialize();
+}
+
+void UProjectileSubsystem::Fire(ACombatant* Instigator, const FProjectileType& Type, const FVector& Origin, const FVector& Direction)
+{
+	if (Locations.Num() >= CVarProjectileMax.GetValueOnGameThread())
+	{
+		INC_DWORD_STAT(STAT_ProjectilesDropped);
+		return;
+	}
+
+	Locations.Add(Origin);
+	Velocities.Add(Direction.GetSafeNormal() * Type.Speed);
+	SweepStarts.Add(Origin);
+	SweepEnds.Add(Origin);
+	GravityZ.Add(GetWorld()->GetGravityZ() * Type.GravityScale);
+	ExpireTimes.Add(GetWorld()->GetTimeSeconds() + Type.Lifetime);
+	Damages.Add(Type.Damage);
+	Radii.Add(Type.Radius);
+	Instigators.Add(ACombatant::GetHandleOf(Instigator));
+	VisualIndices.Add(Type.Mesh ? GetVisualIndex(Type.Mesh) : INDEX_NONE);
+	TraceHandles.AddDefaulted();
+}
+
+void UProjectileSubsystem::RemoveProjectile(int32 Index)
+{
+	Locations.RemoveAtSwap(Index, 1, false);
+	Velocities.RemoveAtSwap(Index, 1, false);
+	SweepStarts.RemoveAtSwap(Index, 1, false);
+	SweepEnds.RemoveAtSwap(Index, 1, false);
+	GravityZ.RemoveAtSwap(Index, 1, false);
+	ExpireTimes.RemoveAtSwap(Index, 1, false);
+	Damages.RemoveAtSwap(Index, 1, false);
+	Radii.RemoveAtSwap(Index, 1, false);
+	Instigators.RemoveAtSwap(Index, 1, false);
+	VisualIndices.RemoveAtSwap(Index, 1, false);
+	TraceHandles.RemoveAtSwap(Index, 1, false);
+}
+
+void UProjectileSubsystem::ApplyHit(int32 Index, const FHitResult& Hit)
+{
+	AActor* Victim = Hit.GetActor();
+	ACombatant* Instigator = GetWorld()->GetSubsystem<UCombatantRegistry>()->Resolve(Instigators[Index]);
+	// A projectile whose instigator has gone hits nothing - damage always needs a causer
+	if (!Victim || !Instigator || Victim == Instigator)
+		return;
+
+	float AppliedDamage = UGameplayStatics::ApplyPointDamage(Victim, Damages[Index], Velocities[Index].GetSafeNormal(), Hit,
+		Instigator->GetController(), Instigator, UDamageType::StaticClass());
+	if (AppliedDamage > 0.0f)
+	{
+		COMBAT_TELEMETRY_ADD(Instigator->GetTelemetry(), HitsApplied, 1);
+		COMBAT_EVENT(HIT, Instigator, Victim, AppliedDamage);
+		GetWorld()->GetSubsystem<UHitFeedbackSubsystem>()->AddHit(Instigator, Victim, false);
+	}
+}
+
+void UProjectileSubsystem::Tick(float DeltaTime)
+{
+	{
+		SCOPE_CYCLE_COUNTER(STAT_ProjectileSimulation);
+
+		UWorld* World = GetWorld();
+		const float Now = World->GetTimeSeconds();
+		const bool Async = CVarProjectileAsync.GetValueOnGameThread() != 0;
+
+		// Hits found by last frame's sweeps (and expiry) end projectiles - backwards, as rows are swapped out
+		for (int32 Index = Locations.Num() - 1; Index >= 0; --Index)
+		{
+			bool Ended = Now >= ExpireTimes[Index];
+
+			if (TraceHandles[Index].IsValid())
+			{
+				FTraceDatum Datum;
+				if (World->QueryTraceData(TraceHandles[Index], Datum))
+				{
+					TraceHandles[Index] = FTraceHandle();
+					SweepStarts[Index] = SweepEnds[Index];
+					if (Datum.OutHits.Num() > 0 && Datum.OutHits[0].bBlockingHit)
+					{
+						ApplyHit(Index, Datum.OutHits[0]);
+						Ended = true;
+					}
+				}
+				else if (!World->IsTraceHandleValid(TraceHandles[Index], false))
+				{
+					// Result was dropped - SweepStarts wasn't advanced, so the whole stretch is swept again
+					TraceHandles[Index] = FTraceHandle();
+				}
+			}
+
+			if (Ended)
+				RemoveProjectile(Index);
+		}
+
+		// Move everything in one pass over the columns
+		const int32 Num = Locations.Num();
+		for (int32 Index = 0; Index < Num; ++Index)
+		{
+			Velocities[Index].Z += GravityZ[Index] * DeltaTime;
+			Locations[Index] += Velocities[Index] * DeltaTime;
+		}
+
+		// Sweep from where the last sweep ended - projectiles still waiting on a result keep
+		// accumulating distance and sweep it all next time
+		FCollisionObjectQueryParams ObjectParams;
+		ObjectParams.AddObjectTypesToQuery(ECC_WorldStatic);
+		ObjectParams.AddObjectTypesToQuery(ECC_WorldDynamic);
+		ObjectParams.AddObjectTypesToQuery(ECC_Pawn);
+		UCombatantRegistry* Registry = World->GetSubsystem<UCombatantRegistry>();
+
+		for (int32 Index = Locations.Num() - 1; Index >= 0; --Index)
+		{
+			if (TraceHandles[Index].IsValid())
+				continue;
+
+			FCollisionQueryParams Params(SCENE_QUERY_STAT(ProjectileSweep));
+			if (ACombatant* Instigator = Registry->Resolve(Instigators[Index]))
+				Params.AddIgnoredActor(Instigator);
+			FCollisionShape Shape = FCollisionShape::MakeSphere(Radii[Index]);
+			INC_DWORD_STAT(STAT_ProjectileSweeps);
+
+			if (Async)
+			{
+				// SweepStarts only advances once the result is consumed
+				TraceHandles[Index] = World->AsyncSweepByObjectType(EAsyncTraceType::Single, SweepStarts[Index], Locations[Index],
+					FQuat::Identity, ObjectParams, Shape, Params);
+				SweepEnds[Index] = Locations[Index];
+				continue;
+			}
+
+			FHitResult Hit;
+			if (World->SweepSingleByObjectType(Hit, SweepStarts[Index], Locations[Index], FQuat::Identity, ObjectParams, Shape, Params))
+			{
+				ApplyHit(Index, Hit);
+				RemoveProjectile(Index);
+				continue;
+			}
+			SweepStarts[Index] = Locations[Index];
+		}
+
+		SET_DWORD_STAT(STAT_Projectiles, Locations.Num());
+	}
+
+	UpdateVisuals();
+}
+
+int32 UProjectileSubsystem::GetVisualIndex(UStaticMesh* Mesh)
+{
+	if (const int32* Index = VisualIndexByMesh.Find(Mesh))
+		return *Index;
+
+	UWorld* World = GetWorld();
+	UInstancedStaticMeshComponent* Visual = NewObject<UInstancedStaticMeshComponent>(World->GetWorldSettings());
+	Visual->SetStaticMesh(Mesh);
+	Visual->SetMobility(EComponentMobility::Movable);
+	Visual->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Visual->SetCastShadow(false);
+	Visual->RegisterComponentWithWorld(World);
+
+	int32 Index = Visuals.Add(Visual);
+	VisualTransforms.AddDefaulted();
+	VisualIndexByMesh.Add(Mesh, Index);
+	return Index;
+}
+
+void UProjectileSubsystem::UpdateVisuals()
+{
+	SCOPE_CYCLE_COUNTER(STAT_ProjectileVisuals);
+
+	for (TArray<FTransform>& Transforms : VisualTransforms)
+		Transforms.Reset();
+
+	for (int32 Index = 0; Index < Locations.Num(); ++Index)
+	{
+		if (VisualIndices[Index] != INDEX_NONE)
+			VisualTransforms[VisualIndices[Index]].Emplace(Velocities[Index].ToOrientationQuat(), Locations[Index]);
+	}
+
+	for (int32 VisualIndex = 0; VisualIndex < Visuals.Num(); ++VisualIndex)
+	{
+		UInstancedStaticMeshComponent* Visual = Visuals[VisualIndex];
+		TArray<FTransform>& Transforms = VisualTransforms[VisualIndex];
+		const int32 NumInstances = Visual->GetInstanceCount();
+		if (Transforms.Num() == 0 && NumInstances == 0)
+			continue;
+
+		// Spare instances are parked at zero scale instead of removed
+		const int32 NumUsed = Transforms.Num();
+		Transforms.SetNum(FMath::Max(NumUsed, NumInstances));
+		for (int32 Index = NumUsed; Index < Transforms.Num(); ++Index)
+			Transforms[Index] = FTransform(FQuat::Identity, FVector::ZeroVector, FVector::ZeroVector);
+
+		// Instances only grow (rarely), after which every instance is written in one batch
+		if (Transforms.Num() > NumInstances)
+			Visual->AddInstances(TArray<FTransform>(Transforms.GetData() + NumInstances, Transforms.Num() - NumInstances), false);
+		Visual->BatchUpdateInstancesTransforms(0, Transforms, true, true, true);
+	}
+}
+
+ETickableTickType UProjectileSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Always;
+}
+
+TStatId UProjectileSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UProjectileSubsystem, STATGROUP_Tickables);
+}
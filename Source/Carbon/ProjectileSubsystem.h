@@ -0,0 +1,106 @@
+// Sam Smith
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "WorldCollision.h"
+#include "Combatant.h"
+#include "ProjectileSubsystem.generated.h"
+
+class UStaticMesh;
+class UInstancedStaticMeshComponent;
+
+/** How one kind of projectile flies and hurts */
+USTRUCT(BlueprintType)
+struct CARBON_API FProjectileType
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Projectile")
+	float Speed = 2500.0f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Projectile")
+	float Damage = 1.0f;
+
+	/** Radius of the swept sphere */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Projectile")
+	float Radius = 8.0f;
+
+	/** Seconds before it disappears without hitting anything */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Projectile")
+	float Lifetime = 3.0f;
+
+	/** Multiplier of world gravity (0 = flies straight) */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Projectile")
+	float GravityScale = 0.0f;
+
+	/** Drawn as an instance of this mesh, pointing along the velocity (optional) */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Projectile")
+	UStaticMesh* Mesh = nullptr;
+};
+
+/**
+ * Every projectile in the world, as rows of structure-of-arrays columns rather than actors.
+ * Projectiles are moved in one pass per frame, then each swept (async by default, see
+ * carbon.Projectile.Async) from where its last sweep ended to where it is now, so nothing
+ * tunnels even though async results arrive a frame later. A blocking hit ends the projectile
+ * and damages the actor hit through TakeDamage (ApplyPointDamage).
+ * Columns are preallocated for carbon.Projectile.Max projectiles, further shots are dropped.
+ * Projectiles are drawn by one instanced static mesh component per mesh, whose instances are
+ * kept (scaled to zero) when projectiles end, so they are only ever added.
+ */
+UCLASS()
+class CARBON_API UProjectileSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	/** Launch a projectile of Type from Origin along Direction, fired by Instigator (may be null) */
+	void Fire(ACombatant* Instigator, const FProjectileType& Type, const FVector& Origin, const FVector& Direction);
+
+	int32 GetNumProjectiles() const { return Locations.Num(); }
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	virtual void Deinitialize() override;
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+private:
+	/** Apply Hit from projectile Index's sweep */
+	void ApplyHit(int32 Index, const FHitResult& Hit);
+
+	void RemoveProjectile(int32 Index);
+
+	/** Index into Visuals for Mesh, creating its component on first use */
+	int32 GetVisualIndex(UStaticMesh* Mesh);
+
+	void UpdateVisuals();
+
+	// Columns - one row per live projectile
+	TArray<FVector> Locations;
+	TArray<FVector> Velocities;
+	TArray<FVector> SweepStarts;		// Where the last consumed sweep ended
+	TArray<FVector> SweepEnds;			// Where the pending async sweep ends
+	TArray<float> GravityZ;
+	TArray<float> ExpireTimes;
+	TArray<float> Damages;
+	TArray<float> Radii;
+	TArray<FCombatantHandle> Instigators;
+	TArray<int32> VisualIndices;		// INDEX_NONE = not drawn
+	TArray<FTraceHandle> TraceHandles;	// Pending async sweep (if any)
+
+	UPROPERTY(Transient)
+	TArray<UInstancedStaticMeshComponent*> Visuals;
+
+	TMap<UStaticMesh*, int32> VisualIndexByMesh;
+
+	/** Reused every frame: instance transforms per visual */
+	TArray<TArray<FTransform>> VisualTransforms;
+};
@@ -0,0 +1,183 @@
+// Sam Smith
+
+#include "SquadSubsystem.h"
+#include "Carbon.h"
+#include "EnemyBase.h"
+#include "Engine/World.h"
+
+DECLARE_CYCLE_STAT(TEXT("Squad Planning"), STAT_SquadPlanning, STATGROUP_Carbon);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Squad Members Planned"), STAT_SquadMembersPlanned, STATGROUP_Carbon);
+
+static TAutoConsoleVariable<float> CVarSquadReplanInterval(
+	TEXT("carbon.Squad.ReplanInterval"), 0.5f,
+	TEXT("Seconds between role assignments for each squad."));
+
+static TAutoConsoleVariable<int32> CVarSquadMembersPerFrame(
+	TEXT("carbon.Squad.MembersPerFrame"), 32,
+	TEXT("Squad members planned per frame (at least one squad is always planned when due)."));
+
+static TAutoConsoleVariable<int32> CVarSquadAttackers(
+	TEXT("carbon.Squad.Attackers"), 2,
+	TEXT("Enemies per squad allowed to attack at once."));
+
+static TAutoConsoleVariable<int32> CVarSquadFlankers(
+	TEXT("carbon.Squad.Flankers"), 2,
+	TEXT("Enemies per squad holding flank positions."));
+
+static TAutoConsoleVariable<int32> CVarSquadTaunters(
+	TEXT("carbon.Squad.Taunters"), 1,
+	TEXT("Enemies per squad taunting (only once there are waiters to spare)."));
+
+static TAutoConsoleVariable<float> CVarSquadFlankRadius(
+	TEXT("carbon.Squad.FlankRadius"), 450.0f,
+	TEXT("Distance from the target flankers hold at."));
+
+static TAutoConsoleVariable<float> CVarSquadAttackerBonus(
+	TEXT("carbon.Squad.AttackerBonus"), 200.0f,
+	TEXT("Current attackers are treated as this much closer, so roles don't swap back and forth."));
+
+static_assert((uint8)ESquadRole::TAUNTER == (uint8)CombatCore::ESquadRole::Taunter, "ESquadRole must mirror CombatCore::ESquadRole");
+
+CombatCore::FSquadSettings USquadSubsystem::GetPlanSettings()
+{
+	CombatCore::FSquadSettings Settings;
+	Settings.Attackers = CVarSquadAttackers.GetValueOnGameThread();
+	Settings.Flankers = CVarSquadFlankers.GetValueOnGameThread();
+	Settings.Taunters = CVarSquadTaunters.GetValueOnGameThread();
+	Settings.FlankRadius = CVarSquadFlankRadius.GetValueOnGameThread();
+	Settings.AttackerBonus = CVarSquadAttackerBonus.GetValueOnGameThread();
+	return Settings;
+}
+
+float USquadSubsystem::GetReplanInterval()
+{
+	return CVarSquadReplanInterval.GetValueOnGameThread();
+}
+
+void USquadSubsystem::Join(AEnemyBase* Enemy, AActor* Target)
+{
+	if (!Enemy || !Target)
+		return;
+
+	for (FSquad& Squad : Squads)
+	{
+		if (Squad.Target == Target)
+		{
+			if (!Squad.Members.Contains(Enemy))
+			{
+				Leave(Enemy);
+				Squad.Members.Add(Enemy);
+				Squad.Dirty = true;
+			}
+			return;
+		}
+	}
+
+	Leave(Enemy);
+	FSquad& Squad = Squads.AddDefaulted_GetRef();
+	Squad.Target = Target;
+	Squad.Members.Add(Enemy);
+}
+
+void USquadSubsystem::Leave(AEnemyBase* Enemy)
+{
+	for (FSquad& Squad : Squads)
+	{
+		if (Squad.Members.RemoveSwap(Enemy) > 0)
+		{
+			Squad.Dirty = true;
+			break;
+		}
+	}
+
+	if (Enemy)
+		Enemy->SetSquadRole(ESquadRole::NONE, FVector::ZeroVector);
+}
+
+void USquadSubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_SquadPlanning);
+
+	float Now = GetWorld()->GetTimeSeconds();
+	float Interval = GetReplanInterval();
+	int32 Budget = CVarSquadMembersPerFrame.GetValueOnGameThread();
+
+	// Round robin over squads - due squads are planned until this frame's member budget is spent
+	for (int32 Visited = 0; Visited < Squads.Num() && Budget > 0; ++Visited)
+	{
+		NextSquad = NextSquad % Squads.Num();
+		FSquad& Squad = Squads[NextSquad];
+
+		if (!Squad.Target.IsValid() || Squad.Members.Num() == 0)
+		{
+			for (const TWeakObjectPtr<AEnemyBase>& Member : Squad.Members)
+			{
+				if (AEnemyBase* Enemy = Member.Get())
+					Enemy->SetSquadRole(ESquadRole::NONE, FVector::ZeroVector);
+			}
+			Squads.RemoveAtSwap(NextSquad);
+			continue;
+		}
+
+		if (Squad.Dirty || Now - Squad.PlanTime >= Interval)
+		{
+			Plan(Squad);
+			Squad.PlanTime = Now;
+			Squad.Dirty = false;
+			Budget -= Squad.Members.Num();
+			INC_DWORD_STAT_BY(STAT_SquadMembersPlanned, Squad.Members.Num());
+		}
+		NextSquad++;
+	}
+}
+
+void USquadSubsystem::Plan(FSquad& Squad)
+{
+	AActor* Target = Squad.Target.Get();
+
+	// Members that died, switched target or dropped out of combat leave the squad
+	Squad.Members.RemoveAllSwap([Target](const TWeakObjectPtr<AEnemyBase>& Member)
+	{
+		AEnemyBase* Enemy = Member.Get();
+		if (Enemy && Enemy->GetTarget() == Target && Enemy->ActiveState != State::IDLE && Enemy->ActiveState != State::DEAD)
+			return false;
+
+		if (Enemy)
+			Enemy->SetSquadRole(ESquadRole::NONE, FVector::ZeroVector);
+		return true;
+	});
+
+	// Same planner as the fight simulator, on plain copies of the members
+	const int32 NumMembers = Squad.Members.Num();
+	PlanMembers.SetNumUninitialized(NumMembers, false);
+	PlanRoles.SetNumUninitialized(NumMembers, false);
+	PlanOffsets.SetNumUninitialized(NumMembers, false);
+	for (int32 Index = 0; Index < NumMembers; ++Index)
+	{
+		AEnemyBase* Enemy = Squad.Members[Index].Get();
+		const FVector Location = Enemy->GetActorLocation();
+		PlanMembers[Index].Location = { Location.X, Location.Y, Location.Z };
+		PlanMembers[Index].Role = (CombatCore::ESquadRole)Enemy->GetSquadRole();
+		PlanMembers[Index].Committed = Enemy->ActiveState == State::ATTACK || Enemy->ActiveState == State::STUMBLE;
+	}
+
+	const FVector TargetLocation = Target->GetActorLocation();
+	CombatCore::PlanSquad(PlanMembers.GetData(), NumMembers, { TargetLocation.X, TargetLocation.Y, TargetLocation.Z },
+		Target->GetActorRotation().Yaw, GetPlanSettings(), PlanRoles.GetData(), PlanOffsets.GetData());
+
+	for (int32 Index = 0; Index < NumMembers; ++Index)
+	{
+		const CombatCore::FVec3& Offset = PlanOffsets[Index];
+		Squad.Members[Index]->SetSquadRole((ESquadRole)PlanRoles[Index], FVector(Offset.X, Offset.Y, Offset.Z));
+	}
+}
+
+ETickableTickType USquadSubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Always;
+}
+
+TStatId USquadSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(USquadSubsystem, STATGROUP_Tickables);
+}
@@ -0,0 +1,77 @@
+// Sam Smith
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "CombatCore.h"
+#include "SquadSubsystem.generated.h"
+
+class AEnemyBase;
+
+/** Mirrors CombatCore::ESquadRole value for value */
+UENUM(BlueprintType)
+enum class ESquadRole : uint8
+{
+	NONE,					// Not in a squad (or not planned yet) - fights alone
+	ATTACKER,				// Allowed to close in and attack
+	FLANKER,				// Holds a slot beside the target, strikes when it turns away
+	WAITER,					// Holds back in CHASE_FAR until given a slot
+	TAUNTER					// Holds back and taunts the target
+};
+
+/**
+ * Groups enemies by the target they are fighting and hands out roles, so only a few
+ * of them commit to attacks at once.
+ * Squads are replanned every carbon.Squad.ReplanInterval seconds, round robin, with at
+ * most carbon.Squad.MembersPerFrame members planned per frame. Planning a squad is
+ * linear in its size (CombatCore::PlanSquad, which the fight simulator runs too).
+ * Enemies only read the role written to them by the last plan.
+ */
+UCLASS()
+class CARBON_API USquadSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	/** Add Enemy to the squad fighting Target (leaving any squad it was in) */
+	void Join(AEnemyBase* Enemy, AActor* Target);
+
+	/** Remove Enemy from its squad and clear its role */
+	void Leave(AEnemyBase* Enemy);
+
+	/** Role counts and spacing from the carbon.Squad.* console variables */
+	static CombatCore::FSquadSettings GetPlanSettings();
+
+	/** carbon.Squad.ReplanInterval */
+	static float GetReplanInterval();
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+private:
+	struct FSquad
+	{
+		TWeakObjectPtr<AActor> Target;
+		TArray<TWeakObjectPtr<AEnemyBase>> Members;
+		float PlanTime = -1.0f;
+		bool Dirty = true;
+	};
+
+	/** Reassign every role in Squad - O(members) */
+	void Plan(FSquad& Squad);
+
+	/** Plan scratch, kept to avoid reallocating every plan */
+	TArray<CombatCore::FSquadMember> PlanMembers;
+	TArray<CombatCore::ESquadRole> PlanRoles;
+	TArray<CombatCore::FVec3> PlanOffsets;
+
+	TArray<FSquad> Squads;
+
+	/** Next squad to consider for replanning */
+	int32 NextSquad = 0;
+};
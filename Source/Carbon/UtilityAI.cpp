@@ -0,0 +1,265 @@
+// Sam Smith
+
+#include "UtilityAI.h"
+#include "Carbon.h"
+#include "CombatArchetype.h"
+#include "CombatantRegistry.h"
+#include "EnemyBase.h"
+#include "Engine/World.h"
+
+DECLARE_CYCLE_STAT(TEXT("Utility Scoring"), STAT_UtilityScoring, STATGROUP_Carbon);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Utility Evaluations"), STAT_UtilityEvaluations, STATGROUP_Carbon);
+
+static FAutoConsoleCommandWithWorld UtilityDumpCommand(
+	TEXT("carbon.Utility.Dump"),
+	TEXT("Log every enemy's last chosen action and its score"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UUtilitySubsystem* Utility = World ? World->GetSubsystem<UUtilitySubsystem>() : nullptr)
+			Utility->DumpDecisions();
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs UtilityBenchmarkCommand(
+	TEXT("carbon.Utility.Benchmark"),
+	TEXT("carbon.Utility.Benchmark [Count] - score Count random enemies and log evaluations per second"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UUtilitySubsystem* Utility = World ? World->GetSubsystem<UUtilitySubsystem>() : nullptr)
+			Utility->Benchmark(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 10000);
+	}));
+
+static_assert((uint8)EUtilityInput::COUNT == (uint8)CombatCore::EUtilityInput::Count, "EUtilityInput must mirror CombatCore::EUtilityInput");
+static_assert((uint8)EUtilityCurve::SMOOTH == (uint8)CombatCore::EUtilityCurve::Smooth, "EUtilityCurve must mirror CombatCore::EUtilityCurve");
+static_assert((uint8)EUtilityAction::LONG_ATTACK == (uint8)CombatCore::EChaseAction::LongAttack + 1, "EUtilityAction must be CombatCore::EChaseAction offset by NONE");
+
+static EUtilityAction ToUtilityAction(CombatCore::EChaseAction Action)
+{
+	return (EUtilityAction)((uint8)Action + 1);
+}
+
+void FUtilityActionScoring::BuildCoreActions(const TArray<FUtilityActionScoring>& Actions, const FCombatTuning& Tuning, CombatCore::FUtilityActions& OutActions)
+{
+	if (Actions.Num() == 0)
+	{
+		CombatCore::DefaultChaseActions(Tuning.GetCoreTuning(), OutActions);
+		return;
+	}
+
+	// NONE isn't something to choose, and anything past the core's fixed capacity is dropped
+	OutActions.NumActions = 0;
+	for (const FUtilityActionScoring& Action : Actions)
+	{
+		if (Action.Action == EUtilityAction::NONE || OutActions.NumActions == CombatCore::MaxUtilityActions)
+			continue;
+
+		CombatCore::FUtilityAction& Core = OutActions.Actions[OutActions.NumActions++];
+		Core.Action = (CombatCore::EChaseAction)((uint8)Action.Action - 1);
+		Core.Weight = Action.Weight;
+		Core.NumConsiderations = FMath::Min(Action.Considerations.Num(), CombatCore::MaxConsiderations);
+		for (int32 Index = 0; Index < Core.NumConsiderations; ++Index)
+		{
+			const FUtilityConsideration& Consideration = Action.Considerations[Index];
+			Core.Considerations[Index] = { (CombatCore::EUtilityInput)Consideration.Input, (CombatCore::EUtilityCurve)Consideration.Curve,
+				Consideration.Start, Consideration.End, Consideration.Invert };
+		}
+	}
+}
+
+void UUtilitySubsystem::FBatch::Reset()
+{
+	Handles.Reset();
+	for (TArray<float>& Column : Inputs)
+		Column.Reset();
+}
+
+void UUtilitySubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Registry = Collection.InitializeDependency<UCombatantRegistry>();
+	ArchetypeSubsystem = Collection.InitializeDependency<UCombatArchetypeSubsystem>();
+	Super::Initialize(Collection);
+
+	TickStartHandle = FWorldDelegates::OnWorldTickStart.AddUObject(this, &UUtilitySubsystem::OnWorldTickStart);
+#if WITH_EDITOR
+	TuningChangedHandle = UCombatArchetype::OnTuningChanged.AddUObject(this, &UUtilitySubsystem::OnTuningChanged);
+#endif
+}
+
+void UUtilitySubsystem::Deinitialize()
+{
+	FWorldDelegates::OnWorldTickStart.Remove(TickStartHandle);
+#if WITH_EDITOR
+	UCombatArchetype::OnTuningChanged.Remove(TuningChangedHandle);
+#endif
+
+	Super::Deinitialize();
+}
+
+UUtilitySubsystem::FBatch& UUtilitySubsystem::GetBatch(int32 TuningIndex, UCombatArchetype* Archetype)
+{
+	if (Batches.Num() <= TuningIndex)
+		Batches.SetNum(TuningIndex + 1);
+
+	// A tuning row belongs to exactly one archetype (row 0 to none), so this only happens once
+	FBatch& Batch = Batches[TuningIndex];
+	if (!Batch.HasActions)
+	{
+		static const TArray<FUtilityActionScoring> NoActions;
+		Batch.Archetype = Archetype;
+		FUtilityActionScoring::BuildCoreActions(Archetype ? Archetype->Actions : NoActions, ArchetypeSubsystem->GetTuning(TuningIndex), Batch.Actions);
+		Batch.HasActions = true;
+	}
+	return Batch;
+}
+
+#if WITH_EDITOR
+void UUtilitySubsystem::OnTuningChanged(UCombatArchetype* Archetype)
+{
+	for (FBatch& Batch : Batches)
+	{
+		if (Batch.HasActions && Batch.Archetype == Archetype)
+			FUtilityActionScoring::BuildCoreActions(Archetype->Actions, Archetype->Tuning, Batch.Actions);
+	}
+}
+#endif
+
+void UUtilitySubsystem::SetDecision(FCombatantHandle Handle, CombatCore::EChaseAction Action, float Score)
+{
+	const int32 Slot = Handle.GetIndex();
+	Decisions[Slot] = ToUtilityAction(Action);
+	DecisionScores[Slot] = Score;
+	DecisionOwners[Slot] = Handle;
+	DecisionFrames[Slot] = GFrameCounter;
+}
+
+EUtilityAction UUtilitySubsystem::Decide(AEnemyBase* Enemy)
+{
+	const FCombatantHandle Handle = Enemy->GetHandle();
+	if (!Handle.IsSet())
+		return EUtilityAction::MOVE;
+
+	const int32 Slot = Handle.GetIndex();
+	if (Decisions.Num() <= Slot)
+	{
+		Decisions.SetNumZeroed(Slot + 1);
+		DecisionScores.SetNumZeroed(Slot + 1);
+		DecisionOwners.SetNum(Slot + 1);
+		DecisionFrames.SetNumZeroed(Slot + 1);
+		PendingFrames.SetNumZeroed(Slot + 1);
+	}
+
+	// Still chasing next frame, most likely - score it with everyone else then
+	if (PendingFrames[Slot] != GFrameCounter)
+	{
+		PendingFrames[Slot] = GFrameCounter;
+		Pending.Add(Handle);
+	}
+
+	if (DecisionFrames[Slot] == GFrameCounter && DecisionOwners[Slot] == Handle)
+		return Decisions[Slot];
+
+	// Not in this frame's batch (only just started chasing): score it on its own
+	CombatCore::FUtilityInputs Inputs;
+	if (!Enemy->GetUtilityInputs(Inputs))
+		return EUtilityAction::MOVE;
+
+	float Score;
+	CombatCore::EChaseAction Action = CombatCore::ScoreChaseAction(GetBatch(Enemy->GetTuningIndex(), Enemy->GetArchetype()).Actions, Inputs, &Score);
+	INC_DWORD_STAT_BY(STAT_UtilityEvaluations, 1);
+	SetDecision(Handle, Action, Score);
+	return Decisions[Slot];
+}
+
+int32 UUtilitySubsystem::Evaluate(FBatch& Batch)
+{
+	const int32 Count = Batch.Handles.Num();
+	Batch.Scores.SetNumUninitialized(Count, false);
+	Batch.BestScores.SetNumUninitialized(Count, false);
+	Batch.BestActions.SetNumUninitialized(Count, false);
+
+	const float* Columns[(int32)EUtilityInput::COUNT];
+	for (int32 Input = 0; Input < (int32)EUtilityInput::COUNT; ++Input)
+		Columns[Input] = Batch.Inputs[Input].GetData();
+
+	return CombatCore::ScoreChaseActions(Batch.Actions, Columns, Count, Batch.Scores.GetData(), Batch.BestActions.GetData(), Batch.BestScores.GetData());
+}
+
+void UUtilitySubsystem::OnWorldTickStart(UWorld* World, ELevelTick TickType, float DeltaTime)
+{
+	if (World != GetWorld() || World->IsPaused() || Pending.Num() == 0)
+		return;
+
+	SCOPE_CYCLE_COUNTER(STAT_UtilityScoring);
+
+	// Fresh inputs from everyone who asked last frame and is still choosing
+	for (FCombatantHandle Handle : Pending)
+	{
+		AEnemyBase* Enemy = Cast<AEnemyBase>(Registry->Resolve(Handle));
+		CombatCore::FUtilityInputs Inputs;
+		if (!Enemy || !Enemy->GetUtilityInputs(Inputs))
+			continue;
+
+		FBatch& Batch = GetBatch(Enemy->GetTuningIndex(), Enemy->GetArchetype());
+		Batch.Handles.Add(Handle);
+		for (int32 Input = 0; Input < (int32)EUtilityInput::COUNT; ++Input)
+			Batch.Inputs[Input].Add(Inputs[Input]);
+	}
+	Pending.Reset();
+
+	for (FBatch& Batch : Batches)
+	{
+		if (Batch.Handles.Num() == 0)
+			continue;
+
+		int32 Evaluations = Evaluate(Batch);
+		INC_DWORD_STAT_BY(STAT_UtilityEvaluations, Evaluations);
+
+		for (int32 Index = 0; Index < Batch.Handles.Num(); ++Index)
+			SetDecision(Batch.Handles[Index], Batch.BestActions[Index], Batch.BestScores[Index]);
+
+		Batch.Reset();
+	}
+}
+
+void UUtilitySubsystem::DumpDecisions() const
+{
+	const UEnum* ActionEnum = StaticEnum<EUtilityAction>();
+
+	for (int32 Slot = 0; Slot < Decisions.Num(); ++Slot)
+	{
+		ACombatant* Combatant = Registry->Resolve(DecisionOwners[Slot]);
+		if (!Combatant || Decisions[Slot] == EUtilityAction::NONE)
+			continue;
+
+		UE_LOG(LogCarbon, Display, TEXT("%-32s %-12s %.3f"), *Combatant->GetName(),
+			*ActionEnum->GetNameStringByValue((int64)Decisions[Slot]), DecisionScores[Slot]);
+	}
+}
+
+void UUtilitySubsystem::Benchmark(int32 Count)
+{
+	static const TArray<FUtilityActionScoring> NoActions;
+	FBatch Batch;
+	FUtilityActionScoring::BuildCoreActions(NoActions, FCombatTuning(), Batch.Actions);
+
+	FRandomStream Random(Count);
+	for (int32 Index = 0; Index < Count; ++Index)
+	{
+		Batch.Handles.Add(FCombatantHandle(Index, 1));
+		Batch.Inputs[(int32)EUtilityInput::DISTANCE].Add(Random.FRandRange(0.0f, 2000.0f));
+		Batch.Inputs[(int32)EUtilityInput::FACING].Add(Random.FRandRange(-1.0f, 1.0f));
+		Batch.Inputs[(int32)EUtilityInput::COOLDOWN].Add(Random.FRandRange(0.0f, 1.0f) < 0.5f ? 0.0f : Random.FRandRange(0.0f, 5.0f));
+		Batch.Inputs[(int32)EUtilityInput::LINE_OF_SIGHT].Add(Random.FRandRange(0.0f, 1.0f) < 0.8f ? 1.0f : 0.0f);
+		Batch.Inputs[(int32)EUtilityInput::TARGET_ROLLING].Add(0.0f);
+		Batch.Inputs[(int32)EUtilityInput::TARGET_ATTACKING].Add(0.0f);
+	}
+
+	const int32 Iterations = 100;
+	int64 Evaluations = 0;
+	double StartTime = FPlatformTime::Seconds();
+	for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+		Evaluations += Evaluate(Batch);
+	double Seconds = FPlatformTime::Seconds() - StartTime;
+
+	UE_LOG(LogCarbon, Display, TEXT("Utility benchmark: %d enemies x %d iterations, %lld action evaluations in %.3f ms (%.1f M evaluations/s)"),
+		Count, Iterations, Evaluations, Seconds * 1000.0, Evaluations / FMath::Max(Seconds, 1e-9) / 1e6);
+}
@@ -0,0 +1,173 @@
+// Sam Smith
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Combatant.h"
+#include "CombatCore.h"
+#include "UtilityAI.generated.h"
+
+class AEnemyBase;
+class UCombatArchetype;
+struct FCombatTuning;
+
+/** What an enemy can choose to do while chasing (CombatCore::EChaseAction, plus NONE) */
+UENUM(BlueprintType)
+enum class EUtilityAction : uint8
+{
+	NONE,					// Not evaluated yet
+	MOVE,					// Move towards the target
+	ATTACK,					// Melee attack
+	LONG_ATTACK				// Knight: long-range jump attack
+};
+
+/** Per-enemy values considerations read (mirrors CombatCore::EUtilityInput) */
+UENUM(BlueprintType)
+enum class EUtilityInput : uint8
+{
+	DISTANCE,				// Distance to target
+	FACING,					// dot(forward, direction to target)
+	COOLDOWN,				// Seconds until the long attack is ready (0 = ready)
+	LINE_OF_SIGHT,			// 1 if the target is visible, otherwise 0
+	TARGET_ROLLING,			// 1 if the target is rolling, otherwise 0
+	TARGET_ATTACKING,		// 1 if the target is attacking, otherwise 0
+	COUNT UMETA(Hidden)
+};
+
+UENUM(BlueprintType)
+enum class EUtilityCurve : uint8
+{
+	STEP,					// 1 once the input reaches End, otherwise 0 (inverted: 1 while it is at most End)
+	LINEAR,					// 0 at Start rising to 1 at End
+	SMOOTH					// Smoothstep from Start to End
+};
+
+/** One input mapped to a 0-1 score through a response curve */
+USTRUCT(BlueprintType)
+struct CARBON_API FUtilityConsideration
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, Category = "Utility")
+	EUtilityInput Input = EUtilityInput::DISTANCE;
+
+	UPROPERTY(EditAnywhere, Category = "Utility")
+	EUtilityCurve Curve = EUtilityCurve::LINEAR;
+
+	UPROPERTY(EditAnywhere, Category = "Utility")
+	float Start = 0.0f;
+
+	UPROPERTY(EditAnywhere, Category = "Utility")
+	float End = 1.0f;
+
+	/** Score 1 - curve instead (an inverted step includes End, so it reads "at most End") */
+	UPROPERTY(EditAnywhere, Category = "Utility")
+	bool Invert = false;
+};
+
+/** An action's score is Weight times the product of its considerations */
+USTRUCT(BlueprintType)
+struct CARBON_API FUtilityActionScoring
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, Category = "Utility")
+	EUtilityAction Action = EUtilityAction::MOVE;
+
+	UPROPERTY(EditAnywhere, Category = "Utility")
+	float Weight = 1.0f;
+
+	UPROPERTY(EditAnywhere, Category = "Utility")
+	TArray<FUtilityConsideration> Considerations;
+
+	/** Copy Actions into CombatCore's form (CombatCore::DefaultChaseActions from Tuning when empty) */
+	static void BuildCoreActions(const TArray<FUtilityActionScoring>& Actions, const FCombatTuning& Tuning, CombatCore::FUtilityActions& OutActions);
+};
+
+/**
+ * Batched utility scoring for enemy action selection.
+ * Enemies ask for their chase action with Decide(). Everyone who asked last frame is scored
+ * at the start of this one - fresh inputs gathered from each enemy, then one CombatCore pass
+ * per (archetype, action, consideration) over contiguous input columns - so Decide() reads a
+ * decision made this frame. Enemies that only just started asking are scored on the spot.
+ * Each archetype's action set is built once (and rebuilt when the archetype is edited).
+ */
+UCLASS()
+class CARBON_API UUtilitySubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/** Best chase action for Enemy this frame - MOVE when it has nothing better (or no target) */
+	EUtilityAction Decide(AEnemyBase* Enemy);
+
+	/**
+	 * Action set enemies using Archetype (at TuningIndex) are scored with, for simulations that
+	 * score their own entities. Copy it if it has to outlive the next call.
+	 */
+	const CombatCore::FUtilityActions& GetActions(int32 TuningIndex, UCombatArchetype* Archetype) { return GetBatch(TuningIndex, Archetype).Actions; }
+
+	/** Log every slot's last decision and score */
+	void DumpDecisions() const;
+
+	/** Score Count random enemies and log evaluations per second */
+	void Benchmark(int32 Count);
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+
+	virtual void Deinitialize() override;
+
+private:
+	/** Enemies sharing one archetype, as columns */
+	struct FBatch
+	{
+		UCombatArchetype* Archetype = nullptr;
+		CombatCore::FUtilityActions Actions;
+		bool HasActions = false;
+
+		TArray<FCombatantHandle> Handles;
+		TArray<float> Inputs[(int32)EUtilityInput::COUNT];
+		TArray<float> Scores;
+		TArray<float> BestScores;
+		TArray<CombatCore::EChaseAction> BestActions;
+
+		void Reset();
+	};
+
+	/** Batch for TuningIndex, building its action set the first time */
+	FBatch& GetBatch(int32 TuningIndex, UCombatArchetype* Archetype);
+
+	/** Score every enemy in Batch - returns the number of action evaluations */
+	int32 Evaluate(FBatch& Batch);
+
+	void SetDecision(FCombatantHandle Handle, CombatCore::EChaseAction Action, float Score);
+
+	/** Gather inputs from last frame's askers and score them */
+	void OnWorldTickStart(UWorld* World, ELevelTick TickType, float DeltaTime);
+
+	UCombatantRegistry* Registry;
+
+	UCombatArchetypeSubsystem* ArchetypeSubsystem;
+
+	/** Indexed by tuning index */
+	TArray<FBatch> Batches;
+
+	/** Enemies that asked this frame, scored at the start of the next */
+	TArray<FCombatantHandle> Pending;
+
+	/** Indexed by registry slot */
+	TArray<EUtilityAction> Decisions;
+	TArray<float> DecisionScores;
+	TArray<FCombatantHandle> DecisionOwners;
+	TArray<uint64> DecisionFrames;
+	TArray<uint64> PendingFrames;
+
+	FDelegateHandle TickStartHandle;
+
+#if WITH_EDITOR
+	void OnTuningChanged(UCombatArchetype* Archetype);
+
+	FDelegateHandle TuningChangedHandle;
+#endif
+};
@@ -0,0 +1,128 @@
+// Sam Smith
+
+#include "VisibilitySubsystem.h"
+#include "Carbon.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+
+DECLARE_CYCLE_STAT(TEXT("Visibility Tick"), STAT_VisibilityTick, STATGROUP_Carbon);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Visibility Traces"), STAT_VisibilityTraces, STATGROUP_Carbon);
+
+static TAutoConsoleVariable<int32> CVarVisibilityMaxTraces(
+	TEXT("carbon.Visibility.MaxTracesPerFrame"), 8,
+	TEXT("Maximum number of line-of-sight traces issued per frame."));
+
+static TAutoConsoleVariable<float> CVarVisibilityTTL(
+	TEXT("carbon.Visibility.TTL"), 0.25f,
+	TEXT("Seconds a line-of-sight result stays valid."));
+
+static TAutoConsoleVariable<float> CVarVisibilityInvalidationDistance(
+	TEXT("carbon.Visibility.InvalidationDistance"), 100.0f,
+	TEXT("A result is discarded once the viewer or target moves further than this from where it was traced."));
+
+ELineOfSight UVisibilitySubsystem::GetLineOfSight(AActor* Viewer, AActor* Target)
+{
+	if (!Viewer || !Target)
+		return ELineOfSight::UNKNOWN;
+
+	float Now = GetWorld()->GetTimeSeconds();
+	FSightKey Key(Viewer, Target);
+	FSightEntry& Entry = Entries.FindOrAdd(Key);
+	Entry.LastQueryTime = Now;
+
+	if (!Entry.Requested && IsStale(Entry, Viewer, Target, Now))
+	{
+		Entry.Requested = true;
+		RequestQueue.Add(Key);
+	}
+
+	return Entry.Result;
+}
+
+bool UVisibilitySubsystem::IsStale(const FSightEntry& Entry, const AActor* Viewer, const AActor* Target, float Now) const
+{
+	if (Entry.TraceTime < 0.0f || Now - Entry.TraceTime > CVarVisibilityTTL.GetValueOnGameThread())
+		return true;
+
+	float MaxDistanceSquared = FMath::Square(CVarVisibilityInvalidationDistance.GetValueOnGameThread());
+	return FVector::DistSquared(Viewer->GetActorLocation(), Entry.ViewerLocation) > MaxDistanceSquared
+		|| FVector::DistSquared(Target->GetActorLocation(), Entry.TargetLocation) > MaxDistanceSquared;
+}
+
+void UVisibilitySubsystem::Tick(float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_VisibilityTick);
+
+	UWorld* World = GetWorld();
+	float Now = World->GetTimeSeconds();
+
+	if (!TraceDelegate.IsBound())
+		TraceDelegate.BindUObject(this, &UVisibilitySubsystem::OnTraceCompleted);
+
+	// Issue a bounded number of async traces, oldest requests first
+	int32 Budget = FMath::Min(CVarVisibilityMaxTraces.GetValueOnGameThread(), RequestQueue.Num());
+	int32 Issued = 0;
+	int32 Consumed = 0;
+	while (Issued < Budget && Consumed < RequestQueue.Num())
+	{
+		const FSightKey& Key = RequestQueue[Consumed++];
+		AActor* Viewer = Key.Key.Get();
+		AActor* Target = Key.Value.Get();
+		if (!Viewer || !Target)
+		{
+			Entries.Remove(Key);
+			continue;
+		}
+
+		FVector EyeLocation;
+		FRotator EyeRotation;
+		Viewer->GetActorEyesViewPoint(EyeLocation, EyeRotation);
+
+		FSightEntry& Entry = Entries.FindChecked(Key);
+		Entry.ViewerLocation = Viewer->GetActorLocation();
+		Entry.TargetLocation = Target->GetActorLocation();
+
+		FCollisionQueryParams Params(SCENE_QUERY_STAT(CarbonLineOfSight), true, Viewer);
+		Params.AddIgnoredActor(Target);
+
+		uint32 TraceId = NextTraceId++;
+		InFlight.Add(TraceId, Key);
+		World->AsyncLineTraceByChannel(EAsyncTraceType::Test, EyeLocation, Entry.TargetLocation, ECC_Visibility, Params,
+			FCollisionResponseParams::DefaultResponseParam, &TraceDelegate, TraceId);
+		Issued++;
+	}
+	RequestQueue.RemoveAt(0, Consumed, false);
+	INC_DWORD_STAT_BY(STAT_VisibilityTraces, Issued);
+
+	// Forget pairs nobody has asked about for a while
+	for (auto It = Entries.CreateIterator(); It; ++It)
+	{
+		if (!It.Value().Requested && Now - It.Value().LastQueryTime > 5.0f)
+			It.RemoveCurrent();
+	}
+}
+
+void UVisibilitySubsystem::OnTraceCompleted(const FTraceHandle& Handle, FTraceDatum& Datum)
+{
+	FSightKey Key;
+	if (!InFlight.RemoveAndCopyValue(Datum.UserData, Key))
+		return;
+
+	if (FSightEntry* Entry = Entries.Find(Key))
+	{
+		// A 'Test' trace only reports blocking hits
+		Entry->Result = Datum.OutHits.Num() > 0 ? ELineOfSight::BLOCKED : ELineOfSight::VISIBLE;
+		Entry->TraceTime = GetWorld()->GetTimeSeconds();
+		Entry->Requested = false;
+	}
+}
+
+ETickableTickType UVisibilitySubsystem::GetTickableTickType() const
+{
+	return HasAnyFlags(RF_ClassDefaultObject) ? ETickableTickType::Never : ETickableTickType::Always;
+}
+
+TStatId UVisibilitySubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UVisibilitySubsystem, STATGROUP_Tickables);
+}
@@ -0,0 +1,67 @@
+// Sam Smith
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Tickable.h"
+#include "WorldCollision.h"
+#include "VisibilitySubsystem.generated.h"
+
+UENUM(BlueprintType)
+enum class ELineOfSight : uint8
+{
+	UNKNOWN,				// Never traced (or result discarded)
+	VISIBLE,				// Last trace reached the target
+	BLOCKED					// Last trace hit something first
+};
+
+/**
+ * Shared line-of-sight service for enemy decision making.
+ * Callers read the last known result for a (viewer, target) pair; stale pairs are queued
+ * and traced asynchronously, at most carbon.Visibility.MaxTracesPerFrame per frame,
+ * no matter how many enemies are asking.
+ */
+UCLASS()
+class CARBON_API UVisibilitySubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	/** Last known line of sight from Viewer's eyes to Target - requests a refresh if stale */
+	ELineOfSight GetLineOfSight(AActor* Viewer, AActor* Target);
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual TStatId GetStatId() const override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+
+private:
+	typedef TPair<TWeakObjectPtr<AActor>, TWeakObjectPtr<AActor>> FSightKey;
+
+	struct FSightEntry
+	{
+		ELineOfSight Result = ELineOfSight::UNKNOWN;
+		float TraceTime = -1.0f;
+		float LastQueryTime = 0.0f;
+		FVector ViewerLocation = FVector::ZeroVector;
+		FVector TargetLocation = FVector::ZeroVector;
+		bool Requested = false;
+	};
+
+	bool IsStale(const FSightEntry& Entry, const AActor* Viewer, const AActor* Target, float Now) const;
+
+	void OnTraceCompleted(const FTraceHandle& Handle, FTraceDatum& Datum);
+
+	TMap<FSightKey, FSightEntry> Entries;
+
+	/** Pairs waiting for a trace slot (FIFO) */
+	TArray<FSightKey> RequestQueue;
+
+	/** Traces in flight, keyed by the trace's user data */
+	TMap<uint32, FSightKey> InFlight;
+	uint32 NextTraceId = 0;
+
+	FTraceDelegate TraceDelegate;
+};
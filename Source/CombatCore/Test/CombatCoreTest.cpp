@@ -0,0 +1,408 @@
+// Sam Smith
+
+// Checks for the engine-free combat core, plus a --benchmark mode timing chase decisions.
+// Returns non-zero if any check fails.
+
+#include "CombatCore.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace CombatCore;
+
+static int Failures = 0;
+
+#define CHECK(Condition) \
+	do { if (!(Condition)) { std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #Condition); ++Failures; } } while (0)
+
+/** The numbers FCombatTuning defaults to */
+static const FEnemyTuning Tuning = { 1200.0f, 300.0f, 850.0f, 0.95f, 900.0f, 600.0f };
+
+static FChaseInputs MakeInputs(float Distance, float FacingDot, bool HasLongAttack = false, bool LongAttackReady = true, bool LineOfSight = true)
+{
+	FChaseInputs Inputs = {};
+	Inputs.Distance = Distance;
+	Inputs.FacingDot = FacingDot;
+	Inputs.Now = 10.0f;
+	Inputs.LongAttackReadyTime = LongAttackReady ? 9.0f : 12.0f;
+	Inputs.HasLongAttack = HasLongAttack;
+	Inputs.LineOfSight = LineOfSight;
+	return Inputs;
+}
+
+/** The same enemy as utility inputs (no long attack means it never comes off cooldown) */
+static void MakeUtilityInputs(const FChaseInputs& Chase, FUtilityInputs& Inputs)
+{
+	Inputs[(int)EUtilityInput::Distance] = Chase.Distance;
+	Inputs[(int)EUtilityInput::Facing] = Chase.FacingDot;
+	Inputs[(int)EUtilityInput::Cooldown] = Chase.HasLongAttack ? std::fmax(0.0f, Chase.LongAttackReadyTime - Chase.Now) : 1e9f;
+	Inputs[(int)EUtilityInput::LineOfSight] = Chase.LineOfSight ? 1.0f : 0.0f;
+	Inputs[(int)EUtilityInput::TargetRolling] = 0.0f;
+	Inputs[(int)EUtilityInput::TargetAttacking] = 0.0f;
+}
+
+static void TestActions()
+{
+	FActionState Idle = {};
+	Idle.Loaded = true;
+	CHECK(CanAttack(Idle));
+	CHECK(CanRoll(Idle));
+
+	FActionState Attacking = Idle;
+	Attacking.Attacking = true;
+	CHECK(!CanAttack(Attacking));
+	Attacking.NextAttackReady = true;
+	CHECK(CanAttack(Attacking));
+
+	FActionState Unloaded = {};
+	CHECK(!CanAttack(Unloaded));
+	CHECK(!CanRoll(Unloaded));
+
+	CHECK(!IsInputBuffered(-1.0f, 0.3f, 5.0f));
+	CHECK(IsInputBuffered(4.8f, 0.3f, 5.0f));
+	CHECK(!IsInputBuffered(4.6f, 0.3f, 5.0f));
+	CHECK(ResolveBufferedInput(Idle, 5.0f, 4.9f, 0.3f, 4.9f, 0.3f) == EBufferedInput::Roll);
+	CHECK(ResolveBufferedInput(Idle, 5.0f, 4.9f, 0.3f, -1.0f, 0.3f) == EBufferedInput::Attack);
+
+	CHECK(ComboIndex(2, 3) == 2);
+	CHECK(ComboIndex(3, 3) == 0);
+	CHECK(ComboIndex(0, 0) == 0);
+}
+
+static void TestRotation()
+{
+	CHECK(NormalizeAxis(190.0f) == -170.0f);
+	CHECK(NormalizeAxis(-190.0f) == 170.0f);
+	CHECK(std::fabs(YawTowards(0.0f, 1.0f) - 90.0f) < 1e-3f);
+
+	// Settles without overshooting, whatever the step
+	float Value = 0.0f;
+	float Velocity = 0.0f;
+	float Peak = 0.0f;
+	for (int Step = 0; Step < 120; ++Step)
+	{
+		SpringDamp(Value, Velocity, 1.0f, 8.0f, Step % 2 ? 1.0f / 30.0f : 1.0f / 120.0f);
+		Peak = std::fmax(Peak, Value);
+	}
+	CHECK(std::fabs(Value - 1.0f) < 1e-3f);
+	CHECK(Peak <= 1.0f + 1e-4f);
+}
+
+static void TestTransitions()
+{
+	CHECK(IdleTransition(Tuning.AggroRange, Tuning, true) == EState::ChaseClose);
+	CHECK(IdleTransition(Tuning.AggroRange + 1.0f, Tuning, true) == EState::Idle);
+	CHECK(IdleTransition(0.0f, Tuning, false) == EState::Idle);
+
+	CHECK(ChaseFarTransition(Tuning.ChaseFarRange - 1.0f, Tuning) == EState::ChaseClose);
+	CHECK(ChaseFarTransition(Tuning.ChaseFarRange, Tuning) == EState::ChaseFar);
+
+	CHECK(StumbleTransition(true) == EState::Stumble);
+	CHECK(StumbleTransition(false) == EState::ChaseClose);
+}
+
+static void TestChaseAction()
+{
+	CHECK(ChooseChaseAction(MakeInputs(Tuning.AttackRange, 1.0f), Tuning) == EChaseAction::Attack);
+	CHECK(ChooseChaseAction(MakeInputs(Tuning.AttackRange + 1.0f, 1.0f), Tuning) == EChaseAction::Move);
+	CHECK(ChooseChaseAction(MakeInputs(100.0f, Tuning.AttackFacingDot - 0.01f), Tuning) == EChaseAction::Move);
+
+	CHECK(ChooseChaseAction(MakeInputs(Tuning.LongAttackRange, 1.0f, true), Tuning) == EChaseAction::LongAttack);
+	CHECK(ChooseChaseAction(MakeInputs(Tuning.LongAttackRange + 1.0f, 1.0f, true), Tuning) == EChaseAction::Move);
+	CHECK(ChooseChaseAction(MakeInputs(600.0f, 1.0f, true, false), Tuning) == EChaseAction::Move);
+	CHECK(ChooseChaseAction(MakeInputs(600.0f, 1.0f, true, true, false), Tuning) == EChaseAction::Move);
+	// Melee wins when both are possible
+	CHECK(ChooseChaseAction(MakeInputs(100.0f, 1.0f, true), Tuning) == EChaseAction::Attack);
+
+	CHECK(LongAttackSpeed(500.0f, Tuning) == 500.0f + Tuning.LongAttackJumpBonus);
+}
+
+static void TestQuickHits()
+{
+	FQuickHits Hits;
+	bool Interruptable = true;
+	for (int Hit = 0; Hit < QuickHitThreshold; ++Hit)
+		Interruptable = TakeQuickHit(Hits, Hit * 0.5f, Interruptable);
+	CHECK(!Interruptable);
+
+	// A slow hit resets the count
+	CHECK(TakeQuickHit(Hits, 100.0f, Interruptable));
+}
+
+static void TestCycleTarget()
+{
+	const FVec3 View = { 0.0f, 0.0f, 0.0f };
+	const FVec3 Candidates[] = { { 100.0f, 0.0f, 0.0f }, { 100.0f, 50.0f, 0.0f }, { 100.0f, -50.0f, 0.0f }, { 30.0f, 0.0f, 0.0f } };
+
+	CHECK(CycleTarget(View, View, Candidates, 4, nullptr, -1, true) == 3);
+	// UE yaw grows clockwise seen from above
+	CHECK(CycleTarget(View, View, Candidates, 4, &Candidates[0], 0, true) == 1);
+	CHECK(CycleTarget(View, View, Candidates, 4, &Candidates[0], 0, false) == 2);
+	CHECK(CycleTarget(View, View, Candidates, 0, nullptr, -1, true) == -1);
+}
+
+static void TestUtility()
+{
+	const FConsideration Linear = { EUtilityInput::Distance, EUtilityCurve::Linear, 100.0f, 200.0f, false };
+	CHECK(Consider(Linear, 50.0f) == 0.0f);
+	CHECK(std::fabs(Consider(Linear, 150.0f) - 0.5f) < 1e-6f);
+	CHECK(Consider(Linear, 250.0f) == 1.0f);
+
+	const FConsideration Smooth = { EUtilityInput::Distance, EUtilityCurve::Smooth, 0.0f, 1.0f, true };
+	CHECK(std::fabs(Consider(Smooth, 0.5f) - 0.5f) < 1e-6f);
+	CHECK(Consider(Smooth, 0.0f) == 1.0f);
+
+	// Both sides of a step include End
+	const FConsideration AtLeast = { EUtilityInput::Distance, EUtilityCurve::Step, 0.0f, 300.0f, false };
+	const FConsideration AtMost = { EUtilityInput::Distance, EUtilityCurve::Step, 0.0f, 300.0f, true };
+	CHECK(Consider(AtLeast, 300.0f) == 1.0f && Consider(AtLeast, 299.5f) == 0.0f);
+	CHECK(Consider(AtMost, 300.0f) == 1.0f && Consider(AtMost, 300.5f) == 0.0f);
+
+	// The default action set decides like ChooseChaseAction, boundaries included
+	FUtilityActions Actions;
+	DefaultChaseActions(Tuning, Actions);
+	std::vector<float> Distances = { Tuning.AttackRange, Tuning.LongAttackRange };
+	for (int Step = 0; Step < 100; ++Step)
+		Distances.push_back(0.5f + Step * 13.0f);
+	int Mismatches = 0;
+	for (float Distance : Distances)
+	{
+		for (float Facing : { -1.0f, 0.5f, 0.94f, Tuning.AttackFacingDot, 0.96f, 1.0f })
+		{
+			for (int Variant = 0; Variant < 8; ++Variant)
+			{
+				const FChaseInputs Chase = MakeInputs(Distance, Facing, Variant & 1, (Variant & 2) != 0, (Variant & 4) != 0);
+				FUtilityInputs Inputs;
+				MakeUtilityInputs(Chase, Inputs);
+				Mismatches += ScoreChaseAction(Actions, Inputs) != ChooseChaseAction(Chase, Tuning);
+			}
+		}
+	}
+	CHECK(Mismatches == 0);
+
+	// Off cooldown this very moment
+	FChaseInputs JustReady = MakeInputs(600.0f, 1.0f, true);
+	JustReady.LongAttackReadyTime = JustReady.Now;
+	FUtilityInputs Inputs;
+	MakeUtilityInputs(JustReady, Inputs);
+	CHECK(ChooseChaseAction(JustReady, Tuning) == EChaseAction::LongAttack);
+	CHECK(ScoreChaseAction(Actions, Inputs) == EChaseAction::LongAttack);
+
+	// Nothing is started into a roll, and no jump into the target's swing (melee still answers it)
+	Inputs[(int)EUtilityInput::TargetAttacking] = 1.0f;
+	CHECK(ScoreChaseAction(Actions, Inputs) == EChaseAction::Move);
+	MakeUtilityInputs(MakeInputs(100.0f, 1.0f, true), Inputs);
+	Inputs[(int)EUtilityInput::TargetAttacking] = 1.0f;
+	CHECK(ScoreChaseAction(Actions, Inputs) == EChaseAction::Attack);
+	Inputs[(int)EUtilityInput::TargetAttacking] = 0.0f;
+	Inputs[(int)EUtilityInput::TargetRolling] = 1.0f;
+	CHECK(ScoreChaseAction(Actions, Inputs) == EChaseAction::Move);
+	MakeUtilityInputs(MakeInputs(600.0f, 1.0f, true), Inputs);
+	Inputs[(int)EUtilityInput::TargetRolling] = 1.0f;
+	CHECK(ScoreChaseAction(Actions, Inputs) == EChaseAction::Move);
+
+	// Batched scoring agrees with scoring one at a time
+	std::vector<float> Columns[(int)EUtilityInput::Count];
+	for (int Index = 0; Index < 64; ++Index)
+	{
+		MakeUtilityInputs(MakeInputs(Index * 20.0f, Index % 3 ? 1.0f : 0.0f, true, Index % 5 != 0), Inputs);
+		Inputs[(int)EUtilityInput::TargetRolling] = Index % 7 == 0 ? 1.0f : 0.0f;
+		Inputs[(int)EUtilityInput::TargetAttacking] = Index % 4 == 0 ? 1.0f : 0.0f;
+		for (int Input = 0; Input < (int)EUtilityInput::Count; ++Input)
+			Columns[Input].push_back(Inputs[Input]);
+	}
+	const float* ColumnData[(int)EUtilityInput::Count];
+	for (int Input = 0; Input < (int)EUtilityInput::Count; ++Input)
+		ColumnData[Input] = Columns[Input].data();
+
+	std::vector<float> Scratch(64), Scores(64);
+	std::vector<EChaseAction> Best(64);
+	CHECK(ScoreChaseActions(Actions, ColumnData, 64, Scratch.data(), Best.data(), Scores.data()) == 64 * Actions.NumActions);
+	for (int Index = 0; Index < 64; ++Index)
+	{
+		for (int Input = 0; Input < (int)EUtilityInput::Count; ++Input)
+			Inputs[Input] = Columns[Input][Index];
+		float Score;
+		CHECK(ScoreChaseAction(Actions, Inputs, &Score) == Best[Index]);
+		CHECK(Score == Scores[Index]);
+	}
+}
+
+static void TestSquad()
+{
+	const FSquadSettings Settings = { 2, 2, 1, 450.0f, 200.0f };
+	const FVec3 Target = { 0.0f, 0.0f, 0.0f };
+
+	// Members 100, 200, ... 700 away: two attackers, two flankers, a taunter (two spare to wait)
+	FSquadMember Members[7];
+	for (int Index = 0; Index < 7; ++Index)
+		Members[Index] = { { (Index + 1) * 100.0f, 0.0f, 0.0f }, ESquadRole::None, false };
+	ESquadRole Roles[7];
+	FVec3 Offsets[7];
+	PlanSquad(Members, 7, Target, 0.0f, Settings, Roles, Offsets);
+	CHECK(Roles[0] == ESquadRole::Attacker && Roles[1] == ESquadRole::Attacker);
+	CHECK(Roles[2] == ESquadRole::Flanker && Roles[3] == ESquadRole::Flanker);
+	CHECK(Roles[4] == ESquadRole::Taunter);
+	CHECK(Roles[5] == ESquadRole::Waiter && Roles[6] == ESquadRole::Waiter);
+
+	// Flank slots on either side of where the target faces
+	CHECK(std::fabs(Offsets[2].X) < 1e-3f && std::fabs(Offsets[2].Y - 450.0f) < 1e-3f);
+	CHECK(std::fabs(Offsets[3].X) < 1e-3f && std::fabs(Offsets[3].Y + 450.0f) < 1e-3f);
+
+	// No taunter without anyone left to wait
+	PlanSquad(Members, 5, Target, 0.0f, Settings, Roles, Offsets);
+	CHECK(Roles[4] == ESquadRole::Waiter);
+
+	// A committed attacker keeps its slot however far it is, an idle one only within the bonus
+	Members[6].Role = ESquadRole::Attacker;
+	Members[6].Committed = true;
+	PlanSquad(Members, 7, Target, 0.0f, Settings, Roles, Offsets);
+	CHECK(Roles[6] == ESquadRole::Attacker && Roles[0] == ESquadRole::Attacker && Roles[1] == ESquadRole::Flanker);
+	Members[6].Committed = false;
+	PlanSquad(Members, 7, Target, 0.0f, Settings, Roles, Offsets);
+	CHECK(Roles[6] == ESquadRole::Waiter);
+	Members[2].Role = ESquadRole::Attacker;
+	PlanSquad(Members, 7, Target, 0.0f, Settings, Roles, Offsets);
+	CHECK(Roles[2] == ESquadRole::Attacker && Roles[1] == ESquadRole::Flanker);
+}
+
+static void TestChaseStep()
+{
+	FUtilityActions Actions;
+	DefaultChaseActions(Tuning, Actions);
+	const FChaserClass Knight = { Tuning, &Actions, 600.0f, 5.0f, true, 5.0f };
+	const FChaserClass Soldier = { Tuning, &Actions, 600.0f, 5.0f, false, 0.0f };
+	const FChaseTarget Target = { { 0.0f, 0.0f, 0.0f }, 0.0f, false, false };
+	const float Now = 10.0f;
+	const float Step = 0.1f;
+
+	// Facing the target (yaw 180 looks down -X) and in melee range
+	FChaser Chaser = { { 200.0f, 0.0f, 0.0f }, 180.0f, -100.0f, ESquadRole::None, { 0.0f, 0.0f, 0.0f } };
+	CHECK(StepChaseClose(Chaser, Knight, Target, Now, Step, true) == EState::Attack);
+
+	// A roll isn't attacked into: close in instead (already in range, so stay put)
+	FChaseTarget Rolling = Target;
+	Rolling.Rolling = true;
+	CHECK(StepChaseClose(Chaser, Knight, Rolling, Now, Step, true) == EState::ChaseClose);
+	CHECK(Chaser.Location.X == 200.0f);
+
+	// Long attack range: the knight jumps in to melee range, the soldier walks
+	Chaser = { { 800.0f, 0.0f, 0.0f }, 180.0f, -100.0f, ESquadRole::None, { 0.0f, 0.0f, 0.0f } };
+	FChaser Walker = Chaser;
+	CHECK(StepChaseClose(Chaser, Knight, Target, Now, Step, true) == EState::Attack);
+	CHECK(std::fabs(Chaser.Location.X - Tuning.AttackRange) < 1e-3f && Chaser.LongAttackTime == Now);
+	CHECK(StepChaseClose(Walker, Soldier, Target, Now, Step, true) == EState::ChaseClose);
+	CHECK(std::fabs(Walker.Location.X - (800.0f - 600.0f * Step)) < 1e-3f);
+
+	// Then the jump is on cooldown, and never taken without a line of sight
+	Chaser.Location.X = 800.0f;
+	CHECK(StepChaseClose(Chaser, Knight, Target, Now + 1.0f, Step, true) == EState::ChaseClose);
+	Chaser.LongAttackTime = -100.0f;
+	Chaser.Location.X = 800.0f;
+	CHECK(StepChaseClose(Chaser, Knight, Target, Now, Step, false) == EState::ChaseClose);
+
+	// Roles: waiters and taunters leave CHASE_CLOSE, a flanker holds its slot while watched
+	Chaser = { { 200.0f, 0.0f, 0.0f }, 180.0f, -100.0f, ESquadRole::Waiter, { 0.0f, 0.0f, 0.0f } };
+	CHECK(StepChaseClose(Chaser, Knight, Target, Now, Step, true) == EState::ChaseFar);
+	Chaser.Role = ESquadRole::Taunter;
+	CHECK(StepChaseClose(Chaser, Knight, Target, Now, Step, true) == EState::Taunt);
+	CHECK(StepTaunt(Chaser, Knight, Target, Step) == EState::Taunt);
+	Chaser.Role = ESquadRole::Flanker;
+	CHECK(StepTaunt(Chaser, Knight, Target, Step) == EState::ChaseClose);
+	Chaser.SquadOffset = { 0.0f, 450.0f, 0.0f };
+	CHECK(StepChaseClose(Chaser, Knight, Target, Now, Step, true) == EState::ChaseClose);
+	CHECK(Chaser.Location.Y > 0.0f);
+	FChaseTarget TurnedAway = Target;
+	TurnedAway.Yaw = 180.0f;
+	Chaser.Location = { 200.0f, 0.0f, 0.0f };
+	Chaser.Yaw = 180.0f;
+	CHECK(StepChaseClose(Chaser, Knight, TurnedAway, Now, Step, true) == EState::Attack);
+
+	// Waiters hold at ChaseFarRange, anyone else given a role goes back in
+	Chaser = { { 900.0f, 0.0f, 0.0f }, 180.0f, -100.0f, ESquadRole::Waiter, { 0.0f, 0.0f, 0.0f } };
+	for (int Index = 0; Index < 20; ++Index)
+		CHECK(StepChaseFar(Chaser, Knight, Target, Step) == EState::ChaseFar);
+	CHECK(std::fabs(Chaser.Location.X - Tuning.ChaseFarRange) < 1e-3f);
+	Chaser.Role = ESquadRole::Attacker;
+	CHECK(StepChaseFar(Chaser, Knight, Target, Step) == EState::ChaseClose);
+	Chaser.Role = ESquadRole::None;
+	Chaser.Location.X = 2000.0f;
+	CHECK(StepChaseFar(Chaser, Knight, Target, Step) == EState::ChaseFar);
+}
+
+static void Benchmark()
+{
+	typedef std::chrono::steady_clock FClock;
+	const int Count = 10000;
+	const int Iterations = 200;
+
+	std::vector<FChaseInputs> Chases;
+	std::vector<float> Columns[(int)EUtilityInput::Count];
+	unsigned Random = 1;
+	auto Next = [&Random]() { Random = Random * 1664525u + 1013904223u; return (Random >> 8) / 16777216.0f; };
+	for (int Index = 0; Index < Count; ++Index)
+	{
+		const FChaseInputs Chase = MakeInputs(Next() * 2000.0f, Next() * 2.0f - 1.0f, true, Next() < 0.5f, Next() < 0.8f);
+		Chases.push_back(Chase);
+		FUtilityInputs Inputs;
+		MakeUtilityInputs(Chase, Inputs);
+		for (int Input = 0; Input < (int)EUtilityInput::Count; ++Input)
+			Columns[Input].push_back(Inputs[Input]);
+	}
+
+	int Checksum = 0;
+	FClock::time_point Start = FClock::now();
+	for (int Iteration = 0; Iteration < Iterations; ++Iteration)
+	{
+		for (const FChaseInputs& Chase : Chases)
+			Checksum += (int)ChooseChaseAction(Chase, Tuning);
+	}
+	const double ChooseSeconds = std::chrono::duration<double>(FClock::now() - Start).count();
+
+	FUtilityActions Actions;
+	DefaultChaseActions(Tuning, Actions);
+	const float* ColumnData[(int)EUtilityInput::Count];
+	for (int Input = 0; Input < (int)EUtilityInput::Count; ++Input)
+		ColumnData[Input] = Columns[Input].data();
+	std::vector<float> Scratch(Count), Scores(Count);
+	std::vector<EChaseAction> Best(Count);
+
+	Start = FClock::now();
+	for (int Iteration = 0; Iteration < Iterations; ++Iteration)
+	{
+		ScoreChaseActions(Actions, ColumnData, Count, Scratch.data(), Best.data(), Scores.data());
+		Checksum += (int)Best[Iteration % Count];
+	}
+	const double ScoreSeconds = std::chrono::duration<double>(FClock::now() - Start).count();
+
+	const double Decisions = (double)Count * Iterations;
+	std::printf("ChooseChaseAction:  %.1f M decisions/s\n", Decisions / ChooseSeconds / 1e6);
+	std::printf("ScoreChaseActions:  %.1f M decisions/s (batches of %d)\n", Decisions / ScoreSeconds / 1e6, Count);
+	std::printf("(checksum %d)\n", Checksum);
+}
+
+int main(int argc, char** argv)
+{
+	TestActions();
+	TestRotation();
+	TestTransitions();
+	TestChaseAction();
+	TestQuickHits();
+	TestCycleTarget();
+	TestUtility();
+	TestSquad();
+	TestChaseStep();
+
+	if (Failures > 0)
+	{
+		std::printf("%d check(s) failed\n", Failures);
+		return 1;
+	}
+	std::printf("All combat core checks passed\n");
+
+	if (argc > 1 && std::strcmp(argv[1], "--benchmark") == 0)
+		Benchmark();
+	return 0;
+}